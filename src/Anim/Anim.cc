@@ -4,6 +4,7 @@
 #include "Pre.h"
 #include "Anim.h"
 #include "Anim/private/animMgr.h"
+#include "Anim/private/animProfiler.h"
 #include "Core/Memory/Memory.h"
 
 namespace Oryol {
@@ -77,6 +78,20 @@ Anim::Create(const AnimLibrarySetup& setup) {
     return state->mgr.createLibrary(setup);
 }
 
+//------------------------------------------------------------------------------
+template<> Id
+Anim::Create(const AnimLibraryDataSetup& setup) {
+    o_assert_dbg(IsValid());
+    return state->mgr.createLibrary(setup);
+}
+
+//------------------------------------------------------------------------------
+template<> Id
+Anim::Create(const AnimLibraryStreamSetup& setup) {
+    o_assert_dbg(IsValid());
+    return state->mgr.createLibrary(setup);
+}
+
 //------------------------------------------------------------------------------
 template<> Id
 Anim::Create(const AnimSkeletonSetup& setup) {
@@ -84,6 +99,20 @@ Anim::Create(const AnimSkeletonSetup& setup) {
     return state->mgr.createSkeleton(setup);
 }
 
+//------------------------------------------------------------------------------
+template<> Id
+Anim::Create(const AnimBakeSetup& setup) {
+    o_assert_dbg(IsValid());
+    return state->mgr.createBake(setup);
+}
+
+//------------------------------------------------------------------------------
+template<> Id
+Anim::Create(const AnimMaskSetup& setup) {
+    o_assert_dbg(IsValid());
+    return state->mgr.createMask(setup);
+}
+
 //------------------------------------------------------------------------------
 template<> Id
 Anim::Create(const AnimInstanceSetup& setup) {
@@ -139,6 +168,20 @@ Anim::WriteKeys(const Id& libId, const uint8_t* ptr, int numBytes) {
     }
 }
 
+//------------------------------------------------------------------------------
+bool
+Anim::SaveLibrary(const Id& libId, Buffer& outData) {
+    o_assert_dbg(IsValid());
+    const AnimLibrary* lib = state->mgr.lookupLibrary(libId);
+    if (lib) {
+        return state->mgr.saveLibrary(lib, outData);
+    }
+    else {
+        o_warn("Anim::SaveLibrary: invalid anim lib id\n");
+        return false;
+    }
+}
+
 //------------------------------------------------------------------------------
 bool
 Anim::HasSkeleton(const Id& skelId) {
@@ -160,6 +203,27 @@ Anim::Skeleton(const Id& skelId) {
     }
 }
 
+//------------------------------------------------------------------------------
+bool
+Anim::HasBake(const Id& bakeId) {
+    o_assert_dbg(IsValid());
+    return nullptr != state->mgr.lookupBake(bakeId);
+}
+
+//------------------------------------------------------------------------------
+const AnimBake&
+Anim::Bake(const Id& bakeId) {
+    o_assert_dbg(IsValid());
+    const AnimBake* bake = state->mgr.lookupBake(bakeId);
+    if (bake) {
+        return *bake;
+    }
+    else {
+        static AnimBake dummyBake;
+        return dummyBake;
+    }
+}
+
 //------------------------------------------------------------------------------
 void
 Anim::NewFrame() {
@@ -169,11 +233,11 @@ Anim::NewFrame() {
 
 //------------------------------------------------------------------------------
 bool
-Anim::AddActiveInstance(const Id& instId) {
+Anim::AddActiveInstance(const Id& instId, int updateInterval) {
     o_assert_dbg(IsValid());
     animInstance* inst = state->mgr.lookupInstance(instId);
     if (inst) {
-        return state->mgr.addActiveInstance(inst);
+        return state->mgr.addActiveInstance(inst, updateInterval);
     }
     else {
         return false;
@@ -193,6 +257,7 @@ Anim::Samples(const Id& instId) {
     o_assert_dbg(IsValid());
     animInstance* inst = state->mgr.lookupInstance(instId);
     if (inst) {
+        o_assert_dbg(!inst->halfSamples && !inst->skinOnly);
         return inst->samples;
     }
     else {
@@ -205,7 +270,51 @@ Anim::Samples(const Id& instId) {
 const AnimSkinMatrixInfo&
 Anim::SkinMatrixInfo() {
     o_assert_dbg(IsValid());
-    return state->mgr.skinMatrixInfo;
+    return *state->mgr.skinMatrixInfo;
+}
+
+//------------------------------------------------------------------------------
+const AnimFrameStats&
+Anim::FrameStats() {
+    o_assert_dbg(IsValid());
+    return state->mgr.frameStats;
+}
+
+//------------------------------------------------------------------------------
+bool
+Anim::WriteProfileTrace(const char* path) {
+    return animProfiler::writeChromeTrace(path);
+}
+
+//------------------------------------------------------------------------------
+int
+Anim::AcquireOutput() {
+    o_assert_dbg(IsValid());
+    return state->mgr.acquireOutput();
+}
+
+//------------------------------------------------------------------------------
+const AnimSkinMatrixInfo&
+Anim::SkinMatrixInfo(int outputIndex) {
+    o_assert_dbg(IsValid());
+    return state->mgr.outputs[outputIndex].skinMatrixInfo;
+}
+
+//------------------------------------------------------------------------------
+void
+Anim::ReleaseOutput(int outputIndex) {
+    o_assert_dbg(IsValid());
+    state->mgr.releaseOutput(outputIndex);
+}
+
+//------------------------------------------------------------------------------
+void
+Anim::SetBoneLod(const Id& instId, int lodIndex) {
+    o_assert_dbg(IsValid());
+    animInstance* inst = state->mgr.lookupInstance(instId);
+    if (inst) {
+        state->mgr.setBoneLod(inst, lodIndex);
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -251,6 +360,27 @@ Anim::StopAll(const Id& instId, bool allowFadeOut) {
     }
 }
 
+//------------------------------------------------------------------------------
+void
+Anim::PlayBaked(const Id& instId, const Id& bakeId, int clipIndex, float startTime) {
+    o_assert_dbg(IsValid());
+    animInstance* inst = state->mgr.lookupInstance(instId);
+    const AnimBake* bake = state->mgr.lookupBake(bakeId);
+    if (inst && bake) {
+        state->mgr.playBaked(inst, bake, clipIndex, startTime);
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+Anim::StopBaked(const Id& instId) {
+    o_assert_dbg(IsValid());
+    animInstance* inst = state->mgr.lookupInstance(instId);
+    if (inst) {
+        state->mgr.stopBaked(inst);
+    }
+}
+
 //------------------------------------------------------------------------------
 const animInstance&
 Anim::instance(const Id& instId) {
@@ -10,6 +10,7 @@
 #include "Resource/ResourceLabel.h"
 #include "Resource/Locator.h"
 #include "Core/Time/Duration.h"
+#include "Core/Containers/Buffer.h"
 
 namespace Oryol {
 
@@ -48,22 +49,42 @@ public:
     static int ClipIndex(const Id& libId, const StringAtom& clipName);
     /// write anim library keys
     static void WriteKeys(const Id& libId, const uint8_t* ptr, int numBytes);
+    /// append an anim library in AnimLibraryFormat to a buffer (padded to start at a multiple
+    /// of AnimLibraryFormat::Alignment, header offsets are relative to that start), return false on error
+    static bool SaveLibrary(const Id& libId, Buffer& outData);
 
     /// return true if a valid anim skeleton exists for id
     static bool HasSkeleton(const Id& skelId);
     /// access a skeleton
     static const AnimSkeleton& Skeleton(const Id& skelId);
 
+    /// return true if valid baked skin matrices exist for id
+    static bool HasBake(const Id& bakeId);
+    /// access baked skin matrices
+    static const AnimBake& Bake(const Id& bakeId);
+
     /// begin new frame, clears all active instances
     static void NewFrame();
-    /// add an active instance for the current frame
-    static bool AddActiveInstance(const Id& instId);
+    /// add an active instance for the current frame, optionally override its update interval
+    static bool AddActiveInstance(const Id& instId, int updateInterval=0);
     /// evaluate all active animation instances
     static void Evaluate(double frameDurationInSeconds);
-    /// access to current samples of an active anim instance (valid after Anim::Evaluate())
+    /// access to current samples of an active anim instance (valid after Anim::Evaluate(), not for HalfFloatSamples or SkinMatricesOnly instances)
     static const Slice<float>& Samples(const Id& instId);
     /// access to evaluated skeleton skinning matrix info
     static const AnimSkinMatrixInfo& SkinMatrixInfo();
+    /// acquire the output of the most recently evaluated frame, keeps it intact until released
+    static int AcquireOutput();
+    /// access the skinning matrix info of an acquired frame output
+    static const AnimSkinMatrixInfo& SkinMatrixInfo(int outputIndex);
+    /// release an acquired frame output
+    static void ReleaseOutput(int outputIndex);
+    /// statistics of the most recently evaluated frame
+    static const AnimFrameStats& FrameStats();
+    /// write recorded profiling zones to a Chrome trace file (needs ORYOL_ANIM_PROFILING)
+    static bool WriteProfileTrace(const char* path);
+    /// set the skeleton bone LOD level of an instance (0 is the full skeleton, with a TRS library the samples of bones outside the LOD hold the static pose of the first visible clip)
+    static void SetBoneLod(const Id& instId, int lodIndex);
 
     /// enqueue an animation job, return job id
     static AnimJobId Play(const Id& instId, const AnimJob& job);
@@ -73,6 +94,10 @@ public:
     static void StopTrack(const Id& instId, int trackIndex, bool allowFadeOut=true);
     /// stop all jobs
     static void StopAll(const Id& instId, bool allowFadeOut=true);
+    /// play a baked clip instead of evaluating anim jobs (clipIndex is the library clip index)
+    static void PlayBaked(const Id& instId, const Id& bakeId, int clipIndex, float startTime=0.0f);
+    /// stop playing a baked clip, and evaluate anim jobs again
+    static void StopBaked(const Id& instId);
 
     /// access to anim instance
     static const _priv::animInstance& instance(const Id& instId);
@@ -8,10 +8,16 @@
 #include "Core/Containers/Map.h"
 #include "Resource/ResourceBase.h"
 #include "Resource/Locator.h"
+#include "Core/Time/Duration.h"
 #include <glm/vec4.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/mat4x3.hpp>
 
+/// set to 0 to compile out the per-frame statistics (Anim::FrameStats())
+#ifndef ORYOL_ANIM_FRAME_STATS
+#define ORYOL_ANIM_FRAME_STATS (1)
+#endif
+
 namespace Oryol {
 
 //------------------------------------------------------------------------------
@@ -25,6 +31,44 @@ struct AnimConfig {
     static const int MaxNumSkeletonBones = 256;
     /// max number of curves in a clip
     static const int MaxNumCurvesInClip = MaxNumSkeletonBones * 3;
+    /// max number of bone LOD levels in a skeleton (including the full skeleton)
+    static const int MaxNumSkeletonLods = 4;
+    /// max update interval of an anim instance in frames (must be a power of 2)
+    static const int MaxUpdateInterval = 8;
+    /// number of leading sample lanes (the root bone) which half-float samples keep in full precision
+    static const int NumFullPrecisionSamples = 10;
+};
+
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::AnimSkinFormat
+    @ingroup Anim
+    @brief per-bone format of the skin matrix table
+
+    Matrix4x3 stores each bone as a transposed 4x3 matrix (3 vec4's),
+    DualQuaternion stores a unit dual quaternion (2 vec4's: the rotation
+    quaternion followed by the dual part). Dual quaternions can't
+    represent scaling, the bone scale is dropped.
+*/
+struct AnimSkinFormat {
+    enum Enum {
+        Matrix4x3,      ///< transposed 4x3 matrix, 3 vec4's per bone
+        DualQuaternion, ///< unit dual quaternion, 2 vec4's per bone
+        Default,        ///< use the AnimSetup::SkinFormat (only for AnimSkeletonSetup)
+    };
+
+    /// return the number of vec4's per bone for a format
+    static int NumPixels(AnimSkinFormat::Enum fmt) {
+        switch (fmt) {
+            case Matrix4x3:         return 3;
+            case DualQuaternion:    return 2;
+            default:                return 0;
+        }
+    }
+    /// return the number of floats per bone for a format
+    static int NumFloats(AnimSkinFormat::Enum fmt) {
+        return NumPixels(fmt) * 4;
+    }
 };
 
 //------------------------------------------------------------------------------
@@ -38,6 +82,10 @@ struct AnimSetup {
     int MaxNumLibs = 16;
     /// max number of skeleton
     int MaxNumSkeletons = 16;
+    /// max number of curve masks
+    int MaxNumMasks = 16;
+    /// max number of baked skin matrix tables
+    int MaxNumBakes = 16;
     /// max overall number of anim instances
     int MaxNumInstances = 128;
     /// max number of active instances per frame
@@ -56,6 +104,31 @@ struct AnimSetup {
     int SkinMatrixTableWidth = 1024;
     /// skinning-matrix table height
     int SkinMatrixTableHeight = 64;
+    /// max number of skin matrix table pages, a new page is created when no
+    /// existing page has room for an instance (AnimSkinMatrixInfo::Pages)
+    int MaxNumSkinMatrixPages = 1;
+    /// format of the skin matrix table, can be overridden per skeleton
+    AnimSkinFormat::Enum SkinFormat = AnimSkinFormat::Matrix4x3;
+    /// also write the skin matrix table as half-floats (AnimSkinMatrixInfo::Page::HalfSkinMatrixTable)
+    bool HalfFloatSkinMatrixTable = false;
+    /// number of worker threads for Anim::Evaluate() (0: evaluate on calling thread)
+    int NumWorkerThreads = 0;
+    /// number of active instances per work chunk when evaluating on worker threads
+    int EvaluateChunkSize = 32;
+    /// capacity of the key cache for streamed libraries in number of keys
+    int StreamCacheCapacity = 1024 * 1024;
+    /// max number of keys loaded for streamed libraries per frame (at least one clip is loaded)
+    int StreamLoadBudget = 64 * 1024;
+    /// share one evaluation between active instances with identical anim jobs
+    bool PoseCacheEnabled = false;
+    /// clip times are quantized to this many seconds for pose sharing (0: exact match)
+    double PoseCacheTimeQuantum = 0.0;
+    /// number of output buffers (samples and skin matrix table), with more than one
+    /// buffer an acquired frame output can be read while the next frame is evaluated
+    int NumOutputBuffers = 1;
+    /// skip evaluating active instances whose anim jobs and key positions didn't change
+    /// (their samples and skin matrices are kept from the previous frame)
+    bool DirtyTrackingEnabled = false;
     /// initial resource label stack capacity
     int ResourceLabelStackCapacity = 256;
     /// initial resource registry capacity
@@ -75,6 +148,11 @@ struct AnimCurveFormat {
         Float3,     ///< 3 keys, linear interpolation
         Float4,     ///< 4 keys, linear interpolation
         Quaternion, ///< 4 keys, spherical interpolation
+        FloatU8,    ///< 1 8-bit key, linear interpolation
+        Float2U8,   ///< 2 8-bit keys, linear interpolation
+        Float3U8,   ///< 3 8-bit keys, linear interpolation
+        Float4U8,   ///< 4 8-bit keys, linear interpolation
+        Quaternion48,   ///< 48-bit smallest-three quaternion
         Invalid,
     };
 
@@ -86,9 +164,29 @@ struct AnimCurveFormat {
             case Float3:        return 3;
             case Float4:        return 4;
             case Quaternion:    return 4;
+            case FloatU8:       return 1;
+            case Float2U8:      return 2;
+            case Float3U8:      return 3;
+            case Float4U8:      return 4;
+            case Quaternion48:  return 4;
             default:            return 0;
         }
     }
+    /// return number of int16_t key elements per key for a format
+    static int KeyStride(AnimCurveFormat::Enum fmt) {
+        switch (fmt) {
+            case FloatU8:       return 1;
+            case Float2U8:      return 1;
+            case Float3U8:      return 2;
+            case Float4U8:      return 2;
+            case Quaternion48:  return 3;
+            default:            return Stride(fmt);
+        }
+    }
+    /// return true if the format packs several values into one key element
+    static bool IsPacked(AnimCurveFormat::Enum fmt) {
+        return (fmt >= FloatU8) && (fmt <= Quaternion48);
+    }
 };
 
 //------------------------------------------------------------------------------
@@ -102,8 +200,10 @@ struct AnimCurveSetup {
     bool Static = false;
     /// the default value of the curve
     glm::vec4 StaticValue;
-    /// the max magnitude of keys in the curve (used to unpack key values)
+    /// the max magnitude of keys in the curve (or value range for 8-bit keys)
     glm::vec4 Magnitude;
+    /// the min value of 8-bit keys
+    glm::vec4 Offset;
     
     /// default constructor
     AnimCurveSetup() { };
@@ -151,6 +251,122 @@ struct AnimLibrarySetup {
     Array<AnimCurveFormat::Enum> CurveLayout;
     /// the anim clips in the library
     Array<AnimClipSetup> Clips;
+    /// if > 0, convert clips to variable-rate keys in WriteKeys() with this max error
+    float KeyReductionTolerance = 0.0f;
+    /// max error when turning constant curves static in WriteKeys() (< 0 disables)
+    float StaticCurveTolerance = -1.0f;
+};
+
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::AnimLibraryFormat
+    @ingroup Anim
+    @brief binary container format for anim libraries
+
+    A versioned binary container which holds a complete anim library
+    (curve layout, clips, curves and keys), so that a memory-mapped
+    file can be handed to Anim::Create() through an AnimLibraryDataSetup.
+    All sections start at 16-byte aligned offsets:
+
+    header | clips[NumClips] | curves[NumClips * NumCurves] | keys[NumKeys]
+
+    Curves are stored with their runtime values (premultiplied
+    magnitudes, key indices relative to the clip key block), so
+    loading only copies the small clip and curve records; the keys are
+    used in place. Files are written with Anim::SaveLibrary().
+*/
+struct AnimLibraryFormat {
+    /// file magic ('OANL')
+    static const uint32_t Magic = 0x4C4E414F;
+    /// current format version
+    static const uint32_t Version = 1;
+    /// alignment of sections in bytes
+    static const int Alignment = 16;
+    /// max length of a clip name including the terminating 0
+    static const int MaxClipNameLength = 32;
+
+    /// the file header
+    struct Header {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t FileSize;
+        uint32_t NumClips;
+        uint32_t NumCurves;     ///< number of curves per clip
+        uint32_t NumKeys;       ///< number of int16_t keys
+        uint32_t ClipsOffset;
+        uint32_t CurvesOffset;
+        uint32_t KeysOffset;
+        uint32_t Pad[7];
+    };
+    /// clip flags
+    enum ClipFlags : uint32_t {
+        ClipVariableRate = (1<<0),
+    };
+    /// a clip record
+    struct Clip {
+        char Name[MaxClipNameLength];
+        int32_t Length;
+        float KeyDuration;
+        int32_t KeyStride;
+        uint32_t KeyIndex;      ///< first key of the clip in the key section
+        uint32_t NumKeys;       ///< number of keys of the clip
+        uint32_t Flags;
+        uint32_t Pad[2];
+    };
+    /// a curve record
+    struct Curve {
+        uint32_t Format;
+        uint32_t Static;
+        int32_t KeyIndex;
+        int32_t KeyStride;
+        int32_t NumKeys;
+        uint32_t Pad[3];
+        float StaticValue[4];
+        float Magnitude[4];
+        float Offset[4];
+    };
+};
+static_assert(sizeof(AnimLibraryFormat::Header) == 64, "AnimLibraryFormat::Header size");
+static_assert(sizeof(AnimLibraryFormat::Clip) == 64, "AnimLibraryFormat::Clip size");
+static_assert(sizeof(AnimLibraryFormat::Curve) == 80, "AnimLibraryFormat::Curve size");
+
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::AnimLibraryDataSetup
+    @ingroup Anim
+    @brief setup params for an anim library in AnimLibraryFormat
+
+    The keys are not copied into the key pool, the data must be 
+    16-byte aligned, and must stay valid and unchanged until the 
+    library is destroyed (e.g. a read-only memory-mapped file).
+*/
+struct AnimLibraryDataSetup {
+    /// resource locator for sharing
+    class Locator Locator = Locator::NonShared();
+    /// pointer to the library data
+    const uint8_t* Data = nullptr;
+    /// size of the library data in bytes
+    int Size = 0;
+};
+
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::AnimLibraryStreamSetup
+    @ingroup Anim
+    @brief setup params for a streamed anim library
+
+    Streamed libraries load the clip and curve records of an
+    AnimLibraryFormat file upfront, and the keys of a clip on demand
+    when the clip is played. The key blocks are kept in a bounded
+    cache (see AnimSetup::StreamCacheCapacity), and evicted when they
+    are no longer used. While the keys of a clip are loading, the
+    clip samples the static values of its curves.
+*/
+struct AnimLibraryStreamSetup {
+    /// resource locator for sharing
+    class Locator Locator = Locator::NonShared();
+    /// path of a local file in AnimLibraryFormat
+    StringAtom Path;
 };
 
 //------------------------------------------------------------------------------
@@ -187,6 +403,51 @@ struct AnimSkeletonSetup {
     class Locator Locator = Locator::NonShared();
     /// the skeleton bones
     Array<AnimBoneSetup> Bones; 
+    /// number of bones in the reduced LOD levels 1..N (descending, each LOD is a prefix of Bones)
+    InlineArray<int, AnimConfig::MaxNumSkeletonLods-1> LodNumBones;
+    /// format of the skeleton's skin matrices (Default: AnimSetup::SkinFormat)
+    AnimSkinFormat::Enum SkinFormat = AnimSkinFormat::Default;
+};
+
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::AnimMaskSetup
+    @ingroup Anim
+    @brief setup params for a curve mask
+
+    A mask enables a subset of the curves of an anim library, anim
+    jobs with a mask only sample and mix the enabled curves (e.g. an
+    upper-body overlay).
+*/
+struct AnimMaskSetup {
+    /// locator for resource sharing
+    class Locator Locator = Locator::NonShared();
+    /// the AnimLibrary whose curve layout the mask refers to
+    Id Library;
+    /// indices of the enabled curves in the library's curve layout
+    Array<int> Curves;
+};
+
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::AnimBakeSetup
+    @ingroup Anim
+    @brief setup params for baked skin matrices
+
+    Evaluates every key frame of the selected clips of a library
+    on a skeleton once, and keeps the resulting skin matrices in a
+    persistent table. Instances can then play a baked clip without
+    any evaluation (see Anim::PlayBaked()).
+*/
+struct AnimBakeSetup {
+    /// locator for resource sharing
+    class Locator Locator = Locator::NonShared();
+    /// the AnimLibrary with the clips to bake
+    Id Library;
+    /// the AnimSkeleton to compute skin matrices for
+    Id Skeleton;
+    /// indices of the clips to bake (empty: all clips)
+    Array<int> Clips;
 };
 
 //------------------------------------------------------------------------------
@@ -214,6 +475,17 @@ struct AnimInstanceSetup {
     Id Library;
     /// an optional AnimSkeleton if this is an instance
     Id Skeleton;
+    /// evaluate the instance only every Nth frame (1, 2, 4 or 8)
+    int UpdateInterval = 1;
+    /// interpolate between the last two evaluations in frames which are not evaluated
+    bool InterpolateUpdates = false;
+    /// store the samples as half-floats, except for the root bone (only for instances with
+    /// a skeleton whose samples are only used for skinning, Anim::Samples() isn't available)
+    bool HalfFloatSamples = false;
+    /// only the skin matrices are used, a single clip of a TRS curve layout library is then
+    /// sampled straight into the skin matrices (only for instances with a skeleton,
+    /// Anim::Samples() isn't available)
+    bool SkinMatricesOnly = false;
 };
 
 //------------------------------------------------------------------------------
@@ -233,10 +505,14 @@ struct AnimCurve {
     float StaticValue[4];
     /// the key magnitude (for unpacking keys)
     float Magnitude[4];
+    /// the key offset (for unpacking 8-bit keys)
+    float Offset[4];
     /// stride in key elements (according to format)
     int KeyStride = 0;
     /// index of the first key in key pool (relative to clip)
     int KeyIndex = InvalidIndex;
+    /// number of keys in a variable-rate curve (0 if uniform)
+    int NumKeys = 0;
 };
 
 //------------------------------------------------------------------------------
@@ -254,9 +530,13 @@ struct AnimClip {
     double KeyDuration = 1.0f / 25.0f;
     /// the stride in key elements from one key of a curve to next in key pool
     int KeyStride = 0;
+    /// true if the keyed curves have variable-rate keys
+    bool VariableRate = false;
+    /// false while the keys of a streamed clip are not loaded
+    bool Resident = true;
     /// access to the clip's curves
     Slice<AnimCurve> Curves;
-    /// access to the clip's 2D key table
+    /// access to the clip's 2D key table (or variable-rate key columns)
     Slice<int16_t> Keys;
 };
 
@@ -271,6 +551,16 @@ struct AnimLibrary : public ResourceBase {
     class Locator Locator;
     /// stride of per-instance samples in number of floats
     int SampleStride = 0;
+    /// max error for key reduction (0 if no key reduction)
+    float KeyReductionTolerance = 0.0f;
+    /// max error for static curve detection (< 0 if no detection)
+    float StaticCurveTolerance = -1.0f;
+    /// true if the key layout was changed after writing keys
+    bool KeysOptimized = false;
+    /// true if the keys are external data and not in the key pool
+    bool ExternalKeys = false;
+    /// true if the clip keys are streamed on demand
+    bool Streaming = false;
     /// access to all clips in the library
     Slice<AnimClip> Clips;
     /// array view over all curves of all clips
@@ -286,10 +576,16 @@ struct AnimLibrary : public ResourceBase {
     void clear() {
         Locator = Locator::NonShared();
         SampleStride = 0;
+        KeyReductionTolerance = 0.0f;
+        StaticCurveTolerance = -1.0f;
+        KeysOptimized = false;
+        ExternalKeys = false;
+        Streaming = false;
         Clips.Reset();
         Curves.Reset();
         Keys.Reset();
         ClipIndexMap.Clear();
+        CurveLayout.Clear();
     };
 };
 
@@ -312,17 +608,98 @@ struct AnimSkeleton : public ResourceBase {
     Slice<glm::mat4x3> Matrices;
     /// the parent bone indices (-1 if a root bone)
     StaticArray<int32_t, AnimConfig::MaxNumSkeletonBones> ParentIndices;
+    /// number of bone LOD levels (LOD 0 is the full skeleton)
+    int NumLods = 1;
+    /// number of evaluated bones in each LOD level
+    StaticArray<int, AnimConfig::MaxNumSkeletonLods> LodNumBones;
+    /// format of the skin matrices
+    AnimSkinFormat::Enum SkinFormat = AnimSkinFormat::Matrix4x3;
 
     /// clear the object
     void clear() {
         Locator = Locator::NonShared();
         NumBones = 0;
+        NumLods = 1;
+        SkinFormat = AnimSkinFormat::Matrix4x3;
         BindPose.Reset();
         InvBindPose.Reset();
         Matrices.Reset();
     };
 };
 
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::AnimMask
+    @ingroup Anim
+    @brief runtime struct for a curve mask
+*/
+struct AnimMask : public ResourceBase {
+    /// resource locator (name + sig)
+    class Locator Locator;
+    /// number of sample lanes of the library the mask was created for
+    int SampleStride = 0;
+    /// a run of enabled sample lanes
+    struct Range {
+        int First = 0;
+        int Num = 0;
+    };
+    /// enabled sample lane ranges (sorted, adjacent curves merged)
+    Array<Range> Ranges;
+
+    /// clear the object
+    void clear() {
+        Locator = Locator::NonShared();
+        SampleStride = 0;
+        Ranges.Clear();
+    };
+};
+
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::AnimBake
+    @ingroup Anim
+    @brief runtime struct for baked skin matrices
+
+    The matrix table has one row per baked frame, each row has the
+    skin matrices of all bones in the skeleton's skin format, in the
+    same layout as the AnimSkinMatrixInfo skin matrix table.
+*/
+struct AnimBake : public ResourceBase {
+    /// resource locator (name + sig)
+    class Locator Locator;
+    /// number of bones in a baked frame
+    int NumBones = 0;
+    /// format of the baked skin matrices
+    AnimSkinFormat::Enum SkinFormat = AnimSkinFormat::Matrix4x3;
+    /// overall number of baked frames
+    int NumFrames = 0;
+    /// a baked clip
+    struct Clip {
+        /// the clip index in the library
+        int ClipIndex = InvalidIndex;
+        /// first row in the matrix table
+        int FirstFrame = 0;
+        /// number of baked frames
+        int NumFrames = 0;
+        /// duration of one frame in seconds
+        double FrameDuration = 0.0;
+    };
+    /// the baked clips
+    Array<Clip> Clips;
+    /// the baked skin matrices (NumFrames rows of NumBones*AnimSkinFormat::NumFloats(SkinFormat) floats)
+    Slice<float> Matrices;
+
+    /// clear the object
+    void clear() {
+        Locator = Locator::NonShared();
+        NumBones = 0;
+        SkinFormat = AnimSkinFormat::Matrix4x3;
+        NumFrames = 0;
+        Clips.Clear();
+        Matrices.Reset();
+    };
+};
+
 //------------------------------------------------------------------------------
 /**
     @typedef Oryol::AnimJobId
@@ -355,6 +732,8 @@ struct AnimJob {
     float FadeIn = 0.0f;
     /// fade-out duration in seconds
     float FadeOut = 0.0f;
+    /// optional AnimMask, only the curves enabled in the mask are sampled and mixed
+    Id Mask;
 };
 
 //------------------------------------------------------------------------------
@@ -367,19 +746,118 @@ struct AnimJob {
     active AnimInstances in the current frame. The per-instance
     items are in the same order how active AnimInstances had
     been added, but only contains AnimInstances with skeletons.
+
+    The skin matrices are stored in one or more pages of the same
+    size (see AnimSetup::MaxNumSkinMatrixPages), each page is meant to
+    be uploaded into its own texture, InstanceInfo::Page tells which
+    texture to bind for an instance.
 */
 struct AnimSkinMatrixInfo {
-    /// pointer to the skin-matrix table
-    const float* SkinMatrixTable = nullptr;
-    /// size of valid information in the skin matrix table in bytes
-    int SkinMatrixTableByteSize = 0;
+    /// a range of skin matrix table rows
+    struct RowRange {
+        int FirstRow = 0;
+        int NumRows = 0;
+    };
+    /// a skin matrix table page (SkinMatrixTableWidth * SkinMatrixTableHeight pixels)
+    struct Page {
+        /// pointer to the skin-matrix table of the page
+        const float* SkinMatrixTable = nullptr;
+        /// size of valid information in the skin matrix table in bytes
+        int SkinMatrixTableByteSize = 0;
+        /// half-float copy of the skin matrix table with the same layout (only with
+        /// AnimSetup::HalfFloatSkinMatrixTable), SkinMatrixTableByteSize/2 bytes are valid
+        const uint16_t* HalfSkinMatrixTable = nullptr;
+        /// rows written in the current frame, only these need to be uploaded
+        Array<RowRange> DirtyRows;
+    };
+    /// the skin matrix table pages, pages are created on demand and stay alive
+    Array<Page> Pages;
     /// per-instance information
     struct InstanceInfo {
         Id Instance;
-        glm::vec4 ShaderInfo;   // x: u texcoord, y: v texcoord, z: 1.0/texwidth
+        glm::vec4 ShaderInfo;   // x: u texcoord, y: v texcoord, z: 1.0/texwidth, w: vec4's per bone (see AnimSkinFormat)
+        int Page = 0;           // index of the page which contains the skin matrices
+        bool Changed = true;    // false if the skin matrices are the same as in the previous frame
     };
     /// one entry per active anim instance
     Array<InstanceInfo> InstanceInfos;
 };
 
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::AnimFrameStats
+    @ingroup Anim
+    @brief statistics of the most recently evaluated frame
+
+    Filled by Anim::Evaluate() unless ORYOL_ANIM_FRAME_STATS is defined
+    to 0, in which case all values stay 0. The high-water marks are
+    tracked over all frames. Phase timings of worker threads are summed
+    up, so they can exceed EvaluateTime.
+*/
+struct AnimFrameStats {
+    /// number of active instances
+    int NumActiveInstances = 0;
+    /// number of active instances which were evaluated
+    int NumEvaluatedInstances = 0;
+    /// active instances which reused their pose from a previous update (update-rate LOD)
+    int NumUpdateRateSkipped = 0;
+    /// active instances which shared the pose of another instance
+    int NumPoseCacheHits = 0;
+    /// active instances which kept their unchanged pose
+    int NumUnchangedInstances = 0;
+    /// active instances which played a baked clip
+    int NumBakedInstances = 0;
+    /// sequencer items which were sampled
+    int NumItemsProcessed = 0;
+    /// sequencer items which were skipped (not active, or occluded by higher priority items)
+    int NumItemsSkipped = 0;
+    /// number of sampled curves
+    int NumCurvesSampled = 0;
+    /// number of sampled keys (2 per keyed curve component)
+    int NumKeysSampled = 0;
+    /// number of skin matrix table pages in use
+    int NumSkinMatrixPages = 0;
+    /// fraction of the skin matrix table pages occupied by instance slots
+    float SkinMatrixTableFill = 0.0f;
+    /// fraction of free skin matrix table pixels outside the largest free range of their row
+    float SkinMatrixTableFragmentation = 0.0f;
+    /// fraction of skin matrix table pixels in free ranges too small for the smallest instance slot
+    float SkinMatrixTableWaste = 0.0f;
+    /// instances rejected by AddActiveInstance() because MaxNumActiveInstances was reached
+    int NumRejectedActiveLimit = 0;
+    /// instances rejected by AddActiveInstance() because the sample pool was full
+    int NumRejectedSamplePool = 0;
+    /// instances rejected by AddActiveInstance() because all skin matrix table pages were full
+    int NumRejectedSkinMatrixTable = 0;
+
+    /// high-water mark of active instances
+    int MaxActiveInstances = 0;
+    /// high-water mark of the sample pool in number of floats
+    int MaxSamples = 0;
+    /// high-water mark of the skin matrix table in number of vec4 pixels
+    int MaxSkinMatrixPixels = 0;
+    /// high-water mark of the key pool in number of keys
+    int MaxKeys = 0;
+    /// high-water mark of the curve pool
+    int MaxCurves = 0;
+    /// high-water mark of the clip pool
+    int MaxClips = 0;
+    /// library and skeleton creations which failed although the pool had enough
+    /// free space in total (the pools aren't defragmented), counted over all frames
+    int NumFragmentedPoolFailures = 0;
+
+    /// time for pose sharing and change detection
+    Duration PrepareTime;
+    /// time for anim job garbage collection
+    Duration GarbageCollectTime;
+    /// time for sampling anim jobs
+    Duration SampleTime;
+    /// time for generating skin matrices
+    Duration SkinTime;
+    /// time for copying history, baked and unchanged poses
+    Duration CopyTime;
+    /// overall time of Anim::Evaluate()
+    Duration EvaluateTime;
+};
+
 } // namespace Oryol
@@ -0,0 +1,330 @@
+//------------------------------------------------------------------------------
+//  AnimBench.cc
+//
+//  Throughput benchmarks for the Anim module on synthetic libraries and
+//  skeletons. Prints a human-readable report, or with '-json' one JSON
+//  object per line and scenario for regression tracking. A single
+//  scenario can be selected by name. With '-trace' the recorded profiling
+//  zones are written to a Chrome trace file (needs ORYOL_ANIM_PROFILING).
+//  The per-phase timings and key rates need ORYOL_ANIM_FRAME_STATS.
+//
+//  AnimBench [-json] [-frames N] [-trace file.json] [scenario]
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "Core/Core.h"
+#include "Core/Time/Clock.h"
+#include "Anim/private/animMgr.h"
+#include "Anim/private/animProfiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Oryol;
+using namespace _priv;
+
+struct benchConfig {
+    const char* name = nullptr;
+    int numInstances = 0;
+    int numBones = 0;
+    int numClips = 0;
+    int clipLength = 0;         // in number of keys
+    float staticRatio = 0.0f;   // fraction of curves without keys
+    int numTracks = 1;          // number of blended anim jobs per instance
+    bool skinOnly = false;      // instances only need skin matrices (AnimInstanceSetup::SkinMatricesOnly)
+    int numChurn = 0;           // library create/destroy iterations
+};
+
+struct benchResult {
+    // all instance timings are in nanoseconds per instance and frame
+    double gcNs = 0.0;
+    double evalNs = 0.0;
+    double skinNs = 0.0;
+    double evaluateNs = 0.0;
+    double keysPerSec = 0.0;
+    // library churn timings in nanoseconds per library
+    double createNs = 0.0;
+    double destroyNs = 0.0;
+};
+
+//------------------------------------------------------------------------------
+/// reproducible pseudo-random numbers (LCG)
+struct benchRandom {
+    uint32_t state = 1;
+    uint32_t next() {
+        this->state = this->state * 1664525 + 1013904223;
+        return this->state >> 8;
+    }
+    float nextFloat() {
+        return float(this->next() & 0xFFFF) / 65535.0f;
+    }
+};
+
+//------------------------------------------------------------------------------
+static AnimSetup
+makeSetup(const benchConfig& cfg) {
+    AnimSetup setup;
+    const int numCurves = cfg.numBones * 3;
+    const int numInsts = cfg.numInstances > 0 ? cfg.numInstances : 1;
+    const int pixelsPerInst = cfg.numBones * 3;
+    setup.MaxNumLibs = 8;
+    setup.MaxNumInstances = numInsts;
+    setup.MaxNumActiveInstances = numInsts;
+    setup.ClipPoolCapacity = 8 * cfg.numClips;
+    setup.CurvePoolCapacity = 8 * cfg.numClips * numCurves;
+    setup.KeyPoolCapacity = 8 * cfg.numClips * cfg.clipLength * cfg.numBones * 10;
+    setup.SamplePoolCapacity = numInsts * cfg.numBones * 10;
+    setup.SkinMatrixTableWidth = 2048;
+    const int instsPerRow = setup.SkinMatrixTableWidth / pixelsPerInst;
+    setup.SkinMatrixTableHeight = (numInsts + instsPerRow - 1) / instsPerRow;
+    setup.MaxNumSkeletons = 2;
+    setup.DirtyTrackingEnabled = true;
+    return setup;
+}
+
+//------------------------------------------------------------------------------
+/// create a TRS library with random keys
+static Id
+makeLibrary(animMgr& mgr, const benchConfig& cfg, int numClips, const char* loc, benchRandom& rnd) {
+    AnimLibrarySetup libSetup;
+    libSetup.Locator = loc;
+    for (int i = 0; i < cfg.numBones; i++) {
+        libSetup.CurveLayout.Add(AnimCurveFormat::Float3);
+        libSetup.CurveLayout.Add(AnimCurveFormat::Quaternion);
+        libSetup.CurveLayout.Add(AnimCurveFormat::Float3);
+    }
+    for (int clipIndex = 0; clipIndex < numClips; clipIndex++) {
+        AnimClipSetup& clipSetup = libSetup.Clips.Add();
+        char name[32];
+        snprintf(name, sizeof(name), "clip%d", clipIndex);
+        clipSetup.Name = name;
+        clipSetup.Length = cfg.clipLength;
+        for (int i = 0; i < cfg.numBones * 3; i++) {
+            AnimCurveSetup& curve = clipSetup.Curves.Add();
+            if (rnd.nextFloat() < cfg.staticRatio) {
+                curve.Static = true;
+                curve.StaticValue = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            }
+            else {
+                curve.Magnitude = glm::vec4(1.0f);
+            }
+        }
+    }
+    Id libId = mgr.createLibrary(libSetup);
+    AnimLibrary* lib = mgr.lookupLibrary(libId);
+    if (lib->Keys.Size() > 0) {
+        Array<int16_t> keys;
+        keys.Reserve(lib->Keys.Size());
+        for (int i = 0; i < lib->Keys.Size(); i++) {
+            keys.Add(int16_t(rnd.next() & 0x7FFF) - 0x3FFF);
+        }
+        mgr.writeKeys(lib, (const uint8_t*)keys.begin(), keys.Size() * sizeof(int16_t));
+    }
+    return libId;
+}
+
+//------------------------------------------------------------------------------
+/// create a skeleton with a binary tree bone hierarchy
+static Id
+makeSkeleton(animMgr& mgr, int numBones) {
+    AnimSkeletonSetup skelSetup;
+    skelSetup.Locator = "skel";
+    for (int i = 0; i < numBones; i++) {
+        skelSetup.Bones.Add(AnimBoneSetup("bone", i > 0 ? (i - 1) / 2 : -1, glm::mat4(), glm::mat4()));
+    }
+    return mgr.createSkeleton(skelSetup);
+}
+
+//------------------------------------------------------------------------------
+/// evaluate many instances for a number of frames
+static benchResult
+runInstances(const benchConfig& cfg, int numFrames) {
+    benchResult res;
+    animMgr mgr;
+    mgr.setup(makeSetup(cfg));
+    benchRandom rnd;
+    Id libId = makeLibrary(mgr, cfg, cfg.numClips, "lib", rnd);
+    Id skelId = makeSkeleton(mgr, cfg.numBones);
+    const AnimLibrary* lib = mgr.lookupLibrary(libId);
+    const double clipDuration = cfg.clipLength * lib->Clips[0].KeyDuration;
+
+    Array<animInstance*> insts;
+    insts.Reserve(cfg.numInstances);
+    for (int i = 0; i < cfg.numInstances; i++) {
+        AnimInstanceSetup instSetup = AnimInstanceSetup::FromLibraryAndSkeleton(libId, skelId);
+        instSetup.SkinMatricesOnly = cfg.skinOnly;
+        Id instId = mgr.createInstance(instSetup);
+        animInstance* inst = mgr.lookupInstance(instId);
+        for (int track = 0; track < cfg.numTracks; track++) {
+            AnimJob job;
+            job.ClipIndex = (i + track) % cfg.numClips;
+            job.TrackIndex = track;
+            job.MixWeight = track == 0 ? 1.0f : 0.5f;
+            job.StartTime = -float(rnd.nextFloat() * clipDuration);
+            mgr.play(inst, job);
+        }
+        insts.Add(inst);
+    }
+
+    // one warm-up frame, then evaluate through animMgr::evaluate(), the
+    // phase timings and key counts come from the frame statistics
+    const double frameDur = 1.0 / 60.0;
+    Duration gcDur, evalDur, skinDur, evaluateDur;
+    int64_t numKeys = 0;
+    for (int frame = 0; frame <= numFrames; frame++) {
+        mgr.newFrame();
+        for (animInstance* inst : insts) {
+            mgr.addActiveInstance(inst);
+        }
+        TimePoint t = Clock::Now();
+        mgr.evaluate(frameDur);
+        if (frame > 0) {
+            evaluateDur += Clock::Since(t);
+            #if ORYOL_ANIM_FRAME_STATS
+            const AnimFrameStats& stats = mgr.frameStats;
+            gcDur += stats.GarbageCollectTime;
+            evalDur += stats.SampleTime;
+            skinDur += stats.SkinTime;
+            numKeys += stats.NumKeysSampled;
+            #endif
+        }
+    }
+    const double numInstFrames = double(cfg.numInstances) * numFrames;
+    res.gcNs = gcDur.AsNanoSeconds() / numInstFrames;
+    res.evalNs = evalDur.AsNanoSeconds() / numInstFrames;
+    res.skinNs = skinDur.AsNanoSeconds() / numInstFrames;
+    res.evaluateNs = evaluateDur.AsNanoSeconds() / numInstFrames;
+    // fused instances sample their keys while generating skin matrices
+    const Duration sampleDur = cfg.skinOnly ? (evalDur + skinDur) : evalDur;
+    res.keysPerSec = sampleDur.AsSeconds() > 0.0 ? (double(numKeys) / sampleDur.AsSeconds()) : 0.0;
+    mgr.discard();
+    return res;
+}
+
+//------------------------------------------------------------------------------
+/// create and destroy libraries of different sizes, a few stay alive
+/// at any time so that the key, curve and clip pools fragment
+static benchResult
+runLibraryChurn(const benchConfig& cfg) {
+    benchResult res;
+    animMgr mgr;
+    mgr.setup(makeSetup(cfg));
+    benchRandom rnd;
+    const int numAlive = 4;
+    ResourceLabel labels[numAlive];
+    Duration createDur, destroyDur;
+    for (int i = 0; i < cfg.numChurn + numAlive; i++) {
+        const int slot = i % numAlive;
+        if (i >= numAlive) {
+            TimePoint t = Clock::Now();
+            mgr.destroy(labels[slot]);
+            destroyDur += Clock::Since(t);
+        }
+        if (i < cfg.numChurn) {
+            char loc[32];
+            snprintf(loc, sizeof(loc), "lib%d", i);
+            const int numClips = 1 + int(rnd.next() % uint32_t(cfg.numClips));
+            labels[slot] = mgr.resContainer.PushLabel();
+            TimePoint t = Clock::Now();
+            makeLibrary(mgr, cfg, numClips, loc, rnd);
+            createDur += Clock::Since(t);
+            mgr.resContainer.PopLabel();
+        }
+    }
+    res.createNs = createDur.AsNanoSeconds() / cfg.numChurn;
+    res.destroyNs = destroyDur.AsNanoSeconds() / cfg.numChurn;
+    mgr.discard();
+    return res;
+}
+
+//------------------------------------------------------------------------------
+static void
+report(const benchConfig& cfg, const benchResult& res, bool json) {
+    if (json) {
+        printf("{\"scenario\":\"%s\",\"instances\":%d,\"bones\":%d,\"clips\":%d,\"tracks\":%d,\"static_ratio\":%.2f,\"skin_only\":%s,"
+               "\"gc_ns\":%.2f,\"eval_ns\":%.2f,\"skin_ns\":%.2f,\"evaluate_ns\":%.2f,\"keys_per_sec\":%.0f,"
+               "\"create_ns\":%.0f,\"destroy_ns\":%.0f}\n",
+            cfg.name, cfg.numInstances, cfg.numBones, cfg.numClips, cfg.numTracks, cfg.staticRatio, cfg.skinOnly ? "true" : "false",
+            res.gcNs, res.evalNs, res.skinNs, res.evaluateNs, res.keysPerSec,
+            res.createNs, res.destroyNs);
+    }
+    else if (cfg.numChurn > 0) {
+        printf("%-16s %d libs: create %.1f us/lib, destroy %.1f us/lib\n",
+            cfg.name, cfg.numChurn, res.createNs / 1000.0, res.destroyNs / 1000.0);
+    }
+    else {
+        printf("%-16s %d inst, %d bones, %d tracks: gc %.1f, eval %.1f, skin %.1f, evaluate %.1f ns/inst, %.1f Mkeys/s\n",
+            cfg.name, cfg.numInstances, cfg.numBones, cfg.numTracks,
+            res.gcNs, res.evalNs, res.skinNs, res.evaluateNs, res.keysPerSec / 1000000.0);
+    }
+}
+
+//------------------------------------------------------------------------------
+int
+main(int argc, const char** argv) {
+    Core::Setup();
+
+    bool json = false;
+    int numFrames = 60;
+    const char* only = nullptr;
+    const char* tracePath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "-json")) {
+            json = true;
+        }
+        else if ((0 == strcmp(argv[i], "-frames")) && ((i + 1) < argc)) {
+            numFrames = atoi(argv[++i]);
+        }
+        else if ((0 == strcmp(argv[i], "-trace")) && ((i + 1) < argc)) {
+            tracePath = argv[++i];
+        }
+        else {
+            only = argv[i];
+        }
+    }
+    if (numFrames < 1) {
+        numFrames = 1;
+    }
+
+    benchConfig scenarios[4];
+    // a large crowd playing a single idle clip, most curves are static
+    scenarios[0].name = "crowd_idle";
+    scenarios[0].numInstances = 10000;
+    scenarios[0].numBones = 32;
+    scenarios[0].numClips = 4;
+    scenarios[0].clipLength = 64;
+    scenarios[0].staticRatio = 0.6f;
+    scenarios[0].numTracks = 1;
+    // the same crowd, but only the skin matrices are needed (fused sampling)
+    scenarios[1] = scenarios[0];
+    scenarios[1].name = "crowd_skin_only";
+    scenarios[1].skinOnly = true;
+    // fewer detailed characters blending 3 tracks
+    scenarios[2].name = "hero_blend";
+    scenarios[2].numInstances = 500;
+    scenarios[2].numBones = 64;
+    scenarios[2].numClips = 8;
+    scenarios[2].clipLength = 128;
+    scenarios[2].staticRatio = 0.3f;
+    scenarios[2].numTracks = 3;
+    // library streaming in and out during gameplay
+    scenarios[3].name = "library_churn";
+    scenarios[3].numBones = 64;
+    scenarios[3].numClips = 16;
+    scenarios[3].clipLength = 64;
+    scenarios[3].staticRatio = 0.3f;
+    scenarios[3].numChurn = 200;
+
+    for (const benchConfig& cfg : scenarios) {
+        if (only && (0 != strcmp(only, cfg.name))) {
+            continue;
+        }
+        const benchResult res = cfg.numChurn > 0 ? runLibraryChurn(cfg) : runInstances(cfg, numFrames);
+        report(cfg, res, json);
+    }
+    if (tracePath) {
+        animProfiler::writeChromeTrace(tracePath);
+    }
+
+    Core::Discard();
+    return 0;
+}
@@ -0,0 +1,1319 @@
+//------------------------------------------------------------------------------
+//  AnimEvaluateTest.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "UnitTest++/src/UnitTest++.h"
+#include "Anim/AnimTypes.h"
+#include "Anim/private/animMgr.h"
+#include "Anim/private/animProfiler.h"
+#include "Anim/private/animHalf.h"
+#include <cstring>
+#include <math.h>
+
+using namespace Oryol;
+using namespace _priv;
+
+static const int NumBones = 4;
+static const int NumInstances = 100;
+
+//------------------------------------------------------------------------------
+// the AnimSetup and AnimInstanceSetup of a test scene, tests override
+// single values (the library and skeleton of the instance setup are
+// filled in by setupScene)
+struct sceneSetup {
+    sceneSetup() {
+        anim.MaxNumInstances = NumInstances;
+        anim.MaxNumActiveInstances = NumInstances;
+        anim.EvaluateChunkSize = 8;
+        anim.DirtyTrackingEnabled = true;
+    }
+    AnimSetup anim;
+    AnimInstanceSetup inst;
+};
+
+//------------------------------------------------------------------------------
+static void
+setupScene(animMgr& mgr, Id* outInsts, const sceneSetup& scene=sceneSetup()) {
+    mgr.setup(scene.anim);
+
+    // a library with a TRS curve layout and 2 clips
+    AnimLibrarySetup libSetup;
+    libSetup.Locator = "lib";
+    for (int i = 0; i < NumBones; i++) {
+        libSetup.CurveLayout.Add(AnimCurveFormat::Float3);
+        libSetup.CurveLayout.Add(AnimCurveFormat::Quaternion);
+        libSetup.CurveLayout.Add(AnimCurveFormat::Float3);
+    }
+    for (int clipIndex = 0; clipIndex < 2; clipIndex++) {
+        AnimClipSetup& clipSetup = libSetup.Clips.Add();
+        clipSetup.Name = clipIndex == 0 ? "clip0" : "clip1";
+        clipSetup.Length = 16;
+        for (int i = 0; i < NumBones; i++) {
+            AnimCurveSetup& t = clipSetup.Curves.Add();
+            t.Magnitude = glm::vec4(2.0f);
+            AnimCurveSetup& r = clipSetup.Curves.Add();
+            r.Magnitude = glm::vec4(1.0f);
+            AnimCurveSetup& s = clipSetup.Curves.Add();
+            s.Static = true;
+            s.StaticValue = glm::vec4(1.0f);
+        }
+    }
+    Id libId = mgr.createLibrary(libSetup);
+    AnimLibrary* lib = mgr.lookupLibrary(libId);
+    Array<int16_t> keys;
+    for (int i = 0; i < lib->Keys.Size(); i++) {
+        keys.Add(int16_t((i * 7919) & 0x7FFF) - 0x3FFF);
+    }
+    mgr.writeKeys(lib, (const uint8_t*)keys.begin(), keys.Size() * sizeof(int16_t));
+
+    AnimSkeletonSetup skelSetup;
+    skelSetup.Locator = "skel";
+    for (int i = 0; i < NumBones; i++) {
+        skelSetup.Bones.Add(AnimBoneSetup("bone", i - 1, glm::mat4(), glm::mat4()));
+    }
+    skelSetup.LodNumBones.Add(NumBones / 2);
+    Id skelId = mgr.createSkeleton(skelSetup);
+
+    for (int i = 0; i < NumInstances; i++) {
+        AnimInstanceSetup instSetup = scene.inst;
+        instSetup.Library = libId;
+        instSetup.Skeleton = skelId;
+        outInsts[i] = mgr.createInstance(instSetup);
+        animInstance* inst = mgr.lookupInstance(outInsts[i]);
+        AnimJob job;
+        job.ClipIndex = i & 1;
+        job.StartTime = float(i) * 0.01f;
+        mgr.play(inst, job);
+        job.ClipIndex = (i + 1) & 1;
+        job.TrackIndex = 1;
+        job.MixWeight = 0.5f;
+        job.FadeIn = 0.2f;
+        mgr.play(inst, job);
+    }
+}
+
+//------------------------------------------------------------------------------
+// true if instances of a test scene have the same samples (unless only
+// skin matrices are used) and skin matrices as in a reference scene
+static bool
+samePoses(animMgr& refMgr, const Id* refInsts, animMgr& mgr, const Id* insts, int begin=0, int end=NumInstances) {
+    bool same = true;
+    for (int i = begin; i < end; i++) {
+        const animInstance* refInst = refMgr.lookupInstance(refInsts[i]);
+        const animInstance* inst = mgr.lookupInstance(insts[i]);
+        if (!inst->skinOnly) {
+            same &= 0 == std::memcmp(refInst->samples.begin(), inst->samples.begin(), inst->samples.Size() * sizeof(float));
+        }
+        same &= 0 == std::memcmp(refInst->skinMatrices.begin(), inst->skinMatrices.begin(), inst->skinMatrices.Size() * sizeof(float));
+    }
+    return same;
+}
+
+//------------------------------------------------------------------------------
+TEST(AnimEvaluateParallelTest) {
+    animMgr serialMgr;
+    animMgr parallelMgr;
+    Id serialInsts[NumInstances];
+    Id parallelInsts[NumInstances];
+    setupScene(serialMgr, serialInsts);
+    sceneSetup parallelScene;
+    parallelScene.anim.NumWorkerThreads = 3;
+    setupScene(parallelMgr, parallelInsts, parallelScene);
+    CHECK(!serialMgr.workerPool.isValid);
+    CHECK(parallelMgr.workerPool.isValid);
+
+    for (int frame = 0; frame < 10; frame++) {
+        serialMgr.newFrame();
+        parallelMgr.newFrame();
+        for (int i = 0; i < NumInstances; i++) {
+            CHECK(serialMgr.addActiveInstance(serialMgr.lookupInstance(serialInsts[i])));
+            CHECK(parallelMgr.addActiveInstance(parallelMgr.lookupInstance(parallelInsts[i])));
+        }
+        serialMgr.evaluate(1.0 / 60.0);
+        parallelMgr.evaluate(1.0 / 60.0);
+
+        // the parallel result must be identical to the serial result
+        CHECK(serialMgr.skinMatrixInfo->Pages[0].SkinMatrixTableByteSize == parallelMgr.skinMatrixInfo->Pages[0].SkinMatrixTableByteSize);
+        CHECK(0 == std::memcmp(serialMgr.skinMatrixInfo->Pages[0].SkinMatrixTable,
+            parallelMgr.skinMatrixInfo->Pages[0].SkinMatrixTable,
+            serialMgr.skinMatrixInfo->Pages[0].SkinMatrixTableByteSize));
+        CHECK(0 == std::memcmp(serialMgr.samplePool, parallelMgr.samplePool, serialMgr.sampleAllocator.numUsed * sizeof(float)));
+    }
+    serialMgr.discard();
+    parallelMgr.discard();
+}
+
+//------------------------------------------------------------------------------
+TEST(AnimEvaluateSkinBatchTest) {
+    // the batched skin matrix path must produce the same
+    // result as generating each instance on its own
+    animMgr mgr;
+    Id insts[NumInstances];
+    setupScene(mgr, insts);
+    mgr.newFrame();
+    for (int i = 0; i < NumInstances; i++) {
+        CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+    }
+    mgr.evaluate(1.0 / 60.0);
+    const int numFloats = mgr.skinMatrixInfo->Pages[0].SkinMatrixTableByteSize / sizeof(float);
+    Array<float> batched;
+    batched.Reserve(numFloats);
+    for (int i = 0; i < numFloats; i++) {
+        batched.Add(mgr.skinMatrixInfo->Pages[0].SkinMatrixTable[i]);
+    }
+    for (int i = 0; i < NumInstances; i++) {
+        mgr.genSkinMatrices(mgr.lookupInstance(insts[i]));
+    }
+    CHECK(0 == std::memcmp(batched.begin(), mgr.skinMatrixInfo->Pages[0].SkinMatrixTable, numFloats * sizeof(float)));
+    mgr.discard();
+}
+
+//------------------------------------------------------------------------------
+static void
+advanceTime(animMgr& mgr, double dur) {
+    mgr.newFrame();
+    mgr.evaluate(dur);
+}
+
+//------------------------------------------------------------------------------
+TEST(AnimEvaluateUpdateRateTest) {
+    // instances with update interval 4 are evaluated in 4 balanced
+    // groups, skipped instances repeat their last evaluated pose
+    animMgr refMgr;
+    animMgr lodMgr;
+    Id refInsts[NumInstances];
+    Id lodInsts[NumInstances];
+    setupScene(refMgr, refInsts);
+    sceneSetup lodScene;
+    lodScene.inst.UpdateInterval = 4;
+    setupScene(lodMgr, lodInsts, lodScene);
+    // skip ahead until all anim jobs have started
+    advanceTime(refMgr, 1.0);
+    advanceTime(lodMgr, 1.0);
+    const int numSkinFloats = NumBones * 12;
+    Array<float> lastEval;
+    for (int i = 0; i < NumInstances * numSkinFloats; i++) {
+        lastEval.Add(0.0f);
+    }
+    for (int frame = 0; frame < 12; frame++) {
+        refMgr.newFrame();
+        lodMgr.newFrame();
+        for (int i = 0; i < NumInstances; i++) {
+            CHECK(refMgr.addActiveInstance(refMgr.lookupInstance(refInsts[i])));
+            CHECK(lodMgr.addActiveInstance(lodMgr.lookupInstance(lodInsts[i])));
+        }
+        // the first frame evaluates everything, after that a quarter per frame
+        CHECK(refMgr.numEvaluatedInstances == NumInstances);
+        CHECK(lodMgr.numEvaluatedInstances == (frame == 0 ? NumInstances : NumInstances / 4));
+        refMgr.evaluate(1.0 / 60.0);
+        lodMgr.evaluate(1.0 / 60.0);
+        for (int i = 0; i < NumInstances; i++) {
+            const animInstance* refInst = refMgr.lookupInstance(refInsts[i]);
+            const animInstance* lodInst = lodMgr.lookupInstance(lodInsts[i]);
+            float* last = &lastEval[i * numSkinFloats];
+            if (lodInst->lodEval) {
+                CHECK(0 == std::memcmp(refInst->skinMatrices.begin(), lodInst->skinMatrices.begin(), numSkinFloats * sizeof(float)));
+                std::memcpy(last, lodInst->skinMatrices.begin(), numSkinFloats * sizeof(float));
+            }
+            else {
+                CHECK(0 == std::memcmp(last, lodInst->skinMatrices.begin(), numSkinFloats * sizeof(float)));
+            }
+        }
+    }
+
+    // an interval override in addActiveInstance reassigns the phase (and
+    // frees the pose history at full rate), an instance which was inactive
+    // for a frame is evaluated right away
+    lodMgr.newFrame();
+    animInstance* inst0 = lodMgr.lookupInstance(lodInsts[0]);
+    animInstance* inst1 = lodMgr.lookupInstance(lodInsts[1]);
+    CHECK(nullptr != inst0->history);
+    CHECK(lodMgr.addActiveInstance(inst0, 1));
+    CHECK(inst0->lodInterval == 1);
+    CHECK(inst0->lodEval);
+    CHECK(nullptr == inst0->history);
+    lodMgr.evaluate(1.0 / 60.0);
+    lodMgr.newFrame();
+    CHECK(lodMgr.addActiveInstance(inst1));
+    CHECK(inst1->lodEval);
+    CHECK(lodMgr.addActiveInstance(inst0));
+    CHECK(inst0->lodInterval == 4);
+    CHECK(nullptr != inst0->history);
+    lodMgr.evaluate(1.0 / 60.0);
+    refMgr.discard();
+    lodMgr.discard();
+}
+
+//------------------------------------------------------------------------------
+TEST(AnimEvaluateUpdateRateInterpolateTest) {
+    // with interpolation, reduced-rate instances blend from the
+    // previous towards the last evaluated pose
+    animMgr refMgr;
+    animMgr lodMgr;
+    Id refInsts[NumInstances];
+    Id lodInsts[NumInstances];
+    setupScene(refMgr, refInsts);
+    sceneSetup lodScene;
+    lodScene.inst.UpdateInterval = 2;
+    lodScene.inst.InterpolateUpdates = true;
+    setupScene(lodMgr, lodInsts, lodScene);
+    // skip ahead until all anim jobs have started
+    advanceTime(refMgr, 1.0);
+    advanceTime(lodMgr, 1.0);
+    const int numSkinFloats = NumBones * 12;
+    Array<float> refPoses[2];
+    for (int i = 0; i < NumInstances * numSkinFloats; i++) {
+        refPoses[0].Add(0.0f);
+        refPoses[1].Add(0.0f);
+    }
+    for (int frame = 0; frame < 3; frame++) {
+        refMgr.newFrame();
+        lodMgr.newFrame();
+        for (int i = 0; i < NumInstances; i++) {
+            CHECK(refMgr.addActiveInstance(refMgr.lookupInstance(refInsts[i])));
+            CHECK(lodMgr.addActiveInstance(lodMgr.lookupInstance(lodInsts[i])));
+        }
+        refMgr.evaluate(1.0 / 60.0);
+        lodMgr.evaluate(1.0 / 60.0);
+        for (int i = 0; i < NumInstances; i++) {
+            const animInstance* refInst = refMgr.lookupInstance(refInsts[i]);
+            const animInstance* lodInst = lodMgr.lookupInstance(lodInsts[i]);
+            const float* ref = refInst->skinMatrices.begin();
+            const float* out = lodInst->skinMatrices.begin();
+            float* ref0 = &refPoses[0][i * numSkinFloats];
+            float* ref1 = &refPoses[1][i * numSkinFloats];
+            if (0 == frame) {
+                // no history yet, the evaluated pose is used as is
+                CHECK(0 == std::memcmp(ref, out, numSkinFloats * sizeof(float)));
+                std::memcpy(ref0, ref, numSkinFloats * sizeof(float));
+            }
+            else if (1 == frame) {
+                std::memcpy(ref1, ref, numSkinFloats * sizeof(float));
+                if (lodInst->lodEval) {
+                    // halfway between the first and the new pose
+                    for (int j = 0; j < numSkinFloats; j++) {
+                        CHECK_CLOSE(ref0[j] + (ref1[j] - ref0[j]) * 0.5f, out[j], 0.0001f);
+                    }
+                }
+                else {
+                    CHECK(0 == std::memcmp(ref0, out, numSkinFloats * sizeof(float)));
+                }
+            }
+            else if (lodInst->lodEval) {
+                // evaluated for the first time after frame 0
+                for (int j = 0; j < numSkinFloats; j++) {
+                    CHECK_CLOSE(ref0[j] + (ref[j] - ref0[j]) * 0.5f, out[j], 0.0001f);
+                }
+            }
+            else {
+                // skipped after the second evaluation, interpolation reached the last pose
+                for (int j = 0; j < numSkinFloats; j++) {
+                    CHECK_CLOSE(ref1[j], out[j], 0.0001f);
+                }
+            }
+        }
+    }
+    refMgr.discard();
+    lodMgr.discard();
+}
+
+//------------------------------------------------------------------------------
+TEST(AnimEvaluateBoneLodTest) {
+    // with bone LOD 1 only the first half of the bones is evaluated,
+    // the other bones copy the skin matrix of their parent
+    animMgr refMgr;
+    animMgr lodMgr;
+    Id refInsts[NumInstances];
+    Id lodInsts[NumInstances];
+    setupScene(refMgr, refInsts);
+    setupScene(lodMgr, lodInsts);
+    const AnimSkeleton* skel = lodMgr.lookupInstance(lodInsts[0])->skeleton;
+    CHECK(skel->NumLods == 2);
+    CHECK(skel->LodNumBones[0] == NumBones);
+    CHECK(skel->LodNumBones[1] == NumBones / 2);
+    for (int i = 0; i < NumInstances; i++) {
+        lodMgr.setBoneLod(lodMgr.lookupInstance(lodInsts[i]), 1);
+    }
+    advanceTime(refMgr, 1.0);
+    advanceTime(lodMgr, 1.0);
+    refMgr.newFrame();
+    lodMgr.newFrame();
+    for (int i = 0; i < NumInstances; i++) {
+        CHECK(refMgr.addActiveInstance(refMgr.lookupInstance(refInsts[i])));
+        CHECK(lodMgr.addActiveInstance(lodMgr.lookupInstance(lodInsts[i])));
+    }
+    refMgr.evaluate(1.0 / 60.0);
+    lodMgr.evaluate(1.0 / 60.0);
+    const int numLodBones = NumBones / 2;
+    for (int i = 0; i < NumInstances; i++) {
+        const animInstance* refInst = refMgr.lookupInstance(refInsts[i]);
+        const animInstance* lodInst = lodMgr.lookupInstance(lodInsts[i]);
+        CHECK(0 == std::memcmp(refInst->samples.begin(), lodInst->samples.begin(), numLodBones * 10 * sizeof(float)));
+        CHECK(0 == std::memcmp(refInst->skinMatrices.begin(), lodInst->skinMatrices.begin(), numLodBones * 12 * sizeof(float)));
+        for (int bone = numLodBones; bone < NumBones; bone++) {
+            CHECK(0 == std::memcmp(&lodInst->skinMatrices[(numLodBones - 1) * 12], &lodInst->skinMatrices[bone * 12], 12 * sizeof(float)));
+        }
+        // the samples outside the LOD hold the static pose of the played clip
+        const animSamplePlan* plan = &lodMgr.samplePlans[lodInst->library->Id.SlotIndex];
+        const int clipIndex = lodInst->sequencer.items[lodInst->sequencer.firstVisibleItem(lodMgr.curTime)].clipIndex;
+        const float* fallback = &plan->fallback[plan->clips[clipIndex].firstValue];
+        for (int s = numLodBones * 10; s < NumBones * 10; s++) {
+            CHECK(lodInst->samples[s] == fallback[s]);
+        }
+    }
+
+    // playing another clip refills the samples outside the LOD
+    animInstance* lodInst = lodMgr.lookupInstance(lodInsts[0]);
+    const int prevClip = lodInst->lodTailClip;
+    CHECK(InvalidIndex != prevClip);
+    AnimJob job;
+    job.ClipIndex = prevClip ^ 1;
+    lodMgr.stopAll(lodInst, false);
+    lodMgr.play(lodInst, job);
+    lodMgr.newFrame();
+    CHECK(lodMgr.addActiveInstance(lodInst));
+    lodMgr.evaluate(1.0 / 60.0);
+    CHECK(lodInst->lodTailClip == job.ClipIndex);
+    const animSamplePlan* plan = &lodMgr.samplePlans[lodInst->library->Id.SlotIndex];
+    const float* fallback = &plan->fallback[plan->clips[job.ClipIndex].firstValue];
+    for (int s = numLodBones * 10; s < NumBones * 10; s++) {
+        CHECK(lodInst->samples[s] == fallback[s]);
+    }
+    refMgr.discard();
+    lodMgr.discard();
+
+    // half-float samples outside the LOD hold the static pose too
+    animMgr halfMgr;
+    Id halfInsts[NumInstances];
+    sceneSetup halfScene;
+    halfScene.anim.NumOutputBuffers = 2;
+    halfScene.anim.HalfFloatSkinMatrixTable = true;
+    halfScene.inst.HalfFloatSamples = true;
+    setupScene(halfMgr, halfInsts, halfScene);
+    for (int i = 0; i < NumInstances; i++) {
+        halfMgr.setBoneLod(halfMgr.lookupInstance(halfInsts[i]), 1);
+    }
+    advanceTime(halfMgr, 1.0);
+    for (int frame = 0; frame < 2; frame++) {
+        halfMgr.newFrame();
+        for (int i = 0; i < NumInstances; i++) {
+            CHECK(halfMgr.addActiveInstance(halfMgr.lookupInstance(halfInsts[i])));
+        }
+        halfMgr.evaluate(1.0 / 60.0);
+    }
+    const animInstance* halfInst = halfMgr.lookupInstance(halfInsts[0]);
+    const int clipIndex = halfInst->sequencer.items[halfInst->sequencer.firstVisibleItem(halfMgr.curTime)].clipIndex;
+    plan = &halfMgr.samplePlans[halfInst->library->Id.SlotIndex];
+    fallback = &plan->fallback[plan->clips[clipIndex].firstValue];
+    float unpacked[NumBones * 10];
+    animHalfToFloat((const uint16_t*)&halfInst->packedSamples[AnimConfig::NumFullPrecisionSamples],
+        &unpacked[AnimConfig::NumFullPrecisionSamples], NumBones * 10 - AnimConfig::NumFullPrecisionSamples);
+    for (int s = numLodBones * 10; s < NumBones * 10; s++) {
+        CHECK_CLOSE(fallback[s], unpacked[s], 0.002f);
+    }
+    halfMgr.discard();
+}
+
+//------------------------------------------------------------------------------
+TEST(AnimEvaluateFusedTest) {
+    // instances which only need skin matrices sample a single clip of a
+    // TRS library straight into the skin matrices, with the same result
+    animMgr refMgr;
+    animMgr mgr;
+    Id refInsts[NumInstances];
+    Id insts[NumInstances];
+    setupScene(refMgr, refInsts);
+    sceneSetup skinOnlyScene;
+    skinOnlyScene.anim.NumWorkerThreads = 2;
+    skinOnlyScene.inst.SkinMatricesOnly = true;
+    setupScene(mgr, insts, skinOnlyScene);
+    const animInstance* inst0 = mgr.lookupInstance(insts[0]);
+    CHECK(inst0->skinOnly);
+    CHECK(mgr.samplePlans[inst0->library->Id.SlotIndex].layout == animSamplePlan::TRS);
+    for (int i = 0; i < NumInstances; i++) {
+        // a single job, every 4th instance mixes a second job (generic
+        // path), every 5th instance has a reduced bone LOD
+        animInstance* refInst = refMgr.lookupInstance(refInsts[i]);
+        animInstance* inst = mgr.lookupInstance(insts[i]);
+        refMgr.stopAll(refInst, false);
+        mgr.stopAll(inst, false);
+        AnimJob job;
+        job.ClipIndex = i & 1;
+        job.StartTime = float(i) * 0.01f;
+        refMgr.play(refInst, job);
+        mgr.play(inst, job);
+        if (3 == (i & 3)) {
+            job.ClipIndex = (i + 1) & 1;
+            job.TrackIndex = 1;
+            job.MixWeight = 0.5f;
+            refMgr.play(refInst, job);
+            mgr.play(inst, job);
+        }
+        if (0 == (i % 5)) {
+            refMgr.setBoneLod(refInst, 1);
+            mgr.setBoneLod(inst, 1);
+        }
+    }
+    advanceTime(refMgr, 1.0);
+    advanceTime(mgr, 1.0);
+    for (int frame = 0; frame < 3; frame++) {
+        refMgr.newFrame();
+        mgr.newFrame();
+        for (int i = 0; i < NumInstances; i++) {
+            CHECK(refMgr.addActiveInstance(refMgr.lookupInstance(refInsts[i])));
+            CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+        }
+        refMgr.evaluate(1.0 / 60.0);
+        mgr.evaluate(1.0 / 60.0);
+        for (int i = 0; i < NumInstances; i++) {
+            const animInstance* refInst = refMgr.lookupInstance(refInsts[i]);
+            const animInstance* inst = mgr.lookupInstance(insts[i]);
+            CHECK(!refInst->fusedEval);
+            CHECK(inst->fusedEval == (3 != (i & 3)));
+        }
+        CHECK(samePoses(refMgr, refInsts, mgr, insts));
+        #if ORYOL_ANIM_FRAME_STATS
+        CHECK(mgr.frameStats.NumItemsProcessed == refMgr.frameStats.NumItemsProcessed);
+        CHECK(mgr.frameStats.NumItemsSkipped == refMgr.frameStats.NumItemsSkipped);
+        CHECK(mgr.frameStats.NumCurvesSampled == refMgr.frameStats.NumCurvesSampled);
+        CHECK(mgr.frameStats.NumKeysSampled == refMgr.frameStats.NumKeysSampled);
+        #endif
+    }
+    refMgr.discard();
+    mgr.discard();
+}
+
+//------------------------------------------------------------------------------
+TEST(AnimEvaluateMaskTest) {
+    animMgr mgr;
+    Id insts[NumInstances];
+    setupScene(mgr, insts);
+    const AnimLibrary* lib = mgr.lookupInstance(insts[0])->library;
+    const animSamplePlan* plan = &mgr.samplePlans[lib->Id.SlotIndex];
+    CHECK(lib->SampleStride == NumBones * 10);
+
+    // adjacent curves are merged into lane ranges
+    AnimMaskSetup maskSetup;
+    maskSetup.Locator = "mask0";
+    maskSetup.Library = lib->Id;
+    maskSetup.Curves = { 4, 0, 1 };
+    Id maskId0 = mgr.createMask(maskSetup);
+    const AnimMask* mask0 = mgr.lookupMask(maskId0);
+    CHECK(mask0);
+    CHECK(mask0->Ranges.Size() == 2);
+    CHECK((mask0->Ranges[0].First == 0) && (mask0->Ranges[0].Num == 7));
+    CHECK((mask0->Ranges[1].First == 13) && (mask0->Ranges[1].Num == 4));
+
+    // an 'upper body' mask with the last 2 bones
+    maskSetup.Locator = "upper";
+    maskSetup.Curves = { 6, 7, 8, 9, 10, 11 };
+    Id maskId1 = mgr.createMask(maskSetup);
+    const AnimMask* mask1 = mgr.lookupMask(maskId1);
+    CHECK(mask1->Ranges.Size() == 1);
+    CHECK((mask1->Ranges[0].First == 20) && (mask1->Ranges[0].Num == 20));
+
+    // a full-weight masked overlay doesn't occlude the base track,
+    // and only replaces the masked lanes
+    const double time = 0.1;
+    AnimJob baseJob;
+    baseJob.ClipIndex = 0;
+    AnimJob overlayJob;
+    overlayJob.ClipIndex = 1;
+    overlayJob.TrackIndex = 1;
+    animSequencer base, overlay, layered;
+    base.add(0.0, 1, baseJob, 1.0);
+    overlay.add(0.0, 2, overlayJob, 1.0);
+    layered.add(0.0, 1, baseJob, 1.0);
+    layered.add(0.0, 2, overlayJob, 1.0, mask1);
+    CHECK(layered.firstVisibleItem(time) == 0);
+    float baseSamples[NumBones * 10], overlaySamples[NumBones * 10], layeredSamples[NumBones * 10];
+    CHECK(base.eval(lib, plan, time, baseSamples, lib->SampleStride));
+    CHECK(overlay.eval(lib, plan, time, overlaySamples, lib->SampleStride));
+    CHECK(layered.eval(lib, plan, time, layeredSamples, lib->SampleStride));
+    for (int i = 0; i < 20; i++) {
+        CHECK(layeredSamples[i] == baseSamples[i]);
+    }
+    for (int i = 20; i < 40; i++) {
+        CHECK_CLOSE(overlaySamples[i], layeredSamples[i], 0.0001f);
+    }
+
+    // a masked job as the only job leaves the other lanes at the fallback pose
+    animSequencer masked;
+    masked.add(0.0, 3, overlayJob, 1.0, mask1);
+    CHECK(masked.eval(lib, plan, time, layeredSamples, lib->SampleStride));
+    const float* fallback = &plan->fallback[plan->clips[1].firstValue];
+    for (int i = 0; i < 20; i++) {
+        CHECK(layeredSamples[i] == fallback[i]);
+    }
+    for (int i = 20; i < 40; i++) {
+        CHECK(layeredSamples[i] == overlaySamples[i]);
+    }
+    #if ORYOL_ANIM_FRAME_STATS
+    // only the masked curves count as sampled
+    animSequencer::evalStats maskStats;
+    CHECK(masked.eval(lib, plan, time, layeredSamples, lib->SampleStride, &maskStats));
+    CHECK(maskStats.numCurves == 6);
+    CHECK(maskStats.numKeys == 2 * 7 * 2);
+    #endif
+
+    // masks go through Anim jobs on instances
+    animInstance* inst = mgr.lookupInstance(insts[0]);
+    overlayJob.Mask = maskId1;
+    const AnimJobId jobId = mgr.play(inst, overlayJob);
+    CHECK(InvalidAnimJobId != jobId);
+    for (const auto& item : inst->sequencer.items) {
+        CHECK(item.mask == ((item.id == jobId) ? mask1 : nullptr));
+    }
+
+    // destroying the mask strips it from queued jobs, a new mask which
+    // may reuse the slot doesn't apply to them
+    mgr.destroyMask(maskId1);
+    CHECK(!mgr.lookupMask(maskId1));
+    maskSetup.Locator = "upper2";
+    CHECK(mgr.lookupMask(mgr.createMask(maskSetup)));
+    for (const auto& item : inst->sequencer.items) {
+        CHECK(nullptr == item.mask);
+    }
+    mgr.discard();
+}
+
+//------------------------------------------------------------------------------
+TEST(AnimEvaluatePoseCacheTest) {
+    // instances playing the same clip in the same phase share one evaluation
+    animMgr refMgr;
+    animMgr mgr;
+    Id refInsts[NumInstances];
+    Id insts[NumInstances];
+    setupScene(refMgr, refInsts);
+    setupScene(mgr, insts);
+    mgr.animSetup.PoseCacheEnabled = true;
+    AnimJob job;
+    for (int i = 0; i < NumInstances; i++) {
+        job.ClipIndex = i & 1;
+        refMgr.stopAll(refMgr.lookupInstance(refInsts[i]), false);
+        refMgr.play(refMgr.lookupInstance(refInsts[i]), job);
+        mgr.stopAll(mgr.lookupInstance(insts[i]), false);
+        mgr.play(mgr.lookupInstance(insts[i]), job);
+    }
+    for (int frame = 0; frame < 3; frame++) {
+        refMgr.newFrame();
+        mgr.newFrame();
+        for (int i = 0; i < NumInstances; i++) {
+            CHECK(refMgr.addActiveInstance(refMgr.lookupInstance(refInsts[i])));
+            CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+        }
+        refMgr.evaluate(1.0 / 60.0);
+        mgr.evaluate(1.0 / 60.0);
+        CHECK(refMgr.numPoseCacheHits == 0);
+        CHECK(mgr.numPoseCacheMisses == 2);
+        CHECK(mgr.numPoseCacheHits == NumInstances - 2);
+        CHECK(mgr.numEvaluatedInstances == 2);
+        const animInstance* owners[2] = { mgr.lookupInstance(insts[0]), mgr.lookupInstance(insts[1]) };
+        for (int i = 0; i < NumInstances; i++) {
+            const animInstance* inst = mgr.lookupInstance(insts[i]);
+            CHECK(inst->samples.begin() == owners[i & 1]->samples.begin());
+            CHECK(inst->skinMatrices.begin() == owners[i & 1]->skinMatrices.begin());
+            CHECK(mgr.skinMatrixInfo->InstanceInfos[i].ShaderInfo.x == mgr.skinMatrixInfo->InstanceInfos[i & 1].ShaderInfo.x);
+            CHECK(mgr.skinMatrixInfo->InstanceInfos[i].ShaderInfo.y == mgr.skinMatrixInfo->InstanceInfos[i & 1].ShaderInfo.y);
+        }
+        CHECK(samePoses(refMgr, refInsts, mgr, insts));
+    }
+
+    // aliasing instances which lose their anim jobs keep the shared pose
+    // of the previous frame, and don't share their kept poses
+    for (int i = 2; i < 4; i++) {
+        refMgr.stopAll(refMgr.lookupInstance(refInsts[i]), false);
+        mgr.stopAll(mgr.lookupInstance(insts[i]), false);
+    }
+    refMgr.newFrame();
+    mgr.newFrame();
+    for (int i = 0; i < NumInstances; i++) {
+        CHECK(refMgr.addActiveInstance(refMgr.lookupInstance(refInsts[i])));
+        CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+    }
+    refMgr.evaluate(1.0 / 60.0);
+    mgr.evaluate(1.0 / 60.0);
+    CHECK(mgr.numPoseCacheMisses == 2);
+    CHECK(mgr.numPoseCacheHits == NumInstances - 4);
+    for (int i = 2; i < 4; i++) {
+        CHECK(mgr.lookupInstance(insts[i])->samples.begin() != mgr.lookupInstance(insts[i & 1])->samples.begin());
+    }
+    CHECK(samePoses(refMgr, refInsts, mgr, insts, 2, 4));
+
+    // a different phase or an extra job is a different pose
+    job.ClipIndex = 0;
+    job.StartTime = -0.5f;
+    mgr.play(mgr.lookupInstance(insts[2]), job);
+    job.StartTime = 0.0f;
+    job.TrackIndex = 1;
+    job.MixWeight = 0.5f;
+    mgr.play(mgr.lookupInstance(insts[4]), job);
+    mgr.newFrame();
+    for (int i = 0; i < NumInstances; i++) {
+        CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+    }
+    mgr.evaluate(1.0 / 60.0);
+    CHECK(mgr.numPoseCacheMisses == 4);
+    CHECK(mgr.numPoseCacheHits == NumInstances - 5);
+    refMgr.discard();
+    mgr.discard();
+}
+
+//------------------------------------------------------------------------------
+TEST(AnimEvaluateBakeTest) {
+    animMgr mgr;
+    Id insts[NumInstances];
+    setupScene(mgr, insts);
+    animInstance* inst0 = mgr.lookupInstance(insts[0]);
+    animInstance* inst1 = mgr.lookupInstance(insts[1]);
+    const AnimLibrary* lib = inst0->library;
+    const AnimClip& clip = lib->Clips[1];
+
+    AnimBakeSetup bakeSetup;
+    bakeSetup.Locator = "bake";
+    bakeSetup.Library = lib->Id;
+    bakeSetup.Skeleton = inst0->skeleton->Id;
+    bakeSetup.Clips = { 1 };
+    Id bakeId = mgr.createBake(bakeSetup);
+    const AnimBake* bake = mgr.lookupBake(bakeId);
+    CHECK(bake);
+    CHECK(bake->NumBones == NumBones);
+    CHECK(bake->NumFrames == clip.Length);
+    CHECK(bake->Clips.Size() == 1);
+    CHECK(bake->Clips[0].ClipIndex == 1);
+    CHECK(bake->Clips[0].FirstFrame == 0);
+    CHECK(bake->Clips[0].FrameDuration == clip.KeyDuration);
+    CHECK(bake->Matrices.Size() == clip.Length * NumBones * 12);
+
+    // instance 0 evaluates clip 1 at each key frame, instance 1 plays
+    // the baked clip, the results must match without evaluating it
+    AnimJob job;
+    job.ClipIndex = 1;
+    mgr.stopAll(inst0, false);
+    mgr.play(inst0, job);
+    mgr.playBaked(inst1, bake, 1, 0.0f);
+    CHECK(inst1->bake == bakeId);
+    for (int frame = 0; frame < clip.Length + 2; frame++) {
+        mgr.newFrame();
+        CHECK(mgr.addActiveInstance(inst0));
+        CHECK(mgr.addActiveInstance(inst1));
+        CHECK(mgr.numEvaluatedInstances == 1);
+        mgr.evaluate(clip.KeyDuration);
+        const float* row = &bake->Matrices[(frame % clip.Length) * NumBones * 12];
+        for (int i = 0; i < NumBones * 12; i++) {
+            CHECK_CLOSE(inst0->skinMatrices[i], row[i], 0.001f);
+            CHECK(inst1->skinMatrices[i] == row[i]);
+        }
+    }
+    mgr.stopBaked(inst1);
+    CHECK(!inst1->bake.IsValid());
+
+    // destroying a bake which is still played falls back to evaluation
+    mgr.playBaked(inst1, bake, 1, 0.0f);
+    mgr.destroyBake(bakeId);
+    CHECK(!mgr.lookupBake(bakeId));
+    mgr.stopAll(inst0, false);
+    mgr.stopAll(inst1, false);
+    mgr.play(inst0, job);
+    mgr.play(inst1, job);
+    mgr.newFrame();
+    CHECK(mgr.addActiveInstance(inst0));
+    CHECK(mgr.addActiveInstance(inst1));
+    CHECK(!inst1->bake.IsValid());
+    CHECK(mgr.numEvaluatedInstances == 2);
+    mgr.evaluate(clip.KeyDuration);
+    for (int i = 0; i < NumBones * 12; i++) {
+        CHECK(inst1->skinMatrices[i] == inst0->skinMatrices[i]);
+    }
+    mgr.discard();
+}
+
+//------------------------------------------------------------------------------
+TEST(AnimEvaluateDirtyTrackingTest) {
+    // instances without active anim jobs keep their pose from the previous frame
+    animMgr refMgr;
+    animMgr mgr;
+    Id refInsts[NumInstances];
+    Id insts[NumInstances];
+    setupScene(refMgr, refInsts);
+    setupScene(mgr, insts);
+    refMgr.animSetup.DirtyTrackingEnabled = false;
+    CHECK(mgr.animSetup.DirtyTrackingEnabled);
+    advanceTime(refMgr, 1.0);
+    advanceTime(mgr, 1.0);
+    const int numStopped = NumInstances / 2;
+    for (int frame = 0; frame < 4; frame++) {
+        if (1 == frame) {
+            for (int i = 0; i < numStopped; i++) {
+                refMgr.stopAll(refMgr.lookupInstance(refInsts[i]), false);
+                mgr.stopAll(mgr.lookupInstance(insts[i]), false);
+            }
+        }
+        refMgr.newFrame();
+        mgr.newFrame();
+        for (int i = 0; i < NumInstances; i++) {
+            CHECK(refMgr.addActiveInstance(refMgr.lookupInstance(refInsts[i])));
+            CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+        }
+        refMgr.evaluate(1.0 / 60.0);
+        mgr.evaluate(1.0 / 60.0);
+        const bool skipped = frame > 1;
+        CHECK(refMgr.numUnchangedInstances == 0);
+        CHECK(mgr.numUnchangedInstances == (skipped ? numStopped : 0));
+        CHECK(mgr.numEvaluatedInstances == (skipped ? NumInstances - numStopped : NumInstances));
+        for (int i = 0; i < NumInstances; i++) {
+            CHECK(mgr.skinMatrixInfo->InstanceInfos[i].Changed == (!skipped || (i >= numStopped)));
+        }
+        CHECK(samePoses(refMgr, refInsts, mgr, insts));
+    }
+
+    // a new anim job changes the pose
+    AnimJob job;
+    mgr.play(mgr.lookupInstance(insts[0]), job);
+    mgr.newFrame();
+    for (int i = 0; i < NumInstances; i++) {
+        CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+    }
+    mgr.evaluate(1.0 / 60.0);
+    CHECK(mgr.numUnchangedInstances == numStopped - 1);
+    CHECK(mgr.skinMatrixInfo->InstanceInfos[0].Changed);
+
+    // instances which weren't active in the previous frame are evaluated
+    advanceTime(mgr, 1.0 / 60.0);
+    mgr.newFrame();
+    for (int i = 0; i < NumInstances; i++) {
+        CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+    }
+    mgr.evaluate(1.0 / 60.0);
+    CHECK(mgr.numUnchangedInstances == 0);
+    CHECK(mgr.numEvaluatedInstances == NumInstances);
+    refMgr.discard();
+    mgr.discard();
+}
+
+//------------------------------------------------------------------------------
+TEST(AnimEvaluateStableSlotsTest) {
+    // active instances keep their skin matrix table position across frames
+    animMgr mgr;
+    Id insts[NumInstances];
+    setupScene(mgr, insts);
+    const int numPerRow = mgr.animSetup.SkinMatrixTableWidth / (NumBones * 3);
+    const int numRows = (NumInstances + numPerRow - 1) / numPerRow;
+    mgr.newFrame();
+    for (int i = 0; i < NumInstances; i++) {
+        CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+    }
+    mgr.evaluate(1.0 / 60.0);
+    glm::vec4 shaderInfos[NumInstances];
+    for (int i = 0; i < NumInstances; i++) {
+        shaderInfos[i] = mgr.skinMatrixInfo->InstanceInfos[i].ShaderInfo;
+    }
+    CHECK(mgr.skinMatrixInfo->Pages[0].DirtyRows.Size() == 1);
+    CHECK(mgr.skinMatrixInfo->Pages[0].DirtyRows[0].FirstRow == 0);
+    CHECK(mgr.skinMatrixInfo->Pages[0].DirtyRows[0].NumRows == numRows);
+
+    // adding the instances in a different order doesn't move them
+    mgr.newFrame();
+    for (int i = NumInstances - 1; i >= 0; i--) {
+        CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+    }
+    mgr.evaluate(1.0 / 60.0);
+    for (int i = 0; i < NumInstances; i++) {
+        const auto& info = mgr.skinMatrixInfo->InstanceInfos[NumInstances - 1 - i];
+        CHECK(info.Instance == insts[i]);
+        CHECK(info.ShaderInfo.x == shaderInfos[i].x);
+        CHECK(info.ShaderInfo.y == shaderInfos[i].y);
+    }
+
+    // only rows with changed instances are dirty
+    for (int i = 0; i < NumInstances; i++) {
+        mgr.stopAll(mgr.lookupInstance(insts[i]), false);
+    }
+    for (int frame = 0; frame < 2; frame++) {
+        mgr.newFrame();
+        for (int i = 0; i < NumInstances; i++) {
+            CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+        }
+        mgr.evaluate(1.0 / 60.0);
+    }
+    CHECK(mgr.skinMatrixInfo->Pages[0].DirtyRows.Empty());
+    AnimJob job;
+    mgr.play(mgr.lookupInstance(insts[NumInstances - 1]), job);
+    mgr.newFrame();
+    for (int i = 0; i < NumInstances; i++) {
+        CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+    }
+    mgr.evaluate(1.0 / 60.0);
+    CHECK(mgr.skinMatrixInfo->Pages[0].DirtyRows.Size() == 1);
+    CHECK(mgr.skinMatrixInfo->Pages[0].DirtyRows[0].FirstRow == numRows - 1);
+    CHECK(mgr.skinMatrixInfo->Pages[0].DirtyRows[0].NumRows == 1);
+
+    // slots of instances which are not active for a frame are released
+    const int stride = mgr.lookupInstance(insts[0])->library->SampleStride;
+    for (int frame = 0; frame < 2; frame++) {
+        mgr.newFrame();
+        for (int i = 0; i < NumInstances / 2; i++) {
+            CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+        }
+        mgr.evaluate(1.0 / 60.0);
+    }
+    CHECK(mgr.slotInstances.Size() == NumInstances / 2);
+    CHECK(mgr.sampleAllocator.numUsed == (NumInstances / 2) * stride);
+    mgr.discard();
+}
+
+//------------------------------------------------------------------------------
+TEST(AnimEvaluateSkinPagesTest) {
+    // single-row pages hold 85 instances, the others spill into a second page
+    animMgr refMgr;
+    animMgr mgr;
+    animMgr fullMgr;
+    Id refInsts[NumInstances];
+    Id insts[NumInstances];
+    Id fullInsts[NumInstances];
+    setupScene(refMgr, refInsts);
+    sceneSetup pagedScene;
+    pagedScene.anim.SkinMatrixTableHeight = 1;
+    pagedScene.anim.MaxNumSkinMatrixPages = 2;
+    setupScene(mgr, insts, pagedScene);
+    sceneSetup fullScene;
+    fullScene.anim.SkinMatrixTableHeight = 1;
+    setupScene(fullMgr, fullInsts, fullScene);
+    const int numPerPage = mgr.animSetup.SkinMatrixTableWidth / (NumBones * 3);
+    CHECK(mgr.skinPages.Size() == 1);
+    CHECK(mgr.skinMatrixInfo->Pages.Size() == 1);
+    advanceTime(refMgr, 1.0);
+    advanceTime(mgr, 1.0);
+    refMgr.newFrame();
+    mgr.newFrame();
+    for (int i = 0; i < NumInstances; i++) {
+        CHECK(refMgr.addActiveInstance(refMgr.lookupInstance(refInsts[i])));
+        CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+    }
+    refMgr.evaluate(1.0 / 60.0);
+    mgr.evaluate(1.0 / 60.0);
+    CHECK(mgr.skinPages.Size() == 2);
+    const AnimSkinMatrixInfo& info = *mgr.skinMatrixInfo;
+    CHECK(info.Pages.Size() == 2);
+    CHECK(info.Pages[0].SkinMatrixTable != info.Pages[1].SkinMatrixTable);
+    for (int pageIndex = 0; pageIndex < 2; pageIndex++) {
+        CHECK(info.Pages[pageIndex].SkinMatrixTableByteSize == mgr.animSetup.SkinMatrixTableWidth * 4 * int(sizeof(float)));
+        CHECK(info.Pages[pageIndex].DirtyRows.Size() == 1);
+    }
+    for (int i = 0; i < NumInstances; i++) {
+        CHECK(info.InstanceInfos[i].Page == (i < numPerPage ? 0 : 1));
+        CHECK(info.InstanceInfos[i].ShaderInfo.y == 0.5f);
+        const animInstance* inst = mgr.lookupInstance(insts[i]);
+        const float* table = info.Pages[info.InstanceInfos[i].Page].SkinMatrixTable;
+        CHECK(inst->skinMatrices.begin() == table + inst->skinSlotX * 4);
+    }
+    CHECK(samePoses(refMgr, refInsts, mgr, insts));
+    #if ORYOL_ANIM_FRAME_STATS
+    // the 4 pixels at the end of the first page are too small for a slot
+    const float tablePixels = float(2 * mgr.animSetup.SkinMatrixTableWidth);
+    CHECK(mgr.frameStats.NumSkinMatrixPages == 2);
+    CHECK(mgr.frameStats.SkinMatrixTableFill == float(NumInstances * NumBones * 3) / tablePixels);
+    CHECK(mgr.frameStats.SkinMatrixTableFragmentation == 0.0f);
+    CHECK(mgr.frameStats.SkinMatrixTableWaste == 4.0f / tablePixels);
+    #endif
+
+    // a slot released on the first page is fragmentation, and is reused
+    // before the second page
+    for (int frame = 0; frame < 2; frame++) {
+        mgr.newFrame();
+        for (int i = 0; i < NumInstances; i++) {
+            if ((i != 1) && (i != 3)) {
+                CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+            }
+        }
+        mgr.evaluate(1.0 / 60.0);
+    }
+    #if ORYOL_ANIM_FRAME_STATS
+    CHECK(mgr.frameStats.SkinMatrixTableFragmentation > 0.0f);
+    #endif
+    mgr.newFrame();
+    CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[3])));
+    CHECK(mgr.skinMatrixInfo->InstanceInfos[0].Page == 0);
+    mgr.evaluate(1.0 / 60.0);
+
+    // without a second page, the instances which don't fit are rejected
+    fullMgr.newFrame();
+    for (int i = 0; i < NumInstances; i++) {
+        CHECK(fullMgr.addActiveInstance(fullMgr.lookupInstance(fullInsts[i])) == (i < numPerPage));
+    }
+    fullMgr.evaluate(1.0 / 60.0);
+    CHECK(fullMgr.skinPages.Size() == 1);
+    #if ORYOL_ANIM_FRAME_STATS
+    CHECK(fullMgr.frameStats.NumRejectedSkinMatrixTable == NumInstances - numPerPage);
+    #endif
+    refMgr.discard();
+    mgr.discard();
+    fullMgr.discard();
+
+    // half-float instances are rejected for the skin matrix table while the
+    // sample pool still has room for their smaller sample slots
+    animMgr halfMgr;
+    Id halfInsts[NumInstances];
+    sceneSetup halfScene;
+    halfScene.anim.SkinMatrixTableHeight = 1;
+    halfScene.anim.HalfFloatSkinMatrixTable = true;
+    halfScene.inst.HalfFloatSamples = true;
+    setupScene(halfMgr, halfInsts, halfScene);
+    halfMgr.newFrame();
+    for (int i = 0; i < numPerPage; i++) {
+        CHECK(halfMgr.addActiveInstance(halfMgr.lookupInstance(halfInsts[i])));
+    }
+    const animInstance* halfInst = halfMgr.lookupInstance(halfInsts[0]);
+    const int halfSize = halfMgr.sampleAllocator.numUsed / numPerPage;
+    CHECK(halfSize < halfInst->library->SampleStride);
+    const int numFree = halfMgr.sampleAllocator.capacity - halfMgr.sampleAllocator.numUsed;
+    const int fillOffset = halfMgr.sampleAllocator.alloc(numFree - halfSize);
+    CHECK(InvalidIndex != fillOffset);
+    CHECK(!halfMgr.addActiveInstance(halfMgr.lookupInstance(halfInsts[numPerPage])));
+    const int lastOffset = halfMgr.sampleAllocator.alloc(halfSize);
+    CHECK(InvalidIndex != lastOffset);
+    CHECK(!halfMgr.addActiveInstance(halfMgr.lookupInstance(halfInsts[numPerPage + 1])));
+    #if ORYOL_ANIM_FRAME_STATS
+    CHECK(halfMgr.frameStats.NumRejectedSkinMatrixTable == 1);
+    CHECK(halfMgr.frameStats.NumRejectedSamplePool == 1);
+    #endif
+    halfMgr.evaluate(1.0 / 60.0);
+    halfMgr.sampleAllocator.free(fillOffset, numFree - halfSize);
+    halfMgr.sampleAllocator.free(lastOffset, halfSize);
+    halfMgr.discard();
+}
+
+//------------------------------------------------------------------------------
+TEST(AnimEvaluateOutputBuffersTest) {
+    // an acquired frame output stays intact while the next frames are evaluated
+    animMgr refMgr;
+    animMgr mgr;
+    Id refInsts[NumInstances];
+    Id insts[NumInstances];
+    setupScene(refMgr, refInsts);
+    sceneSetup outputScene;
+    outputScene.anim.NumOutputBuffers = 2;
+    setupScene(mgr, insts, outputScene);
+    refMgr.animSetup.DirtyTrackingEnabled = false;
+    CHECK(mgr.acquireOutput() == InvalidIndex);
+    advanceTime(refMgr, 1.0);
+    advanceTime(mgr, 1.0);
+    const int numFloats = mgr.animSetup.SkinMatrixTableWidth * mgr.animSetup.SkinMatrixTableHeight * 4;
+    Array<float> acquired;
+    int acquiredIndex = InvalidIndex;
+    for (int frame = 0; frame < 6; frame++) {
+        if (2 == frame) {
+            // unchanged instances copy their pose from the previous output
+            for (int i = 0; i < NumInstances / 2; i++) {
+                refMgr.stopAll(refMgr.lookupInstance(refInsts[i]), false);
+                mgr.stopAll(mgr.lookupInstance(insts[i]), false);
+            }
+        }
+        refMgr.newFrame();
+        mgr.newFrame();
+        CHECK(mgr.curOutput != acquiredIndex);
+        for (int i = 0; i < NumInstances; i++) {
+            CHECK(refMgr.addActiveInstance(refMgr.lookupInstance(refInsts[i])));
+            CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+        }
+        refMgr.evaluate(1.0 / 60.0);
+        mgr.evaluate(1.0 / 60.0);
+        CHECK(mgr.numUnchangedInstances == (frame > 2 ? NumInstances / 2 : 0));
+        CHECK(samePoses(refMgr, refInsts, mgr, insts));
+        if (1 == frame) {
+            acquiredIndex = mgr.acquireOutput();
+            CHECK(acquiredIndex == mgr.curOutput);
+            const float* table = mgr.outputs[acquiredIndex].skinMatrixInfo.Pages[0].SkinMatrixTable;
+            for (int i = 0; i < numFloats; i++) {
+                acquired.Add(table[i]);
+            }
+        }
+    }
+    // with one of two buffers acquired, all frames went into the other buffer
+    CHECK(0 == std::memcmp(acquired.begin(), mgr.outputs[acquiredIndex].skinMatrixInfo.Pages[0].SkinMatrixTable, numFloats * sizeof(float)));
+    mgr.releaseOutput(acquiredIndex);
+    mgr.newFrame();
+    CHECK(mgr.curOutput == acquiredIndex);
+    mgr.evaluate(1.0 / 60.0);
+    refMgr.discard();
+    mgr.discard();
+}
+
+//------------------------------------------------------------------------------
+#if ORYOL_ANIM_FRAME_STATS
+TEST(AnimEvaluateFrameStatsTest) {
+    animMgr mgr;
+    Id insts[NumInstances];
+    sceneSetup scene;
+    scene.anim.NumWorkerThreads = 2;
+    setupScene(mgr, insts, scene);
+    advanceTime(mgr, 1.0);
+    for (int frame = 0; frame < 2; frame++) {
+        mgr.newFrame();
+        for (int i = 0; i < NumInstances; i++) {
+            CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+        }
+        // MaxNumActiveInstances is reached
+        CHECK(!mgr.addActiveInstance(mgr.lookupInstance(insts[0])));
+        mgr.evaluate(1.0 / 60.0);
+    }
+    const AnimFrameStats& stats = mgr.frameStats;
+    CHECK(stats.NumActiveInstances == NumInstances);
+    CHECK(stats.NumEvaluatedInstances == NumInstances);
+    CHECK(stats.NumUnchangedInstances == 0);
+    CHECK(stats.NumRejectedActiveLimit == 1);
+    CHECK(stats.NumRejectedSamplePool == 0);
+    // each instance has 2 jobs on different tracks, fading in for 0.2 seconds
+    CHECK(stats.NumItemsProcessed == 2 * NumInstances);
+    CHECK(stats.NumItemsSkipped == 0);
+    CHECK(stats.NumCurvesSampled == 2 * NumInstances * NumBones * 3);
+    // 2 keys of the 7 keyed lanes per bone (the scale curves are static)
+    CHECK(stats.NumKeysSampled == 2 * NumInstances * NumBones * 7 * 2);
+    CHECK(stats.MaxActiveInstances == NumInstances);
+    CHECK(stats.MaxSamples == mgr.sampleAllocator.numUsed);
+    CHECK(stats.MaxSkinMatrixPixels == NumInstances * NumBones * 3);
+    CHECK(stats.MaxClips == 2);
+    CHECK(stats.SkinMatrixTableFill > 0.0f);
+    CHECK(stats.EvaluateTime.AsNanoSeconds() >= stats.PrepareTime.AsNanoSeconds());
+
+    // only the curves and keys in the bone LOD are sampled
+    mgr.newFrame();
+    for (int i = 0; i < NumInstances; i++) {
+        mgr.setBoneLod(mgr.lookupInstance(insts[i]), 1);
+        CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+    }
+    mgr.evaluate(1.0 / 60.0);
+    CHECK(mgr.frameStats.NumCurvesSampled == 2 * NumInstances * (NumBones / 2) * 3);
+    CHECK(mgr.frameStats.NumKeysSampled == 2 * NumInstances * (NumBones / 2) * 7 * 2);
+
+    // per-frame values are reset, high-water marks are kept
+    mgr.newFrame();
+    mgr.evaluate(1.0 / 60.0);
+    CHECK(mgr.frameStats.NumActiveInstances == 0);
+    CHECK(mgr.frameStats.NumItemsProcessed == 0);
+    CHECK(mgr.frameStats.NumRejectedActiveLimit == 0);
+    CHECK(mgr.frameStats.MaxActiveInstances == NumInstances);
+    mgr.discard();
+}
+#endif
+
+//------------------------------------------------------------------------------
+static void
+cross(const float* a, const float* b, float* out) {
+    out[0] = a[1]*b[2] - a[2]*b[1];
+    out[1] = a[2]*b[0] - a[0]*b[2];
+    out[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+//------------------------------------------------------------------------------
+TEST(AnimEvaluateDualQuatTest) {
+    animMgr mgr;
+    Id insts[NumInstances];
+    sceneSetup dqScene;
+    dqScene.anim.NumWorkerThreads = 2;
+    dqScene.anim.SkinFormat = AnimSkinFormat::DualQuaternion;
+    setupScene(mgr, insts, dqScene);
+    for (int frame = 0; frame < 4; frame++) {
+        mgr.newFrame();
+        for (int i = 0; i < NumInstances; i++) {
+            CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+        }
+        mgr.evaluate(1.0 / 60.0);
+    }
+    // 2 vec4's per bone instead of 3
+    CHECK(mgr.skinMatrixInfo->InstanceInfos[0].ShaderInfo.w == 2.0f);
+    int numPixels = 0;
+    for (const auto& alloc : mgr.skinPages[0].rowAllocators) {
+        numPixels += alloc.numUsed;
+    }
+    CHECK(numPixels == NumInstances * NumBones * 2);
+    for (int i = 0; i < NumInstances; i++) {
+        const Slice<float>& dq = mgr.lookupInstance(insts[i])->skinMatrices;
+        CHECK(dq.Size() == NumBones * 8);
+        for (int b = 0; b < NumBones; b++) {
+            const float* q = &dq[b * 8];
+            CHECK_CLOSE(1.0f, q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3], 0.0001f);
+            CHECK(q[3] >= 0.0f);
+        }
+    }
+    // the batched path must produce the same result as the scalar path
+    const int numFloats = mgr.skinMatrixInfo->Pages[0].SkinMatrixTableByteSize / sizeof(float);
+    Array<float> batched;
+    batched.Reserve(numFloats);
+    for (int i = 0; i < numFloats; i++) {
+        batched.Add(mgr.skinMatrixInfo->Pages[0].SkinMatrixTable[i]);
+    }
+    for (int i = 0; i < NumInstances; i++) {
+        mgr.genSkinMatrices(mgr.lookupInstance(insts[i]));
+    }
+    CHECK(0 == std::memcmp(batched.begin(), mgr.skinMatrixInfo->Pages[0].SkinMatrixTable, numFloats * sizeof(float)));
+
+    // skeletons can override the setup's skin format
+    AnimSkeletonSetup skelSetup;
+    skelSetup.Locator = "mxSkel";
+    for (int i = 0; i < NumBones; i++) {
+        skelSetup.Bones.Add(AnimBoneSetup("bone", i - 1, glm::mat4(), glm::mat4()));
+    }
+    skelSetup.SkinFormat = AnimSkinFormat::Matrix4x3;
+    AnimSkeleton* mxSkel = mgr.lookupSkeleton(mgr.createSkeleton(skelSetup));
+    CHECK(mxSkel->SkinFormat == AnimSkinFormat::Matrix4x3);
+    skelSetup.Locator = "dqSkel";
+    skelSetup.SkinFormat = AnimSkinFormat::Default;
+    AnimSkeleton* dqSkel = mgr.lookupSkeleton(mgr.createSkeleton(skelSetup));
+    CHECK(dqSkel->SkinFormat == AnimSkinFormat::DualQuaternion);
+
+    // with unit rotations and no scale, dual quaternions must
+    // transform points like the skin matrices
+    float samples[NumBones * 10];
+    for (int b = 0; b < NumBones; b++) {
+        float* smp = &samples[b * 10];
+        const float angle = 1.0f + 1.5f * float(b);
+        const float len = sqrtf(1.0f + float(b * b) + 4.0f);
+        smp[0] = 0.5f * float(b); smp[1] = -1.0f; smp[2] = 2.0f;
+        smp[3] = sinf(angle * 0.5f) / len;
+        smp[4] = sinf(angle * 0.5f) * float(b) / len;
+        smp[5] = sinf(angle * 0.5f) * 2.0f / len;
+        smp[6] = cosf(angle * 0.5f);
+        smp[7] = smp[8] = smp[9] = 1.0f;
+    }
+    float mx[NumBones * 12];
+    float dq[NumBones * 8];
+    animInstance tmp;
+    tmp.samples = Slice<float>(samples, NumBones * 10, 0, NumBones * 10);
+    tmp.skeleton = mxSkel;
+    tmp.skinMatrices = Slice<float>(mx, NumBones * 12, 0, NumBones * 12);
+    mgr.genSkinMatrices(&tmp);
+    tmp.skeleton = dqSkel;
+    tmp.skinMatrices = Slice<float>(dq, NumBones * 8, 0, NumBones * 8);
+    mgr.genSkinMatrices(&tmp);
+    tmp.clear();
+    const float p[3] = { 1.0f, -2.0f, 3.0f };
+    for (int b = 0; b < NumBones; b++) {
+        const float* m = &mx[b * 12];
+        const float* q = &dq[b * 8];
+        const float* d = q + 4;
+        CHECK(q[3] >= 0.0f);
+        // rotate p by the real part: p + 2 * v x (v x p + w * p),
+        // the translation is 2 * (w * dv - dw * v + v x dv)
+        float a[3], vxa[3], vxd[3];
+        cross(q, p, a);
+        for (int c = 0; c < 3; c++) {
+            a[c] += q[3] * p[c];
+        }
+        cross(q, a, vxa);
+        cross(q, d, vxd);
+        for (int c = 0; c < 3; c++) {
+            const float ref = m[c*4+0]*p[0] + m[c*4+1]*p[1] + m[c*4+2]*p[2] + m[c*4+3];
+            const float res = p[c] + 2.0f * vxa[c] + 2.0f * (q[3] * d[c] - d[3] * q[c] + vxd[c]);
+            CHECK_CLOSE(ref, res, 0.001f);
+        }
+    }
+    mgr.discard();
+}
+
+//------------------------------------------------------------------------------
+TEST(AnimEvaluateHalfFloatTest) {
+    animMgr fullMgr;
+    animMgr halfMgr;
+    Id fullInsts[NumInstances];
+    Id halfInsts[NumInstances];
+    setupScene(fullMgr, fullInsts);
+    sceneSetup halfScene;
+    halfScene.anim.NumWorkerThreads = 3;
+    halfScene.anim.NumOutputBuffers = 2;
+    halfScene.anim.HalfFloatSkinMatrixTable = true;
+    halfScene.inst.HalfFloatSamples = true;
+    setupScene(halfMgr, halfInsts, halfScene);
+    CHECK(nullptr == fullMgr.skinMatrixInfo->Pages[0].HalfSkinMatrixTable);
+    CHECK(nullptr != halfMgr.skinMatrixInfo->Pages[0].HalfSkinMatrixTable);
+    advanceTime(fullMgr, 1.0);
+    advanceTime(halfMgr, 1.0);
+    for (int frame = 0; frame < 8; frame++) {
+        fullMgr.newFrame();
+        halfMgr.newFrame();
+        for (int i = 0; i < NumInstances; i++) {
+            CHECK(fullMgr.addActiveInstance(fullMgr.lookupInstance(fullInsts[i])));
+            CHECK(halfMgr.addActiveInstance(halfMgr.lookupInstance(halfInsts[i])));
+        }
+        fullMgr.evaluate(1.0 / 60.0);
+        halfMgr.evaluate(1.0 / 60.0);
+
+        // the half-float table is the converted float table
+        const AnimSkinMatrixInfo::Page& info = halfMgr.skinMatrixInfo->Pages[0];
+        const int numFloats = info.SkinMatrixTableByteSize / sizeof(float);
+        bool tableMatches = true;
+        for (int i = 0; i < numFloats; i++) {
+            tableMatches &= info.HalfSkinMatrixTable[i] == animFloatToHalf(info.SkinMatrixTable[i]);
+        }
+        CHECK(tableMatches);
+
+        // the root bone samples are exact, the others within half-float precision
+        for (int i = 0; i < NumInstances; i++) {
+            const animInstance* full = fullMgr.lookupInstance(fullInsts[i]);
+            const animInstance* half = halfMgr.lookupInstance(halfInsts[i]);
+            CHECK(half->samples.Empty());
+            const int numSamples = full->samples.Size();
+            float unpacked[NumBones * 10];
+            std::memcpy(unpacked, half->packedSamples.begin(), AnimConfig::NumFullPrecisionSamples * sizeof(float));
+            animHalfToFloat((const uint16_t*)&half->packedSamples[AnimConfig::NumFullPrecisionSamples],
+                &unpacked[AnimConfig::NumFullPrecisionSamples], numSamples - AnimConfig::NumFullPrecisionSamples);
+            for (int s = 0; s < numSamples; s++) {
+                if (s < AnimConfig::NumFullPrecisionSamples) {
+                    CHECK(unpacked[s] == full->samples[s]);
+                }
+                else {
+                    CHECK_CLOSE(full->samples[s], unpacked[s], 0.002f);
+                }
+            }
+            for (int m = 0; m < full->skinMatrices.Size(); m++) {
+                CHECK_CLOSE(full->skinMatrices[m], half->skinMatrices[m], 0.02f);
+            }
+        }
+    }
+    // the root bone takes 10 floats, the other 30 samples 15 floats
+    CHECK(fullMgr.sampleAllocator.numUsed == NumInstances * NumBones * 10);
+    CHECK(halfMgr.sampleAllocator.numUsed == NumInstances * (10 + (NumBones - 1) * 5));
+    fullMgr.discard();
+    halfMgr.discard();
+}
+
+//------------------------------------------------------------------------------
+#if ORYOL_ANIM_PROFILING
+TEST(AnimEvaluateProfilingTest) {
+    animProfiler::reset();
+    CHECK(animProfiler::numEvents() == 0);
+    animMgr mgr;
+    Id insts[NumInstances];
+    sceneSetup scene;
+    scene.anim.NumWorkerThreads = 2;
+    setupScene(mgr, insts, scene);
+    CHECK(animProfiler::numEvents() > 0);
+    for (int frame = 0; frame < 2; frame++) {
+        mgr.newFrame();
+        for (int i = 0; i < NumInstances; i++) {
+            CHECK(mgr.addActiveInstance(mgr.lookupInstance(insts[i])));
+        }
+        mgr.evaluate(1.0 / 60.0);
+    }
+    const char* path = "anim_profile_test.json";
+    CHECK(animProfiler::writeChromeTrace(path));
+    FILE* fp = fopen(path, "rb");
+    CHECK(fp);
+    if (fp) {
+        static char buf[1 << 20];
+        const size_t num = fread(buf, 1, sizeof(buf) - 1, fp);
+        buf[num] = 0;
+        fclose(fp);
+        CHECK(0 == strncmp(buf, "{\"traceEvents\":[", 16));
+        CHECK(strstr(buf, "\"name\":\"Anim::createLibrary\""));
+        CHECK(strstr(buf, "\"name\":\"Anim::evaluate\""));
+        CHECK(strstr(buf, "\"name\":\"Anim::sequencerEval\""));
+        CHECK(strstr(buf, "\"name\":\"Anim::genSkinMatrices\""));
+        CHECK(strstr(buf, "\"ph\":\"X\""));
+    }
+    remove(path);
+    mgr.discard();
+    animProfiler::reset();
+    CHECK(animProfiler::numEvents() == 0);
+}
+#endif
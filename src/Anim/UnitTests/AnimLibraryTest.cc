@@ -5,6 +5,7 @@
 #include "UnitTest++/src/UnitTest++.h"
 #include "Anim/AnimTypes.h"
 #include "Anim/private/animMgr.h"
+#include <cstring>
 
 using namespace Oryol;
 using namespace _priv;
@@ -29,8 +30,8 @@ TEST(AnimLibraryTest) {
     CHECK(mgr.curvePool.Capacity() == 128);
     CHECK(mgr.keys.Size() == 1024);
     CHECK(mgr.keys.Offset() == 0);
-    CHECK(mgr.numKeys == 0);
-    CHECK(mgr.valuePool != nullptr);
+    CHECK(mgr.keyAllocator.numUsed == 0);
+    CHECK(mgr.keyPool != nullptr);
 
     AnimLibrarySetup libSetup;
     libSetup.Locator = "human";
@@ -62,9 +63,9 @@ TEST(AnimLibraryTest) {
     CHECK(lib1.IsValid());
     CHECK(mgr.lookupLibrary(lib1) != nullptr);
     CHECK(mgr.libPool.QueryPoolInfo().NumUsedSlots == 1);
-    CHECK(mgr.clipPool.Size() == 2);
-    CHECK(mgr.curvePool.Size() == 6);
-    CHECK(mgr.numKeys == 110);
+    CHECK(mgr.clipAllocator.numUsed == 2);
+    CHECK(mgr.curveAllocator.numUsed == 6);
+    CHECK(mgr.keyAllocator.numUsed == 110);
     const AnimLibrary* lib1Ptr = mgr.lookupLibrary(lib1);
     CHECK(lib1Ptr->Locator.Location() == "human");
     CHECK(lib1Ptr->SampleStride == 9);
@@ -137,9 +138,9 @@ TEST(AnimLibraryTest) {
     CHECK(lib2.IsValid());
     CHECK(mgr.lookupLibrary(lib2) != nullptr);
     CHECK(mgr.libPool.QueryPoolInfo().NumUsedSlots == 2);
-    CHECK(mgr.clipPool.Size() == 4);
-    CHECK(mgr.curvePool.Size() == 12);
-    CHECK(mgr.numKeys == 220);
+    CHECK(mgr.clipAllocator.numUsed == 4);
+    CHECK(mgr.curveAllocator.numUsed == 12);
+    CHECK(mgr.keyAllocator.numUsed == 220);
     const AnimLibrary* lib2Ptr = mgr.lookupLibrary(lib2);
     CHECK(lib2Ptr->Locator.Location() == "Bla");
     CHECK(lib2Ptr->SampleStride == 9);
@@ -208,13 +209,376 @@ TEST(AnimLibraryTest) {
     CHECK_CLOSE(lib2Ptr->Clips[1].Curves[2].StaticValue[3], 9.0f, 0.001f);
     mgr.destroy(l1);
     CHECK(mgr.libPool.QueryPoolInfo().NumUsedSlots == 1);
-    CHECK(mgr.clipPool.Size() == 2);
-    CHECK(mgr.curvePool.Size() == 6);
-    CHECK(mgr.numKeys == 110);
+    CHECK(mgr.clipAllocator.numUsed == 2);
+    CHECK(mgr.curveAllocator.numUsed == 6);
+    CHECK(mgr.keyAllocator.numUsed == 110);
+
+    // a library which reuses a freed slot starts with a clean curve layout
+    libSetup.Locator = "human2";
+    Id lib3 = mgr.createLibrary(libSetup);
+    CHECK(lib3.SlotIndex == lib1.SlotIndex);
+    CHECK(mgr.lookupLibrary(lib3)->CurveLayout.Size() == 3);
 
     mgr.discard();
     CHECK(!mgr.isValid);
-    CHECK(mgr.clipPool.Size() == 0);
-    CHECK(mgr.curvePool.Size() == 0);
-    CHECK(mgr.numKeys == 0);
+    CHECK(mgr.clipAllocator.numUsed == 0);
+    CHECK(mgr.curveAllocator.numUsed == 0);
+    CHECK(mgr.keyAllocator.numUsed == 0);
+}
+
+TEST(AnimLibraryFragmentationTest) {
+    // the key pool fits 3 libraries, after destroying the first and the
+    // last one there's room for a library of twice the size, but not in
+    // one free range (the pools aren't defragmented)
+    AnimSetup setup;
+    setup.KeyPoolCapacity = 330;
+    animMgr mgr;
+    mgr.setup(setup);
+
+    AnimLibrarySetup libSetup;
+    libSetup.CurveLayout = { AnimCurveFormat::Float2, AnimCurveFormat::Float3 };
+    libSetup.Clips = {
+        { "clip1", 10, 0.04f, { { false, 0.0f, 0.0f, 0.0f, 0.0f }, { false, 0.0f, 0.0f, 0.0f, 0.0f } } },
+        { "clip2", 20, 0.04f, { { true, 0.0f, 0.0f, 0.0f, 0.0f }, { false, 0.0f, 0.0f, 0.0f, 0.0f } } }
+    };
+    const char* names[3] = { "lib0", "lib1", "lib2" };
+    Id libs[3];
+    for (int i = 0; i < 3; i++) {
+        libSetup.Locator = names[i];
+        libs[i] = mgr.createLibrary(libSetup);
+        CHECK(libs[i].IsValid());
+    }
+    CHECK(mgr.keyAllocator.numUsed == 330);
+    mgr.destroyLibrary(libs[0]);
+    mgr.destroyLibrary(libs[2]);
+    CHECK(mgr.keyAllocator.numUsed == 110);
+    CHECK(mgr.keyAllocator.largestFree() == 110);
+
+    libSetup.Locator = "big";
+    for (int i = 0; i < 2; i++) {
+        AnimClipSetup clipSetup = libSetup.Clips[i];
+        clipSetup.Name = i == 0 ? "clip3" : "clip4";
+        libSetup.Clips.Add(clipSetup);
+    }
+    CHECK(!mgr.createLibrary(libSetup).IsValid());
+    #if ORYOL_ANIM_FRAME_STATS
+    CHECK(mgr.frameStats.NumFragmentedPoolFailures == 1);
+    #endif
+
+    // a library which doesn't fit into the free space at all isn't
+    // counted, and the count is kept over frames
+    libSetup.Locator = "bigger";
+    libSetup.Clips.Add(libSetup.Clips[0]);
+    libSetup.Clips.Back().Name = "clip5";
+    CHECK(!mgr.createLibrary(libSetup).IsValid());
+    mgr.newFrame();
+    mgr.evaluate(1.0 / 60.0);
+    #if ORYOL_ANIM_FRAME_STATS
+    CHECK(mgr.frameStats.NumFragmentedPoolFailures == 1);
+    #endif
+    mgr.discard();
+}
+
+TEST(AnimKeyReductionTest) {
+    AnimSetup setup;
+    setup.KeyPoolCapacity = 1024;
+    animMgr mgr;
+    mgr.setup(setup);
+
+    // curve 0 is a linear ramp and reduces to 2 keys, curve 1 has a kink
+    AnimLibrarySetup libSetup;
+    libSetup.Locator = "reduced";
+    libSetup.KeyReductionTolerance = 0.001f;
+    libSetup.CurveLayout = { AnimCurveFormat::Float, AnimCurveFormat::Float2 };
+    libSetup.Clips = {
+        { "clip", 32, 0.04f, { { false, 0.0f, 0.0f, 0.0f, 0.0f }, { false, 0.0f, 0.0f, 0.0f, 0.0f } } }
+    };
+    libSetup.Clips[0].Curves[0].Magnitude = glm::vec4(1.0f);
+    libSetup.Clips[0].Curves[1].Magnitude = glm::vec4(1.0f);
+    Id libId = mgr.createLibrary(libSetup);
+    AnimLibrary* lib = mgr.lookupLibrary(libId);
+    CHECK(mgr.keyAllocator.numUsed == 96);
+    int16_t keys[96];
+    for (int i = 0; i < 32; i++) {
+        keys[i * 3 + 0] = int16_t(i * 1000);
+        keys[i * 3 + 1] = int16_t((i < 16) ? (i * 100) : (1600 - (i - 16) * 200));
+        keys[i * 3 + 2] = 500;
+    }
+    mgr.writeKeys(lib, (const uint8_t*)keys, sizeof(keys));
+    const AnimClip& clip = lib->Clips[0];
+    CHECK(clip.VariableRate);
+    CHECK(clip.Curves[0].NumKeys == 2);
+    CHECK(clip.Curves[0].KeyIndex == 0);
+    CHECK(clip.Curves[1].NumKeys == 3);
+    CHECK(clip.Curves[1].KeyIndex == 2 * 2);
+    CHECK(clip.Keys[4] == 0);
+    CHECK(clip.Keys[5] == 16);
+    CHECK(clip.Keys[6] == 31);
+    CHECK(clip.Keys.Size() == (2 * 2 + 3 * 3));
+    CHECK(lib->Keys.Size() == clip.Keys.Size());
+    CHECK(mgr.keyAllocator.numUsed == clip.Keys.Size());
+
+    // sampling the reduced clip must reproduce the original keys
+    const animSamplePlan& plan = mgr.samplePlans[libId.SlotIndex];
+    animSequencer sequencer;
+    uint16_t cursors[animSequencer::maxItems * 2] = { };
+    sequencer.keyCursors = cursors;
+    sequencer.numCursorCurves = 2;
+    AnimJob job;
+    sequencer.add(0.0, 1, job, 32 * 0.04);
+    float samples[3];
+    for (int i = 0; i < 31; i++) {
+        CHECK(sequencer.eval(lib, &plan, i * 0.04 + 0.02, samples, 3));
+        CHECK_CLOSE(samples[0], (i * 1000 + 500) / 32767.0f, 0.0001f);
+        const float v0 = float(keys[i * 3 + 1]) / 32767.0f;
+        const float v1 = float(keys[(i + 1) * 3 + 1]) / 32767.0f;
+        CHECK_CLOSE(samples[1], v0 + (v1 - v0) * 0.5f, 0.0001f);
+        CHECK_CLOSE(samples[2], 500.0f / 32767.0f, 0.0001f);
+    }
+    CHECK(cursors[0] == 0);
+    CHECK(cursors[1] == 1);
+    mgr.discard();
+}
+
+TEST(AnimStaticCurveTest) {
+    AnimSetup setup;
+    setup.KeyPoolCapacity = 1024;
+    animMgr mgr;
+    mgr.setup(setup);
+
+    // curve 0 is animated, curve 1 is constant, curve 2 jitters within tolerance,
+    // the second clip is completely constant
+    AnimLibrarySetup libSetup;
+    libSetup.Locator = "static";
+    libSetup.StaticCurveTolerance = 2.0f / 32767.0f;
+    libSetup.CurveLayout = { AnimCurveFormat::Float, AnimCurveFormat::Float2, AnimCurveFormat::Float };
+    for (int i = 0; i < 2; i++) {
+        AnimClipSetup& clipSetup = libSetup.Clips.Add();
+        clipSetup.Name = i == 0 ? "clip0" : "clip1";
+        clipSetup.Length = 8;
+        clipSetup.KeyDuration = 0.04f;
+        for (int c = 0; c < 3; c++) {
+            clipSetup.Curves.Add().Magnitude = glm::vec4(1.0f);
+        }
+    }
+    Id libId = mgr.createLibrary(libSetup);
+    AnimLibrary* lib = mgr.lookupLibrary(libId);
+    CHECK(mgr.keyAllocator.numUsed == 64);
+    int16_t keys[64];
+    for (int i = 0; i < 8; i++) {
+        keys[i * 4 + 0] = int16_t(i * 1000);
+        keys[i * 4 + 1] = 100;
+        keys[i * 4 + 2] = -200;
+        keys[i * 4 + 3] = int16_t(300 + (i & 1) * 3);
+        keys[32 + i * 4 + 0] = 1;
+        keys[32 + i * 4 + 1] = 2;
+        keys[32 + i * 4 + 2] = 3;
+        keys[32 + i * 4 + 3] = 4;
+    }
+    mgr.writeKeys(lib, (const uint8_t*)keys, sizeof(keys));
+    CHECK(lib->KeysOptimized);
+    const AnimClip& clip0 = lib->Clips[0];
+    CHECK(!clip0.Curves[0].Static);
+    CHECK(clip0.Curves[1].Static);
+    CHECK(clip0.Curves[2].Static);
+    CHECK(clip0.KeyStride == 1);
+    CHECK(clip0.Keys.Size() == 8);
+    CHECK(clip0.Keys[7] == 7000);
+    CHECK_CLOSE(clip0.Curves[1].StaticValue[0], 100.0f / 32767.0f, 0.000001f);
+    CHECK_CLOSE(clip0.Curves[1].StaticValue[1], -200.0f / 32767.0f, 0.000001f);
+    CHECK_CLOSE(clip0.Curves[2].StaticValue[0], 301.5f / 32767.0f, 0.000001f);
+    const AnimClip& clip1 = lib->Clips[1];
+    CHECK(clip1.KeyStride == 0);
+    CHECK(clip1.Keys.Empty());
+    CHECK(lib->Keys.Size() == 8);
+    CHECK(mgr.keyAllocator.numUsed == 8);
+
+    // the sampling plan now has a single keyed lane
+    const animSamplePlan& plan = mgr.samplePlans[libId.SlotIndex];
+    CHECK(plan.clips[0].numSpans == 2);
+    CHECK(plan.spans[0].num == 1);
+    CHECK(plan.clips[1].numSpans == 1);
+    CHECK(plan.spans[plan.clips[1].firstSpan].kind == animSamplePlan::Static);
+
+    // writing keys again would mismatch the optimized layout
+    mgr.writeKeys(lib, (const uint8_t*)keys, sizeof(keys));
+    CHECK(clip0.Keys[7] == 7000);
+    mgr.discard();
+}
+
+TEST(AnimLibraryDataTest) {
+    AnimSetup setup;
+    setup.KeyPoolCapacity = 1024;
+    animMgr mgr;
+    mgr.setup(setup);
+
+    // a library with a static curve and packed formats, round-tripped
+    // through the binary format
+    AnimLibrarySetup libSetup;
+    libSetup.Locator = "lib";
+    libSetup.CurveLayout = { AnimCurveFormat::Float3, AnimCurveFormat::Quaternion48, AnimCurveFormat::Float2U8 };
+    libSetup.Clips = {
+        { "clip0", 4, 0.04f, { { false, 0.0f, 0.0f, 0.0f, 0.0f }, { false, 0.0f, 0.0f, 0.0f, 0.0f }, { false, 0.0f, 0.0f, 0.0f, 0.0f } } },
+        { "clip1", 2, 0.1f, { { true, 1.0f, 2.0f, 3.0f, 0.0f }, { false, 0.0f, 0.0f, 0.0f, 0.0f }, { false, 0.0f, 0.0f, 0.0f, 0.0f } } },
+    };
+    for (auto& clip : libSetup.Clips) {
+        clip.Curves[0].Magnitude = glm::vec4(4.0f);
+        clip.Curves[2].Magnitude = glm::vec4(2.0f);
+        clip.Curves[2].Offset = glm::vec4(-1.0f);
+    }
+    Id libId = mgr.createLibrary(libSetup);
+    AnimLibrary* lib = mgr.lookupLibrary(libId);
+    CHECK(lib->Keys.Size() == (4 * 7 + 2 * 4));
+    int16_t keys[4 * 7 + 2 * 4];
+    for (int i = 0; i < lib->Keys.Size(); i++) {
+        keys[i] = int16_t(i * 2345);
+    }
+    mgr.writeKeys(lib, (const uint8_t*)keys, sizeof(keys));
+    Buffer data;
+    CHECK(mgr.saveLibrary(lib, data));
+    const auto* hdr = (const AnimLibraryFormat::Header*) data.Data();
+    CHECK(hdr->Magic == AnimLibraryFormat::Magic);
+    CHECK(hdr->FileSize == uint32_t(data.Size()));
+    CHECK((hdr->KeysOffset % AnimLibraryFormat::Alignment) == 0);
+
+    AnimLibraryDataSetup dataSetup;
+    dataSetup.Locator = "lib.bin";
+    dataSetup.Data = data.Data();
+    dataSetup.Size = data.Size();
+    Id extId = mgr.createLibrary(dataSetup);
+    CHECK(extId.IsValid());
+    AnimLibrary* ext = mgr.lookupLibrary(extId);
+    CHECK(ext->ExternalKeys);
+    CHECK(ext->SampleStride == lib->SampleStride);
+    CHECK(ext->Keys.begin() == (const int16_t*)(data.Data() + hdr->KeysOffset));
+    CHECK(ext->Clips[1].Name == "clip1");
+    CHECK(ext->Clips[1].Curves[0].Static);
+    CHECK(ext->Clips[1].Keys.Offset() == 4 * 7);
+    CHECK(mgr.keyAllocator.numUsed == lib->Keys.Size());
+
+    // both libraries must sample identically
+    animSequencer seq;
+    AnimJob job;
+    job.ClipIndex = 1;
+    seq.add(0.0, 1, job, 0.2);
+    float s0[9], s1[9];
+    for (int i = 0; i < 8; i++) {
+        CHECK(seq.eval(lib, &mgr.samplePlans[libId.SlotIndex], i * 0.03, s0, 9));
+        CHECK(seq.eval(ext, &mgr.samplePlans[extId.SlotIndex], i * 0.03, s1, 9));
+        for (int j = 0; j < 9; j++) {
+            CHECK(s0[j] == s1[j]);
+        }
+    }
+
+    // a library appended to a non-empty buffer starts at the next aligned
+    // offset, with offsets relative to its start
+    Buffer appended;
+    appended.Add(3);
+    CHECK(mgr.saveLibrary(lib, appended));
+    CHECK(appended.Size() == AnimLibraryFormat::Alignment + data.Size());
+    CHECK(0 == std::memcmp(appended.Data() + AnimLibraryFormat::Alignment, data.Data(), data.Size()));
+
+    // external keys are read-only and not part of the key pool
+    mgr.writeKeys(ext, (const uint8_t*)keys, sizeof(keys));
+    CHECK(ext->Keys[1] == 2345);
+    mgr.destroyLibrary(libId);
+    CHECK(mgr.keyAllocator.numUsed == 0);
+    CHECK(ext->Clips[1].Keys.Offset() == 4 * 7);
+    mgr.destroyLibrary(extId);
+
+    // corrupt data is rejected
+    ((AnimLibraryFormat::Header*)data.Data())->Version = 0;
+    dataSetup.Locator = "corrupt.bin";
+    CHECK(!mgr.createLibrary(dataSetup).IsValid());
+    mgr.discard();
+}
+
+TEST(AnimLibraryStreamTest) {
+    AnimSetup setup;
+    setup.KeyPoolCapacity = 1024;
+    setup.StreamCacheCapacity = 40;
+    animMgr mgr;
+    mgr.setup(setup);
+
+    // write a library with 2 clips of 30 keys each to a file,
+    // the stream cache can only hold one of them
+    AnimLibrarySetup libSetup;
+    libSetup.Locator = "lib";
+    libSetup.CurveLayout = { AnimCurveFormat::Float3, AnimCurveFormat::Float };
+    libSetup.Clips = {
+        { "clip0", 10, 0.1f, { { false, 1.0f, 2.0f, 3.0f, 0.0f }, { true, 4.0f, 0.0f, 0.0f, 0.0f } } },
+        { "clip1", 10, 0.1f, { { false, 1.0f, 2.0f, 3.0f, 0.0f }, { true, 4.0f, 0.0f, 0.0f, 0.0f } } },
+    };
+    libSetup.Clips[0].Curves[0].Magnitude = glm::vec4(1.0f);
+    libSetup.Clips[1].Curves[0].Magnitude = glm::vec4(1.0f);
+    Id libId = mgr.createLibrary(libSetup);
+    AnimLibrary* lib = mgr.lookupLibrary(libId);
+    int16_t keys[60];
+    for (int i = 0; i < 60; i++) {
+        keys[i] = int16_t(i * 500 + 100);
+    }
+    mgr.writeKeys(lib, (const uint8_t*)keys, sizeof(keys));
+    Buffer data;
+    CHECK(mgr.saveLibrary(lib, data));
+    const char* path = "anim_stream_test.bin";
+    FILE* fp = fopen(path, "wb");
+    CHECK(fp);
+    CHECK(1 == fwrite(data.Data(), data.Size(), 1, fp));
+    fclose(fp);
+
+    AnimLibraryStreamSetup streamSetup;
+    streamSetup.Locator = "stream";
+    streamSetup.Path = path;
+    Id streamId = mgr.createLibrary(streamSetup);
+    CHECK(streamId.IsValid());
+    AnimLibrary* stream = mgr.lookupLibrary(streamId);
+    CHECK(stream->Streaming);
+    CHECK(!stream->Clips[0].Resident);
+    CHECK(!stream->Clips[1].Resident);
+    CHECK(mgr.keyCache.numCachedKeys == 0);
+
+    // a non-resident clip samples the fallback pose
+    Id instId = mgr.createInstance(AnimInstanceSetup::FromLibrary(streamId));
+    animInstance* inst = mgr.lookupInstance(instId);
+    AnimJob job;
+    mgr.play(inst, job);
+    float samples[4];
+    CHECK(inst->sequencer.eval(stream, &mgr.samplePlans[streamId.SlotIndex], 0.05, samples, 4));
+    CHECK(samples[0] == 1.0f);
+    CHECK(samples[2] == 3.0f);
+    CHECK(samples[3] == 4.0f);
+
+    // after the next frame the keys are loaded and sample like the original
+    mgr.newFrame();
+    CHECK(stream->Clips[0].Resident);
+    CHECK(!stream->Clips[1].Resident);
+    CHECK(mgr.keyCache.numCachedKeys == 30);
+    CHECK(mgr.addActiveInstance(inst));
+    const double evalTime = mgr.curTime;
+    mgr.evaluate(0.05);
+    float ref[4];
+    animSequencer seq;
+    seq.add(0.0, 1, job, 1.0);
+    CHECK(seq.eval(lib, &mgr.samplePlans[libId.SlotIndex], evalTime, ref, 4));
+    for (int i = 0; i < 4; i++) {
+        CHECK(inst->samples[i] == ref[i]);
+    }
+
+    // playing the other clip evicts the first clip once it's no longer referenced
+    mgr.stopAll(inst, false);
+    job.ClipIndex = 1;
+    mgr.play(inst, job);
+    mgr.newFrame();
+    CHECK(!stream->Clips[0].Resident);
+    CHECK(stream->Clips[1].Resident);
+    CHECK(mgr.keyCache.numEvictions == 1);
+    CHECK(mgr.keyCache.numCachedKeys == 30);
+    mgr.evaluate(0.05);
+
+    mgr.destroyInstance(instId);
+    mgr.destroyLibrary(streamId);
+    CHECK(mgr.keyCache.numCachedKeys == 0);
+    CHECK(!mgr.keyCache.isStreaming(streamId.SlotIndex));
+    mgr.discard();
+    remove(path);
 }
@@ -33,7 +33,7 @@ TEST(AnimSkeletonTest) {
     ResourceLabel l1 = mgr.resContainer.PushLabel();
     Id skelId = mgr.createSkeleton(skelSetup);
     mgr.resContainer.PopLabel();
-    CHECK(mgr.matrixPool.Size() == 6);
+    CHECK(mgr.matrixAllocator.numUsed == 6);
     AnimSkeleton* skel = mgr.lookupSkeleton(skelId);
     CHECK(skel);
     CHECK(skel->Locator.Location() == "test");
@@ -42,5 +42,5 @@ TEST(AnimSkeletonTest) {
 
     mgr.discard();
     CHECK(!mgr.isValid);
-    CHECK(mgr.matrixPool.Size() == 0);
+    CHECK(mgr.matrixAllocator.numUsed == 0);
 }
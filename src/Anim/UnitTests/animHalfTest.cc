@@ -0,0 +1,60 @@
+//------------------------------------------------------------------------------
+//  animHalfTest.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "UnitTest++/src/UnitTest++.h"
+#include "Anim/private/animHalf.h"
+
+using namespace Oryol;
+using namespace _priv;
+
+TEST(animHalfTest) {
+    // exactly representable values
+    CHECK(animFloatToHalf(0.0f) == 0x0000);
+    CHECK(animFloatToHalf(-0.0f) == 0x8000);
+    CHECK(animFloatToHalf(1.0f) == 0x3C00);
+    CHECK(animFloatToHalf(-2.0f) == 0xC000);
+    CHECK(animFloatToHalf(0.5f) == 0x3800);
+    CHECK(animFloatToHalf(65504.0f) == 0x7BFF);
+    // smallest denormal and smallest normal
+    CHECK(animFloatToHalf(1.0f / 16777216.0f) == 0x0001);
+    CHECK(animFloatToHalf(1.0f / 16384.0f) == 0x0400);
+    // overflow, underflow and round to nearest even
+    CHECK(animFloatToHalf(65520.0f) == 0x7C00);
+    CHECK(animFloatToHalf(-1.0e6f) == 0xFC00);
+    CHECK(animFloatToHalf(1.0e-9f) == 0x0000);
+    CHECK(animFloatToHalf(1.0f + 1.0f / 2048.0f) == 0x3C00);
+    CHECK(animFloatToHalf(1.0f + 3.0f / 2048.0f) == 0x3C02);
+    CHECK(animFloatToHalf(2048.0f + 1.0f) == 0x6800);
+    CHECK(animFloatToHalf(2048.0f + 3.0f) == 0x6802);
+
+    // all non-NaN half-floats survive a round trip
+    for (uint32_t h = 0; h < 0x10000; h++) {
+        if ((h & 0x7C00) == 0x7C00 && (h & 0x03FF)) {
+            float f = animHalfToFloat(uint16_t(h));
+            CHECK(f != f);
+            CHECK((animFloatToHalf(f) & 0x7C00) == 0x7C00);
+            continue;
+        }
+        CHECK(animFloatToHalf(animHalfToFloat(uint16_t(h))) == h);
+    }
+    CHECK(animHalfToFloat(0x3C00) == 1.0f);
+    CHECK(animHalfToFloat(0x0001) == 1.0f / 16777216.0f);
+    CHECK(animHalfToFloat(0xFC00) == -animHalfToFloat(0x7C00));
+
+    // the array conversion (F16C if available) matches the scalar conversion
+    static const int num = 1027;
+    float src[num], back[num];
+    uint16_t dst[num];
+    uint32_t seed = 12345;
+    for (int i = 0; i < num; i++) {
+        seed = seed * 1664525 + 1013904223;
+        src[i] = (float(int32_t(seed)) / 2147483648.0f) * ((i & 7) ? 4.0f : 70000.0f);
+    }
+    animFloatToHalf(src, dst, num);
+    animHalfToFloat(dst, back, num);
+    for (int i = 0; i < num; i++) {
+        CHECK(dst[i] == animFloatToHalf(src[i]));
+        CHECK(back[i] == animHalfToFloat(dst[i]));
+    }
+}
@@ -0,0 +1,77 @@
+//------------------------------------------------------------------------------
+//  animRangeAllocatorTest.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "UnitTest++/src/UnitTest++.h"
+#include "Anim/private/animRangeAllocator.h"
+
+using namespace Oryol;
+using namespace _priv;
+
+TEST(animRangeAllocatorTest) {
+    animRangeAllocator alloc;
+    alloc.setup(100);
+    CHECK(alloc.capacity == 100);
+    CHECK(alloc.numUsed == 0);
+    CHECK(alloc.largestFree() == 100);
+
+    // empty ranges don't consume anything
+    CHECK(alloc.alloc(0) == 0);
+    CHECK(alloc.numUsed == 0);
+
+    const int a = alloc.alloc(10);
+    const int b = alloc.alloc(20);
+    const int c = alloc.alloc(30);
+    CHECK(a == 0);
+    CHECK(b == 10);
+    CHECK(c == 30);
+    CHECK(alloc.numUsed == 60);
+    CHECK(alloc.largestFree() == 40);
+    CHECK(alloc.alloc(41) == InvalidIndex);
+
+    // freeing in the middle leaves a hole, the other ranges don't move
+    alloc.free(b, 20);
+    CHECK(alloc.numUsed == 40);
+    CHECK(alloc.freeRanges.Size() == 2);
+    CHECK(alloc.largestFree() == 40);
+
+    // best fit picks the hole, not the bigger tail
+    CHECK(alloc.smallestFit(15) == 20);
+    CHECK(alloc.smallestFit(21) == 40);
+    CHECK(alloc.smallestFit(41) == 0);
+    const int d = alloc.alloc(15);
+    CHECK(d == 10);
+    CHECK(alloc.freeRanges.Size() == 2);
+    CHECK(alloc.freeRanges[0].offset == 25);
+    CHECK(alloc.freeRanges[0].num == 5);
+
+    // partial free of the tail of a range
+    alloc.free(c + 20, 10);
+    CHECK(alloc.numUsed == 45);
+    CHECK(alloc.freeRanges.Size() == 2);
+    CHECK(alloc.freeRanges[1].offset == 50);
+    CHECK(alloc.freeRanges[1].num == 50);
+
+    // coalesce with previous and next neighbours
+    alloc.free(d, 15);
+    CHECK(alloc.freeRanges.Size() == 2);
+    CHECK(alloc.freeRanges[0].offset == 10);
+    CHECK(alloc.freeRanges[0].num == 20);
+    alloc.free(c, 20);
+    CHECK(alloc.freeRanges.Size() == 1);
+    CHECK(alloc.freeRanges[0].offset == 10);
+    CHECK(alloc.freeRanges[0].num == 90);
+    alloc.free(a, 10);
+    CHECK(alloc.freeRanges.Size() == 1);
+    CHECK(alloc.numUsed == 0);
+    CHECK(alloc.largestFree() == 100);
+
+    // exact fit consumes the whole free range
+    CHECK(alloc.alloc(100) == 0);
+    CHECK(alloc.freeRanges.Empty());
+    CHECK(alloc.alloc(1) == InvalidIndex);
+    alloc.free(0, 100);
+    CHECK(alloc.numUsed == 0);
+    alloc.discard();
+    CHECK(alloc.capacity == 0);
+}
@@ -0,0 +1,200 @@
+//------------------------------------------------------------------------------
+//  animSamplerTest.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "UnitTest++/src/UnitTest++.h"
+#include "Anim/AnimTypes.h"
+#include "Anim/private/animMgr.h"
+#include <math.h>
+
+using namespace Oryol;
+using namespace _priv;
+
+TEST(animSamplerTest) {
+
+    // sampling plan: adjacent keyed and static curves are merged into spans
+    AnimSetup setup;
+    animMgr mgr;
+    mgr.setup(setup);
+    AnimLibrarySetup libSetup;
+    libSetup.Locator = "lib";
+    libSetup.CurveLayout = {
+        AnimCurveFormat::Float3,
+        AnimCurveFormat::Quaternion,
+        AnimCurveFormat::Float3,
+        AnimCurveFormat::Float2,
+    };
+    libSetup.Clips = {
+        { "clip", 4, 0.04f,
+            {
+                { false, 1.0f, 2.0f, 3.0f, 4.0f },
+                { false, 5.0f, 6.0f, 7.0f, 8.0f },
+                { true,  9.0f, 10.0f, 11.0f, 12.0f },
+                { true,  13.0f, 14.0f, 15.0f, 16.0f },
+            }
+        },
+    };
+    Id libId = mgr.createLibrary(libSetup);
+    const animSamplePlan& plan = mgr.samplePlans[libId.SlotIndex];
+    CHECK(plan.clips.Size() == 1);
+    CHECK(plan.clips[0].numSpans == 2);
+    CHECK(plan.spans[0].kind == animSamplePlan::Keys);
+    CHECK(plan.spans[0].dstIndex == 0);
+    CHECK(plan.spans[0].keyIndex == 0);
+    CHECK(plan.spans[0].num == 7);
+    CHECK(plan.spans[1].kind == animSamplePlan::Static);
+    CHECK(plan.spans[1].dstIndex == 7);
+    CHECK(plan.spans[1].num == 5);
+    CHECK(plan.values.Size() == 12);
+    CHECK_CLOSE(plan.values[7], 9.0f, 0.0001f);
+    CHECK_CLOSE(plan.values[11], 14.0f, 0.0001f);
+    // the Float2 curve doesn't match the TRS layout, the lane key indices
+    // are built for any layout
+    CHECK(plan.layout == animSamplePlan::Generic);
+    CHECK(plan.clips[0].laneSampled);
+    CHECK(plan.laneKeys.Size() == 12);
+    for (int i = 0; i < 12; i++) {
+        CHECK(plan.laneKeys[i] == (i < 7 ? uint16_t(i) : animSamplePlan::StaticLane));
+    }
+
+    // the TRS layout is matched when the library is created
+    libSetup.Locator = "trs";
+    libSetup.CurveLayout.Erase(3);
+    libSetup.Clips[0].Curves.Erase(3);
+    Id trsLibId = mgr.createLibrary(libSetup);
+    CHECK(mgr.samplePlans[trsLibId.SlotIndex].layout == animSamplePlan::TRS);
+    mgr.discard();
+
+    // the vectorized kernels must match the scalar reference, including tails
+    const int num = 19;
+    int16_t src0[num], src1[num];
+    float mag[num], values[num], dst[num], ref[num];
+    for (int i = 0; i < num; i++) {
+        src0[i] = int16_t(i * 1000 - 9000);
+        src1[i] = int16_t(9000 - i * 777);
+        mag[i] = float(i + 1) / 32767.0f;
+        values[i] = float(i) * 0.5f;
+    }
+    const float keyPos = 0.3f;
+    const float weight = 0.7f;
+    animSampler::sample(src0, src1, mag, keyPos, dst, num);
+    for (int i = 0; i < num; i++) {
+        const float v0 = float(src0[i]) * mag[i];
+        const float v1 = float(src1[i]) * mag[i];
+        ref[i] = v0 + (v1 - v0) * keyPos;
+        CHECK(dst[i] == ref[i]);
+    }
+    animSampler::sampleMix(src1, src0, mag, keyPos, weight, dst, num);
+    for (int i = 0; i < num; i++) {
+        const float v0 = float(src1[i]) * mag[i];
+        const float v1 = float(src0[i]) * mag[i];
+        const float s1 = v0 + (v1 - v0) * keyPos;
+        ref[i] = ref[i] + (s1 - ref[i]) * weight;
+        CHECK(dst[i] == ref[i]);
+    }
+    animSampler::copyMix(values, weight, dst, num);
+    for (int i = 0; i < num; i++) {
+        ref[i] = ref[i] + (values[i] - ref[i]) * weight;
+        CHECK(dst[i] == ref[i]);
+    }
+    animSampler::copy(values, dst, num);
+    for (int i = 0; i < num; i++) {
+        CHECK(dst[i] == values[i]);
+    }
+
+    // sampling through lane key indices matches sample() and copy()
+    const uint16_t S = animSamplePlan::StaticLane;
+    const uint16_t laneKeys[10] = { 4, 5, 6, S, S, 0, 1, 2, 3, S };
+    float laneValues[10], laneDst[10];
+    for (int i = 0; i < 10; i++) {
+        laneValues[i] = (S == laneKeys[i]) ? values[i] : mag[laneKeys[i]];
+    }
+    animSampler::sampleLanes<10>(src0, src1, laneKeys, laneValues, keyPos, laneDst);
+    for (int i = 0; i < 10; i++) {
+        if (S == laneKeys[i]) {
+            CHECK(laneDst[i] == values[i]);
+        }
+        else {
+            animSampler::sample(src0 + laneKeys[i], src1 + laneKeys[i], mag + laneKeys[i], keyPos, dst, 1);
+            CHECK(laneDst[i] == dst[0]);
+        }
+    }
+}
+
+TEST(animSamplerPackedTest) {
+
+    // size accounting and sampling plan of packed key formats
+    AnimSetup setup;
+    animMgr mgr;
+    mgr.setup(setup);
+    AnimLibrarySetup libSetup;
+    libSetup.Locator = "lib";
+    libSetup.CurveLayout = {
+        AnimCurveFormat::Float3U8,
+        AnimCurveFormat::Quaternion48,
+        AnimCurveFormat::Float3,
+    };
+    AnimClipSetup& clipSetup = libSetup.Clips.Add();
+    clipSetup.Name = "clip";
+    clipSetup.Length = 2;
+    AnimCurveSetup& pos = clipSetup.Curves.Add();
+    pos.Offset = glm::vec4(-1.0f);
+    pos.Magnitude = glm::vec4(2.0f);
+    clipSetup.Curves.Add();
+    clipSetup.Curves.Add().Magnitude = glm::vec4(1.0f);
+    Id libId = mgr.createLibrary(libSetup);
+    const AnimLibrary* lib = mgr.lookupLibrary(libId);
+    const AnimClip& clip = lib->Clips[0];
+    CHECK(lib->SampleStride == 10);
+    CHECK(clip.KeyStride == 8);
+    CHECK(lib->Keys.Size() == 16);
+    CHECK(clip.Curves[0].KeyStride == 2);
+    CHECK(clip.Curves[1].KeyIndex == 2);
+    CHECK(clip.Curves[1].KeyStride == 3);
+    CHECK(clip.Curves[2].KeyIndex == 5);
+    const animSamplePlan& plan = mgr.samplePlans[libId.SlotIndex];
+    CHECK(plan.clips[0].numSpans == 3);
+    CHECK(plan.spans[0].kind == animSamplePlan::PackedKeys);
+    CHECK(plan.spans[1].kind == animSamplePlan::PackedKeys);
+    CHECK(plan.spans[1].keyIndex == 2);
+    CHECK(plan.spans[1].dstIndex == 3);
+    CHECK(plan.spans[2].kind == animSamplePlan::Keys);
+    CHECK(plan.layout == animSamplePlan::Generic);
+    CHECK(!plan.clips[0].laneSampled);
+
+    // 8-bit keys round trip within half a quantization step
+    const float values[3] = { -1.0f, 0.25f, 1.0f };
+    int16_t packed[2];
+    float decoded[4];
+    animSampler::encodeU8(clip.Curves[0], values, packed);
+    animSampler::decode(clip.Curves[0], packed, decoded);
+    for (int i = 0; i < 3; i++) {
+        CHECK_CLOSE(values[i], decoded[i], 1.0f / 255.0f);
+    }
+
+    // smallest-three quaternions, including a negative largest component
+    const float quats[3][4] = {
+        { 0.0f, 0.0f, 0.0f, 1.0f },
+        { 0.5f, -0.5f, 0.5f, 0.5f },
+        { 0.1f, -0.9f, 0.3f, 0.3f },
+    };
+    for (int q = 0; q < 3; q++) {
+        int16_t key[3];
+        animSampler::encodeQuat48(quats[q], key);
+        animSampler::decode(clip.Curves[1], key, decoded);
+        const float dot = quats[q][0]*decoded[0] + quats[q][1]*decoded[1] + quats[q][2]*decoded[2] + quats[q][3]*decoded[3];
+        CHECK_CLOSE(1.0f, fabsf(dot), 0.0001f);
+    }
+
+    // interpolation between keys in opposite hemispheres takes the short path
+    const float q0[4] = { 0.0f, 0.0f, -0.6f, 0.8f };
+    const float q1[4] = { 0.0f, 0.0f, -0.8f, 0.6f };
+    int16_t k0[3], k1[3];
+    animSampler::encodeQuat48(q0, k0);
+    animSampler::encodeQuat48(q1, k1);
+    float dst[4];
+    animSampler::sampleCurve(clip.Curves[1], k0, k1, 0.5f, 1.0f, false, dst);
+    CHECK_CLOSE(-0.7f, dst[2], 0.001f);
+    CHECK_CLOSE(0.7f, dst[3], 0.001f);
+    mgr.discard();
+}
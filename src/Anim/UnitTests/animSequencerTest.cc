@@ -223,3 +223,38 @@ TEST(animSequencerTest) {
     CHECK(!sequencer.items[1].valid);
 }
 
+
+TEST(animSequencerOcclusionTest) {
+    animSequencer sequencer;
+
+    // a base track, and a full-weight override with fade-in on a higher track
+    AnimJob base;
+    base.TrackIndex = 0;
+    sequencer.add(0.0, 1, base, 10.0);
+    AnimJob full;
+    full.TrackIndex = 1;
+    full.StartTime = 1.0f;
+    full.Duration = 2.0f;
+    full.FadeIn = 0.5f;
+    full.FadeOut = 0.5f;
+    sequencer.add(0.0, 2, full, 10.0);
+    // a partial-weight overlay on top
+    AnimJob overlay;
+    overlay.TrackIndex = 2;
+    overlay.MixWeight = 0.5f;
+    sequencer.add(0.0, 3, overlay, 10.0);
+    CHECK(sequencer.items.Size() == 3);
+
+    // before the override starts, nothing is occluded
+    CHECK(sequencer.firstVisibleItem(0.5) == 0);
+    // during fade-in, the base track is still visible
+    CHECK(sequencer.firstVisibleItem(1.25) == 0);
+    // at full weight, the base track is occluded
+    CHECK(sequencer.firstVisibleItem(2.0) == 1);
+    // during fade-out, the base track is visible again
+    CHECK(sequencer.firstVisibleItem(2.75) == 0);
+    // after the override has ended
+    CHECK(sequencer.firstVisibleItem(4.0) == 0);
+    CHECK_CLOSE(animSequencer::weight(sequencer.items[1], 1.25), 0.5f, 0.0001f);
+    CHECK_CLOSE(animSequencer::weight(sequencer.items[2], 2.0), 0.5f, 0.0001f);
+}
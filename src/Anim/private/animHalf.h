@@ -0,0 +1,116 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @file Anim/private/animHalf.h
+    @ingroup _priv
+    @brief float to half-float conversion
+
+    Converts arrays of floats to IEEE 754 half-floats (and back) with
+    round-to-nearest-even. Uses the F16C instructions if the compiler
+    targets them (e.g. -mf16c or -march=haswell), otherwise a scalar
+    bit-twiddling path which produces the same results.
+*/
+#include "Core/Types.h"
+#include <string.h>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#define ORYOL_ANIM_USE_F16C (1)
+#endif
+
+namespace Oryol {
+namespace _priv {
+
+//------------------------------------------------------------------------------
+/// convert a float to half-float (round to nearest even)
+inline uint16_t
+animFloatToHalf(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    const uint32_t sign = u & 0x80000000;
+    u ^= sign;
+    uint32_t h;
+    if (u >= (143 << 23)) {
+        // too big for half: infinity, or NaN
+        h = (u > (255 << 23)) ? 0x7E00 : 0x7C00;
+    }
+    else if (u < (113 << 23)) {
+        // half denormal or zero, let the FPU do the rounding
+        const uint32_t magicBits = 126 << 23;
+        float magic, tmp;
+        memcpy(&magic, &magicBits, sizeof(magic));
+        memcpy(&tmp, &u, sizeof(tmp));
+        tmp += magic;
+        memcpy(&h, &tmp, sizeof(h));
+        h -= magicBits;
+    }
+    else {
+        // normal half, rebias exponent and round the mantissa
+        const uint32_t mantOdd = (u >> 13) & 1;
+        u += (uint32_t(15 - 127) << 23) + 0xFFF + mantOdd;
+        h = u >> 13;
+    }
+    return uint16_t(h | (sign >> 16));
+}
+
+//------------------------------------------------------------------------------
+/// convert a half-float to float
+inline float
+animHalfToFloat(uint16_t h) {
+    const uint32_t shiftedExp = 0x7C00 << 13;
+    uint32_t u = uint32_t(h & 0x7FFF) << 13;
+    const uint32_t exp = u & shiftedExp;
+    u += (127 - 15) << 23;
+    if (exp == shiftedExp) {
+        // infinity or NaN
+        u += (128 - 16) << 23;
+    }
+    else if (0 == exp) {
+        // zero or denormal, renormalize
+        const uint32_t magicBits = 113 << 23;
+        float magic, tmp;
+        u += 1 << 23;
+        memcpy(&magic, &magicBits, sizeof(magic));
+        memcpy(&tmp, &u, sizeof(tmp));
+        tmp -= magic;
+        memcpy(&u, &tmp, sizeof(u));
+    }
+    u |= uint32_t(h & 0x8000) << 16;
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+//------------------------------------------------------------------------------
+/// convert an array of floats to half-floats
+inline void
+animFloatToHalf(const float* src, uint16_t* dst, int num) {
+    int i = 0;
+    #if ORYOL_ANIM_USE_F16C
+    for (; (i + 4) <= num; i += 4) {
+        const __m128i h = _mm_cvtps_ph(_mm_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storel_epi64((__m128i*)(dst + i), h);
+    }
+    #endif
+    for (; i < num; i++) {
+        dst[i] = animFloatToHalf(src[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+/// convert an array of half-floats to floats
+inline void
+animHalfToFloat(const uint16_t* src, float* dst, int num) {
+    int i = 0;
+    #if ORYOL_ANIM_USE_F16C
+    for (; (i + 4) <= num; i += 4) {
+        _mm_storeu_ps(dst + i, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)(src + i))));
+    }
+    #endif
+    for (; i < num; i++) {
+        dst[i] = animHalfToFloat(src[i]);
+    }
+}
+
+} // namespace _priv
+} // namespace Oryol
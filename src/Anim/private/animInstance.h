@@ -13,6 +13,7 @@ namespace Oryol {
 
 struct AnimLibrary;
 struct AnimSkeleton;
+struct AnimBake;
 
 namespace _priv {
 
@@ -28,6 +29,68 @@ public:
     Slice<float> samples;
     /// skeleton evaluation result as 4x3 transposed matrices (only valid for active instances)
     Slice<float> skinMatrices;
+    /// true if the samples are stored as half-floats (the root bone in full precision)
+    bool halfSamples = false;
+    /// the stored half-float samples (only valid for active instances with halfSamples),
+    /// samples only points to unpacked samples while the instance is evaluated
+    Slice<float> packedSamples;
+    /// true if only the skin matrices are used, the samples may not be written
+    bool skinOnly = false;
+    /// true if the skin matrices are sampled straight from the keys of fusedClip in the current frame
+    bool fusedEval = false;
+    /// the sampled clip of a fused evaluation
+    animSequencer::clipSample fusedClip;
+
+    /// persistent offset of the samples in the sample pool (InvalidIndex if no slot)
+    int sampleOffset = InvalidIndex;
+    /// persistent page and position in the skin matrix table in pixels (InvalidIndex if no slot)
+    int skinSlotPage = InvalidIndex;
+    int skinSlotX = InvalidIndex;
+    int skinSlotY = InvalidIndex;
+    /// the skeleton bone LOD level
+    int boneLod = 0;
+    /// bitmask of output buffers whose samples outside the bone LOD hold the static pose of lodTailClip
+    uint32_t lodTailOutputs = 0;
+    int lodTailClip = InvalidIndex;
+    /// index in AnimSkinMatrixInfo::InstanceInfos (only valid for active instances)
+    int skinInfoIndex = InvalidIndex;
+    /// hash of the evaluated pose (only valid while sharing poses)
+    uint64_t poseHash = 0;
+    /// true if the samples and skin matrices alias the pose of another instance in the current frame
+    bool poseShared = false;
+    /// hash of the anim jobs and key positions which produced the current pose
+    uint64_t stateHash = 0;
+    /// frame index when the instance's own samples and skin matrices last held its pose
+    uint32_t lastPoseFrame = 0;
+    /// true if the pose is the same as in the previous frame
+    bool poseUnchanged = false;
+    /// optional baked skin matrices which replace evaluation (looked up each
+    /// frame, the instance is evaluated again if the bake has been destroyed)
+    Oryol::Id bake;
+    /// index of the played clip in bake->Clips
+    int bakeClip = 0;
+    /// absolute start time of the baked clip
+    double bakeStartTime = 0.0;
+    /// default update interval in frames
+    int updateInterval = 1;
+    /// interpolate between the last two evaluations in skipped frames
+    bool interpolate = false;
+    /// update interval of the assigned phase (1 if no phase assigned)
+    int lodInterval = 1;
+    /// frame phase in which the instance is evaluated
+    int lodPhase = 0;
+    /// true if the instance is evaluated in the current frame
+    bool lodEval = true;
+    /// frame index when the instance was last active
+    uint32_t lastActiveFrame = 0;
+    /// frame index when the instance was last evaluated
+    uint32_t lastEvalFrame = 0;
+    /// last 2 evaluated poses (samples followed by skin matrices), only allocated while lodInterval > 1
+    float* history = nullptr;
+    /// index of the most recent pose in history
+    int historyIndex = 0;
+    /// number of valid poses in history
+    int numHistory = 0;
 
     /// clear the object
     void clear() {
@@ -35,6 +98,37 @@ public:
         skeleton = nullptr;
         samples.Reset();
         skinMatrices.Reset();
+        halfSamples = false;
+        packedSamples.Reset();
+        skinOnly = false;
+        fusedEval = false;
+        fusedClip = animSequencer::clipSample();
+        sampleOffset = InvalidIndex;
+        skinSlotPage = InvalidIndex;
+        skinSlotX = InvalidIndex;
+        skinSlotY = InvalidIndex;
+        boneLod = 0;
+        lodTailOutputs = 0;
+        lodTailClip = InvalidIndex;
+        skinInfoIndex = InvalidIndex;
+        poseHash = 0;
+        poseShared = false;
+        stateHash = 0;
+        lastPoseFrame = 0;
+        poseUnchanged = false;
+        bake = Oryol::Id::InvalidId();
+        bakeClip = 0;
+        bakeStartTime = 0.0;
+        updateInterval = 1;
+        interpolate = false;
+        lodInterval = 1;
+        lodPhase = 0;
+        lodEval = true;
+        lastActiveFrame = 0;
+        lastEvalFrame = 0;
+        history = nullptr;
+        historyIndex = 0;
+        numHistory = 0;
     }
 };
 
@@ -0,0 +1,204 @@
+//------------------------------------------------------------------------------
+//  animKeyCache.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "animKeyCache.h"
+#include "Core/Memory/Memory.h"
+
+namespace Oryol {
+namespace _priv {
+
+//------------------------------------------------------------------------------
+animKeyCache::~animKeyCache() {
+    o_assert_dbg(!this->isValid);
+}
+
+//------------------------------------------------------------------------------
+void
+animKeyCache::setup(int maxNumLibs, int capacity_, int loadBudget_) {
+    o_assert_dbg(!this->isValid);
+    o_assert_dbg((capacity_ >= 0) && (loadBudget_ >= 0));
+    this->isValid = true;
+    this->capacity = capacity_;
+    this->loadBudget = loadBudget_;
+    this->numCachedKeys = 0;
+    this->frameIndex = 1;
+    this->libs.SetFixedCapacity(maxNumLibs);
+    for (int i = 0; i < maxNumLibs; i++) {
+        this->libs.Add();
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animKeyCache::discard() {
+    o_assert_dbg(this->isValid);
+    for (int i = 0; i < this->libs.Size(); i++) {
+        if (this->isStreaming(i)) {
+            this->removeLibrary(i);
+        }
+    }
+    o_assert_dbg(0 == this->numCachedKeys);
+    this->libs.Clear();
+    this->requests.Clear();
+    this->changed.Clear();
+    this->isValid = false;
+}
+
+//------------------------------------------------------------------------------
+void
+animKeyCache::addLibrary(int libSlot, FILE* file, int numClips) {
+    o_assert_dbg(this->isValid && file);
+    library& lib = this->libs[libSlot];
+    o_assert_dbg(!lib.file && lib.blocks.Empty());
+    lib.file = file;
+    lib.blocks.Reserve(numClips);
+    for (int i = 0; i < numClips; i++) {
+        lib.blocks.Add();
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animKeyCache::setBlock(int libSlot, int clipIndex, uint32_t fileOffset, int numKeys) {
+    block& b = this->libs[libSlot].blocks[clipIndex];
+    o_assert_dbg(!b.keys);
+    b.fileOffset = fileOffset;
+    b.numKeys = numKeys;
+}
+
+//------------------------------------------------------------------------------
+void
+animKeyCache::removeLibrary(int libSlot) {
+    library& lib = this->libs[libSlot];
+    o_assert_dbg(lib.file);
+    for (int i = 0; i < lib.blocks.Size(); i++) {
+        this->freeBlock(libSlot, i);
+    }
+    for (int i = this->requests.Size() - 1; i >= 0; i--) {
+        if (this->requests[i].libSlot == libSlot) {
+            this->requests.Erase(i);
+        }
+    }
+    fclose(lib.file);
+    lib.file = nullptr;
+    lib.blocks.Clear();
+}
+
+//------------------------------------------------------------------------------
+bool
+animKeyCache::isStreaming(int libSlot) const {
+    return nullptr != this->libs[libSlot].file;
+}
+
+//------------------------------------------------------------------------------
+void
+animKeyCache::use(int libSlot, int clipIndex) {
+    block& b = this->libs[libSlot].blocks[clipIndex];
+    b.lastUsed = this->frameIndex;
+    if (!b.keys && !b.requested && !b.failed && (b.numKeys > 0)) {
+        b.requested = true;
+        clipRef& ref = this->requests.Add();
+        ref.libSlot = libSlot;
+        ref.clipIndex = clipIndex;
+    }
+}
+
+//------------------------------------------------------------------------------
+int16_t*
+animKeyCache::keys(int libSlot, int clipIndex) const {
+    return this->libs[libSlot].blocks[clipIndex].keys;
+}
+
+//------------------------------------------------------------------------------
+void
+animKeyCache::freeBlock(int libSlot, int clipIndex) {
+    block& b = this->libs[libSlot].blocks[clipIndex];
+    if (b.keys) {
+        Memory::Free(b.keys);
+        b.keys = nullptr;
+        this->numCachedKeys -= b.numKeys;
+        o_assert_dbg(this->numCachedKeys >= 0);
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+animKeyCache::evict(int numKeys, refFunc func, void* userData) {
+    while ((this->numCachedKeys + numKeys) > this->capacity) {
+        // find the least recently used block which isn't referenced by any anim job
+        int lruLib = InvalidIndex;
+        int lruClip = InvalidIndex;
+        uint32_t lruFrame = 0;
+        for (int libSlot = 0; libSlot < this->libs.Size(); libSlot++) {
+            const library& lib = this->libs[libSlot];
+            for (int clipIndex = 0; clipIndex < lib.blocks.Size(); clipIndex++) {
+                const block& b = lib.blocks[clipIndex];
+                if (b.keys && ((InvalidIndex == lruLib) || (b.lastUsed < lruFrame)) && !func(userData, libSlot, clipIndex)) {
+                    lruLib = libSlot;
+                    lruClip = clipIndex;
+                    lruFrame = b.lastUsed;
+                }
+            }
+        }
+        if (InvalidIndex == lruLib) {
+            return false;
+        }
+        this->freeBlock(lruLib, lruClip);
+        clipRef& ref = this->changed.Add();
+        ref.libSlot = lruLib;
+        ref.clipIndex = lruClip;
+        this->numEvictions++;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void
+animKeyCache::update(refFunc func, void* userData) {
+    o_assert_dbg(this->isValid && func);
+    this->changed.Clear();
+
+    // load requested blocks in request order, at least one block is
+    // loaded per frame even if it exceeds the load budget
+    int numLoadedKeys = 0;
+    while (!this->requests.Empty()) {
+        const clipRef ref = this->requests[0];
+        library& lib = this->libs[ref.libSlot];
+        block& b = lib.blocks[ref.clipIndex];
+        if ((numLoadedKeys > 0) && ((numLoadedKeys + b.numKeys) > this->loadBudget)) {
+            break;
+        }
+        if (b.numKeys > this->capacity) {
+            o_warn("Anim: clip key block doesn't fit into stream cache!\n");
+            b.failed = true;
+        }
+        else if (!this->evict(b.numKeys, func, userData)) {
+            // all cached blocks are in use, try again next frame
+            break;
+        }
+        else {
+            const int size = b.numKeys * sizeof(int16_t);
+            int16_t* keys = (int16_t*) Memory::Alloc(size);
+            if ((0 == fseek(lib.file, long(b.fileOffset), SEEK_SET)) && (1 == fread(keys, size, 1, lib.file))) {
+                b.keys = keys;
+                this->numCachedKeys += b.numKeys;
+                numLoadedKeys += b.numKeys;
+                this->numLoads++;
+                clipRef& changedRef = this->changed.Add();
+                changedRef = ref;
+            }
+            else {
+                o_warn("Anim: failed to read clip keys from stream file!\n");
+                Memory::Free(keys);
+                b.failed = true;
+            }
+        }
+        b.requested = false;
+        this->requests.Erase(0);
+    }
+    this->frameIndex++;
+}
+
+} // namespace _priv
+} // namespace Oryol
@@ -0,0 +1,91 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::_priv::animKeyCache
+    @ingroup _priv
+    @brief bounded LRU cache for the key blocks of streamed libraries
+
+    Streamed libraries keep their keys in an AnimLibraryFormat file,
+    and only the key blocks of clips which are actually played are
+    resident. A clip is requested when it is played, and loaded
+    in update() (once per frame) within a per-frame load budget.
+    If the cache is full, the least recently used blocks which are
+    not referenced by any anim job are evicted. The cache doesn't know
+    about anim jobs, the caller provides a function which checks
+    whether a clip is still referenced.
+
+    Every clip whose residency changed in update() is recorded in
+    the 'changed' array, so that the caller can fix up the clip's
+    key view.
+*/
+#include "Core/Types.h"
+#include "Core/Containers/Array.h"
+#include <stdio.h>
+
+namespace Oryol {
+namespace _priv {
+
+class animKeyCache {
+public:
+    /// function which checks if a clip is referenced by an anim job
+    typedef bool (*refFunc)(void* userData, int libSlot, int clipIndex);
+
+    /// destructor
+    ~animKeyCache();
+
+    /// setup the cache
+    void setup(int maxNumLibs, int capacity, int loadBudget);
+    /// discard the cache
+    void discard();
+
+    /// start streaming a library from an open file (the cache takes ownership of the file)
+    void addLibrary(int libSlot, FILE* file, int numClips);
+    /// set the file location of a clip's key block
+    void setBlock(int libSlot, int clipIndex, uint32_t fileOffset, int numKeys);
+    /// stop streaming a library, frees its blocks and closes the file
+    void removeLibrary(int libSlot);
+    /// return true if a library is streamed
+    bool isStreaming(int libSlot) const;
+    /// mark a clip as used in the current frame, and request its keys if not resident
+    void use(int libSlot, int clipIndex);
+    /// get the resident keys of a clip (nullptr if not resident)
+    int16_t* keys(int libSlot, int clipIndex) const;
+    /// load requested blocks within the load budget, evicting unreferenced blocks if needed
+    void update(refFunc func, void* userData);
+
+    struct block {
+        uint32_t fileOffset = 0;
+        int numKeys = 0;
+        int16_t* keys = nullptr;
+        uint32_t lastUsed = 0;
+        bool requested = false;
+        bool failed = false;
+    };
+    struct library {
+        FILE* file = nullptr;
+        Array<block> blocks;
+    };
+    struct clipRef {
+        uint16_t libSlot = 0;
+        uint16_t clipIndex = 0;
+    };
+
+    /// try to make room for numKeys keys by evicting blocks
+    bool evict(int numKeys, refFunc func, void* userData);
+    /// free a resident block
+    void freeBlock(int libSlot, int clipIndex);
+
+    bool isValid = false;
+    int capacity = 0;       // in number of keys
+    int loadBudget = 0;     // in number of keys per update
+    int numCachedKeys = 0;
+    uint32_t frameIndex = 1;
+    int numLoads = 0;
+    int numEvictions = 0;
+    Array<library> libs;    // indexed by library slot index
+    Array<clipRef> requests;
+    Array<clipRef> changed;
+};
+
+} // namespace _priv
+} // namespace Oryol
@@ -3,14 +3,27 @@
 //------------------------------------------------------------------------------
 #include "Pre.h"
 #include "animMgr.h"
+#include "animProfiler.h"
+#include "animHalf.h"
 #include "Core/Memory/Memory.h"
+#include "Core/Time/Clock.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <cstring>
+#include <math.h>
 
 namespace Oryol {
 namespace _priv {
 
+// per-participant bone matrix scratch, 4x3 matrices of all skeleton bones
+// in the SIMD lanes of genSkinMatricesBatch(), or as scalars
+#if ORYOL_ANIM_USE_SIMD_LANES
+static const int boneScratchFloats = AnimConfig::MaxNumSkeletonBones * 12 * animVecLanes;
+#else
+static const int boneScratchFloats = AnimConfig::MaxNumSkeletonBones * 12;
+#endif
+static const int boneScratchAlign = 32;
+
 //------------------------------------------------------------------------------
 animMgr::~animMgr() {
     o_assert_dbg(!this->isValid);
@@ -25,24 +38,86 @@ animMgr::setup(const AnimSetup& setup) {
     this->isValid = true;
     this->resContainer.Setup(setup.ResourceLabelStackCapacity, setup.ResourceRegistryCapacity);
     this->libPool.Setup(resTypeLib, setup.MaxNumLibs);
+    this->samplePlans.SetFixedCapacity(setup.MaxNumLibs);
+    for (int i = 0; i < setup.MaxNumLibs; i++) {
+        this->samplePlans.Add();
+    }
     this->skelPool.Setup(resTypeSkeleton, setup.MaxNumSkeletons);
+    this->maskPool.Setup(resTypeMask, setup.MaxNumMasks);
+    this->bakePool.Setup(resTypeBake, setup.MaxNumBakes);
     this->instPool.Setup(resTypeInstance, setup.MaxNumInstances);
     this->clipPool.SetFixedCapacity(setup.ClipPoolCapacity);
+    for (int i = 0; i < setup.ClipPoolCapacity; i++) {
+        this->clipPool.Add();
+    }
     this->curvePool.SetFixedCapacity(setup.CurvePoolCapacity);
+    for (int i = 0; i < setup.CurvePoolCapacity; i++) {
+        this->curvePool.Add();
+    }
     this->matrixPool.SetFixedCapacity(setup.MatrixPoolCapacity);
+    for (int i = 0; i < setup.MatrixPoolCapacity; i++) {
+        this->matrixPool.Add();
+    }
+    this->clipAllocator.setup(setup.ClipPoolCapacity);
+    this->curveAllocator.setup(setup.CurvePoolCapacity);
+    this->matrixAllocator.setup(setup.MatrixPoolCapacity);
+    this->keyAllocator.setup(setup.KeyPoolCapacity);
     this->activeInstances.SetFixedCapacity(setup.MaxNumActiveInstances);
-    this->skinMatrixInfo.InstanceInfos.SetFixedCapacity(setup.MaxNumActiveInstances);
+    const int maxNumChunks = setup.EvaluateChunkSize > 0 ? (setup.MaxNumActiveInstances / setup.EvaluateChunkSize) + 1 : 1;
+    this->evalChunkStats.SetFixedCapacity(maxNumChunks);
+    for (int i = 0; i < maxNumChunks; i++) {
+        this->evalChunkStats.Add();
+    }
+    int poseCacheSize = 1;
+    while (poseCacheSize < (setup.MaxNumActiveInstances * 2)) {
+        poseCacheSize <<= 1;
+    }
+    this->poseCacheSlots.SetFixedCapacity(poseCacheSize);
+    for (int i = 0; i < poseCacheSize; i++) {
+        this->poseCacheSlots.Add(InvalidIndex);
+    }
     this->keyPool = (int16_t*) Memory::Alloc(setup.KeyPoolCapacity * sizeof(int16_t));
-    this->samplePool = (float*) Memory::Alloc(setup.SamplePoolCapacity * sizeof(float));
     this->keys = Slice<int16_t>(this->keyPool, setup.KeyPoolCapacity, 0, setup.KeyPoolCapacity);
-    this->samples = Slice<float>(this->samplePool, setup.SamplePoolCapacity, 0, setup.SamplePoolCapacity);
+
+    // each output buffer has its own samples and skin matrix table, all
+    // of them use the same slot layout
+    o_assert_dbg((setup.NumOutputBuffers > 0) && (setup.NumOutputBuffers <= 32));
+    const int numOutputs = setup.NumOutputBuffers;
+    this->samplePool = (float*) Memory::Alloc(numOutputs * setup.SamplePoolCapacity * sizeof(float));
     this->skinMatrixTableStride = setup.SkinMatrixTableWidth * 4;
-    const int skinMatrixPoolNumFloats = this->skinMatrixTableStride * setup.SkinMatrixTableHeight;
-    const int skinMatrixPoolSize = skinMatrixPoolNumFloats * sizeof(float);
-    this->skinMatrixPool = (float*) Memory::Alloc(skinMatrixPoolSize);
-    Memory::Clear(this->skinMatrixPool, skinMatrixPoolSize);
-    this->skinMatrixTable = Slice<float>(this->skinMatrixPool, skinMatrixPoolNumFloats);
-    this->skinMatrixInfo.SkinMatrixTable = this->skinMatrixTable.begin();
+    this->skinMatrixTableNumFloats = this->skinMatrixTableStride * setup.SkinMatrixTableHeight;
+    o_assert_dbg(setup.MaxNumSkinMatrixPages > 0);
+    this->skinPages.SetFixedCapacity(setup.MaxNumSkinMatrixPages);
+    this->outputs.SetFixedCapacity(numOutputs);
+    for (int i = 0; i < numOutputs; i++) {
+        AnimSkinMatrixInfo& info = this->outputs.Add().skinMatrixInfo;
+        info.Pages.SetFixedCapacity(setup.MaxNumSkinMatrixPages);
+        info.InstanceInfos.SetFixedCapacity(setup.MaxNumActiveInstances);
+    }
+    const int maxNumSkinRows = setup.MaxNumSkinMatrixPages * setup.SkinMatrixTableHeight;
+    this->skinRowDirty.SetFixedCapacity(maxNumSkinRows);
+    for (int i = 0; i < maxNumSkinRows; i++) {
+        this->skinRowDirty.Add(0);
+    }
+    // the first page always exists, further pages are created on demand
+    this->allocSkinPage();
+    this->curOutput = 0;
+    this->prevOutput = 0;
+    this->readyOutput = InvalidIndex;
+    this->selectOutput(0);
+    this->sampleAllocator.setup(setup.SamplePoolCapacity);
+    this->slotInstances.Reserve(setup.MaxNumActiveInstances * 2);
+    if (setup.NumWorkerThreads > 0) {
+        this->workerPool.setup(setup.NumWorkerThreads);
+    }
+    // bone matrix scratch for genSkinMatrices() on the calling thread and each worker
+    o_assert_dbg(setup.NumWorkerThreads <= animWorkerPool::MaxNumThreads);
+    for (int i = 0; i <= setup.NumWorkerThreads; i++) {
+        evalScratch& scratch = this->evalScratches[i];
+        scratch.boneAlloc = Memory::Alloc(boneScratchFloats * sizeof(float) + boneScratchAlign);
+        scratch.boneMatrices = (float*) ((uintptr_t(scratch.boneAlloc) + boneScratchAlign - 1) & ~uintptr_t(boneScratchAlign - 1));
+    }
+    this->keyCache.setup(setup.MaxNumLibs, setup.StreamCacheCapacity, setup.StreamLoadBudget);
 }
 
 //------------------------------------------------------------------------------
@@ -51,22 +126,61 @@ animMgr::discard() {
     o_assert_dbg(this->isValid);
     o_assert_dbg(this->keyPool);
     o_assert_dbg(this->samplePool);
-    o_assert_dbg(this->skinMatrixPool);
+    o_assert_dbg(!this->skinPages.Empty());
 
+    if (this->workerPool.isValid) {
+        this->workerPool.discard();
+    }
     this->destroy(ResourceLabel::All);
+    this->keyCache.discard();
     this->resContainer.Discard();
     this->instPool.Discard();
+    this->bakePool.Discard();
+    this->maskPool.Discard();
     this->skelPool.Discard();
     this->libPool.Discard();
-    o_assert_dbg(this->clipPool.Empty());
-    o_assert_dbg(this->curvePool.Empty());
-    o_assert_dbg(this->matrixPool.Empty());
+    this->samplePlans.Clear();
+    o_assert_dbg(0 == this->clipAllocator.numUsed);
+    o_assert_dbg(0 == this->curveAllocator.numUsed);
+    o_assert_dbg(0 == this->matrixAllocator.numUsed);
+    o_assert_dbg(0 == this->keyAllocator.numUsed);
+    this->clipAllocator.discard();
+    this->curveAllocator.discard();
+    this->matrixAllocator.discard();
+    this->keyAllocator.discard();
+    this->clipPool.Clear();
+    this->curvePool.Clear();
+    this->matrixPool.Clear();
     this->activeInstances.Clear();
+    this->evalChunkStats.Clear();
+    this->poseCacheSlots.Clear();
+    o_assert_dbg(this->slotInstances.Empty());
+    o_assert_dbg(0 == this->sampleAllocator.numUsed);
+    this->sampleAllocator.discard();
+    this->skinRowDirty.Clear();
     this->keys.Reset();
     this->samples.Reset();
-    this->skinMatrixTable.Reset();
-    Memory::Free(this->skinMatrixPool);
-    this->skinMatrixPool = nullptr;
+    this->skinMatrixInfo = nullptr;
+    this->outputs.Clear();
+    for (skinPage& page : this->skinPages) {
+        Memory::Free(page.pool);
+        if (page.halfPool) {
+            Memory::Free(page.halfPool);
+        }
+    }
+    this->skinPages.Clear();
+    for (evalScratch& scratch : this->evalScratches) {
+        if (scratch.samples) {
+            Memory::Free(scratch.samples);
+            scratch.samples = nullptr;
+            scratch.capacity = 0;
+        }
+        if (scratch.boneAlloc) {
+            Memory::Free(scratch.boneAlloc);
+            scratch.boneAlloc = nullptr;
+            scratch.boneMatrices = nullptr;
+        }
+    }
     Memory::Free(this->keyPool);
     this->keyPool = nullptr;
     Memory::Free(this->samplePool);
@@ -90,6 +204,12 @@ animMgr::destroy(const ResourceLabel& label) {
             case resTypeInstance:
                 this->destroyInstance(id);
                 break;
+            case resTypeMask:
+                this->destroyMask(id);
+                break;
+            case resTypeBake:
+                this->destroyBake(id);
+                break;
             default:
                 o_assert2_dbg(false, "animMgr::destroy: unknown resource type\n");
                 break;
@@ -97,9 +217,52 @@ animMgr::destroy(const ResourceLabel& label) {
     }
 }
 
+//------------------------------------------------------------------------------
+void
+animMgr::warnAllocFailed(const char* poolName, const animRangeAllocator& allocator, int num) {
+    // the pools aren't defragmented, an allocation may fail although
+    // there's enough free space in total
+    const int numFree = allocator.capacity - allocator.numUsed;
+    if (numFree >= num) {
+        o_warn("Anim: %s pool too fragmented (%d needed, %d free, largest free range %d)!\n",
+            poolName, num, numFree, allocator.largestFree());
+        #if ORYOL_ANIM_FRAME_STATS
+        this->frameStats.NumFragmentedPoolFailures++;
+        #endif
+    }
+    else {
+        o_warn("Anim: %s pool exhausted!\n", poolName);
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+animMgr::allocLibraryRanges(int numClips, int numCurves, int numKeys, int& outClipIndex, int& outCurveIndex, int& outKeyIndex) {
+    outClipIndex = this->clipAllocator.alloc(numClips);
+    if (InvalidIndex == outClipIndex) {
+        this->warnAllocFailed("clip", this->clipAllocator, numClips);
+        return false;
+    }
+    outCurveIndex = this->curveAllocator.alloc(numCurves);
+    if (InvalidIndex == outCurveIndex) {
+        this->warnAllocFailed("curve", this->curveAllocator, numCurves);
+        this->clipAllocator.free(outClipIndex, numClips);
+        return false;
+    }
+    outKeyIndex = this->keyAllocator.alloc(numKeys);
+    if (InvalidIndex == outKeyIndex) {
+        this->warnAllocFailed("key", this->keyAllocator, numKeys);
+        this->curveAllocator.free(outCurveIndex, numCurves);
+        this->clipAllocator.free(outClipIndex, numClips);
+        return false;
+    }
+    return true;
+}
+
 //------------------------------------------------------------------------------
 Id
 animMgr::createLibrary(const AnimLibrarySetup& libSetup) {
+    ORYOL_ANIM_ZONE("Anim::createLibrary");
     o_assert_dbg(this->isValid);
     o_assert_dbg(libSetup.Locator.HasValidLocation());
     o_assert_dbg(!libSetup.CurveLayout.Empty());
@@ -112,15 +275,7 @@ animMgr::createLibrary(const AnimLibrarySetup& libSetup) {
         return resId;
     }
 
-    // before creating new lib, validate setup params and check against pool limits
-    if ((this->clipPool.Size() + libSetup.Clips.Size()) > this->clipPool.Capacity()) {
-        o_warn("Anim: clip pool exhausted!\n");
-        return Id::InvalidId();
-    }
-    if ((this->curvePool.Size() + libSetup.CurveLayout.Size()) > this->curvePool.Capacity()) {
-        o_warn("Anim: curve pool exhausted!\n");
-        return Id::InvalidId();
-    }
+    // before creating new lib, validate setup params and allocate pool ranges
     int libNumKeys = 0;
     for (const auto& clipSetup : libSetup.Clips) {
         if (clipSetup.Curves.Size() != libSetup.CurveLayout.Size()) {
@@ -129,12 +284,14 @@ animMgr::createLibrary(const AnimLibrarySetup& libSetup) {
         }
         for (int i = 0; i < clipSetup.Curves.Size(); i++) {
             if (!clipSetup.Curves[i].Static) {
-                libNumKeys += clipSetup.Length * AnimCurveFormat::Stride(libSetup.CurveLayout[i]); 
+                libNumKeys += clipSetup.Length * AnimCurveFormat::KeyStride(libSetup.CurveLayout[i]);
             }
         }
     }
-    if ((this->numKeys + libNumKeys) > this->keys.Size()) {
-        o_warn("Anim: key pool exhausted!\n");
+    const int numClips = libSetup.Clips.Size();
+    const int numCurves = numClips * libSetup.CurveLayout.Size();
+    int clipPoolIndex, curvePoolIndex, keyPoolIndex;
+    if (!this->allocLibraryRanges(numClips, numCurves, libNumKeys, clipPoolIndex, curvePoolIndex, keyPoolIndex)) {
         return Id::InvalidId();
     }
 
@@ -143,52 +300,55 @@ animMgr::createLibrary(const AnimLibrarySetup& libSetup) {
     AnimLibrary& lib = this->libPool.Assign(resId, ResourceState::Setup);
     lib.Locator = libSetup.Locator;
     lib.SampleStride = 0;
+    lib.KeyReductionTolerance = libSetup.KeyReductionTolerance;
+    lib.StaticCurveTolerance = libSetup.StaticCurveTolerance;
     for (AnimCurveFormat::Enum fmt : libSetup.CurveLayout) {
         lib.CurveLayout.Add(fmt);
     }
     for (auto fmt : libSetup.CurveLayout) {
         lib.SampleStride += AnimCurveFormat::Stride(fmt);
     }
-    lib.ClipIndexMap.Reserve(libSetup.Clips.Size());
-    const int curvePoolIndex = this->curvePool.Size();
-    const int clipPoolIndex = this->clipPool.Size();
-    int clipKeyIndex = this->numKeys;
-    for (const auto& clipSetup : libSetup.Clips) {
-        lib.ClipIndexMap.Add(clipSetup.Name, this->clipPool.Size());
-        AnimClip& clip = this->clipPool.Add();
+    lib.ClipIndexMap.Reserve(numClips);
+    int clipKeyIndex = keyPoolIndex;
+    for (int clipIndex = 0; clipIndex < numClips; clipIndex++) {
+        const auto& clipSetup = libSetup.Clips[clipIndex];
+        lib.ClipIndexMap.Add(clipSetup.Name, clipIndex);
+        AnimClip& clip = this->clipPool[clipPoolIndex + clipIndex];
         clip.Name = clipSetup.Name;
         clip.Length = clipSetup.Length;
         clip.KeyDuration = clipSetup.KeyDuration;
-        const int curveIndex = this->curvePool.Size();
+        const int clipCurveIndex = curvePoolIndex + clipIndex * clipSetup.Curves.Size();
         for (int curveIndex = 0; curveIndex < clipSetup.Curves.Size(); curveIndex++) {
             const auto& curveSetup = clipSetup.Curves[curveIndex];
-            AnimCurve& curve = this->curvePool.Add();
+            AnimCurve& curve = this->curvePool[clipCurveIndex + curveIndex];
             curve.Static = curveSetup.Static;
             curve.Format = libSetup.CurveLayout[curveIndex];
             curve.NumValues = AnimCurveFormat::Stride(curve.Format);
+            // premultiply magnitude for 16-bit signed or 8-bit unsigned unpacking
+            const bool isU8 = AnimCurveFormat::IsPacked(curve.Format) && (curve.Format != AnimCurveFormat::Quaternion48);
+            const float unpackScale = isU8 ? 1.0f / 255.0f : 1.0f / 32767.0f;
             for (int i = 0; i < 4; i++) {
                 curve.StaticValue[i] = curveSetup.StaticValue[i];
-                // premultiply magnitude for 16-bit signed unpacking
-                curve.Magnitude[i] = curveSetup.Magnitude[i] / 32767.0f;
+                curve.Magnitude[i] = curveSetup.Magnitude[i] * unpackScale;
+                curve.Offset[i] = curveSetup.Offset[i];
             }
             if (!curve.Static) {
                 curve.KeyIndex = clip.KeyStride;
-                curve.KeyStride = AnimCurveFormat::Stride(curve.Format);
+                curve.KeyStride = AnimCurveFormat::KeyStride(curve.Format);
                 clip.KeyStride += curve.KeyStride;
             }
         }
-        clip.Curves = this->curvePool.MakeSlice(curveIndex, clipSetup.Curves.Size());
+        clip.Curves = this->curvePool.MakeSlice(clipCurveIndex, clipSetup.Curves.Size());
         const int clipNumKeys = clip.KeyStride * clip.Length;
         if (clipNumKeys > 0) {
             clip.Keys = this->keys.MakeSlice(clipKeyIndex, clipNumKeys);
             clipKeyIndex += clipNumKeys;
         }
     }
-    o_assert_dbg(clipKeyIndex == (this->numKeys + libNumKeys));
-    lib.Keys = this->keys.MakeSlice(this->numKeys, libNumKeys);
-    this->numKeys += libNumKeys;
-    lib.Curves = this->curvePool.MakeSlice(curvePoolIndex, libSetup.Clips.Size() * libSetup.CurveLayout.Size());
-    lib.Clips = this->clipPool.MakeSlice(clipPoolIndex, libSetup.Clips.Size());
+    o_assert_dbg(clipKeyIndex == (keyPoolIndex + libNumKeys));
+    lib.Keys = this->keys.MakeSlice(keyPoolIndex, libNumKeys);
+    lib.Curves = this->curvePool.MakeSlice(curvePoolIndex, numCurves);
+    lib.Clips = this->clipPool.MakeSlice(clipPoolIndex, numClips);
 
     // initialize clips with their default values
     /*
@@ -205,11 +365,310 @@ animMgr::createLibrary(const AnimLibrarySetup& libSetup) {
     }
     */
 
+    // build the sampling plan for the evaluation kernels
+    this->samplePlans[resId.SlotIndex].build(lib);
+
     this->resContainer.registry.Add(libSetup.Locator, resId, this->resContainer.PeekLabel());
     this->libPool.UpdateState(resId, ResourceState::Valid);
     return resId;
 }
 
+//------------------------------------------------------------------------------
+static uint32_t
+alignFileOffset(uint32_t offset) {
+    const uint32_t align = AnimLibraryFormat::Alignment;
+    return (offset + align - 1) & ~(align - 1);
+}
+
+//------------------------------------------------------------------------------
+static bool
+validateLibraryData(const char* loc, const uint8_t* data, uint32_t dataSize, uint32_t fileSize) {
+    // validate the header, section bounds and clip and curve records, the
+    // header, clip and curve sections must be in data, the keys only
+    // in the file (streamed libraries don't load the keys upfront)
+    if (dataSize < sizeof(AnimLibraryFormat::Header)) {
+        o_warn("Anim: library data of '%s' is truncated!\n", loc);
+        return false;
+    }
+    const auto* hdr = (const AnimLibraryFormat::Header*) data;
+    if ((hdr->Magic != AnimLibraryFormat::Magic) || (hdr->Version != AnimLibraryFormat::Version)) {
+        o_warn("Anim: library data of '%s' has wrong magic or version!\n", loc);
+        return false;
+    }
+    const uint64_t numCurves = uint64_t(hdr->NumClips) * hdr->NumCurves;
+    if ((hdr->FileSize > fileSize) ||
+        (0 == hdr->NumClips) || (0 == hdr->NumCurves) ||
+        (hdr->NumCurves > uint32_t(AnimConfig::MaxNumCurvesInClip)) ||
+        ((hdr->ClipsOffset | hdr->CurvesOffset | hdr->KeysOffset) & (AnimLibraryFormat::Alignment - 1)) ||
+        ((hdr->ClipsOffset + uint64_t(hdr->NumClips) * sizeof(AnimLibraryFormat::Clip)) > dataSize) ||
+        ((hdr->CurvesOffset + numCurves * sizeof(AnimLibraryFormat::Curve)) > dataSize) ||
+        ((hdr->KeysOffset + uint64_t(hdr->NumKeys) * sizeof(int16_t)) > hdr->FileSize)) {
+        o_warn("Anim: library data of '%s' is corrupt!\n", loc);
+        return false;
+    }
+    const auto* fileClips = (const AnimLibraryFormat::Clip*) (data + hdr->ClipsOffset);
+    const auto* fileCurves = (const AnimLibraryFormat::Curve*) (data + hdr->CurvesOffset);
+    for (uint32_t clipIndex = 0; clipIndex < hdr->NumClips; clipIndex++) {
+        const auto& fileClip = fileClips[clipIndex];
+        bool valid = (fileClip.Name[AnimLibraryFormat::MaxClipNameLength - 1] == 0) &&
+                     (fileClip.Length >= 0) && (fileClip.KeyStride >= 0) &&
+                     ((uint64_t(fileClip.KeyIndex) + fileClip.NumKeys) <= hdr->NumKeys);
+        if (valid && !(fileClip.Flags & AnimLibraryFormat::ClipVariableRate)) {
+            valid = (uint64_t(fileClip.KeyStride) * fileClip.Length) == fileClip.NumKeys;
+        }
+        for (uint32_t i = 0; valid && (i < hdr->NumCurves); i++) {
+            const auto& fileCurve = fileCurves[clipIndex * hdr->NumCurves + i];
+            valid = (fileCurve.Format < AnimCurveFormat::Invalid) &&
+                    (fileCurve.Format == fileCurves[i].Format);
+            if (valid && !fileCurve.Static) {
+                const auto fmt = (AnimCurveFormat::Enum) fileCurve.Format;
+                int64_t end = 0;
+                if (fileClip.Flags & AnimLibraryFormat::ClipVariableRate) {
+                    end = fileCurve.KeyIndex + int64_t(fileCurve.NumKeys) * (1 + fileCurve.KeyStride);
+                    valid = (fileCurve.NumKeys > 0) && (end <= fileClip.NumKeys);
+                }
+                else {
+                    end = fileCurve.KeyIndex + int64_t(fileCurve.KeyStride);
+                    valid = end <= fileClip.KeyStride;
+                }
+                valid &= (fileCurve.KeyIndex >= 0) && (fileCurve.KeyStride == AnimCurveFormat::KeyStride(fmt));
+            }
+        }
+        if (!valid) {
+            o_warn("Anim: library data of '%s' has corrupt clip %d!\n", loc, clipIndex);
+            return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+Id
+animMgr::createLibrary(const AnimLibraryDataSetup& setup) {
+    o_assert_dbg(this->isValid);
+    o_assert_dbg(setup.Locator.HasValidLocation());
+    o_assert_dbg(setup.Data && (setup.Size > 0));
+
+    // check if lib already exists
+    Id resId = this->resContainer.registry.Lookup(setup.Locator);
+    if (resId.IsValid()) {
+        o_assert_dbg(resId.Type == resTypeLib);
+        return resId;
+    }
+    const char* loc = setup.Locator.Location().AsCStr();
+    if (0 != (uintptr_t(setup.Data) & (AnimLibraryFormat::Alignment - 1))) {
+        o_warn("Anim: library data of '%s' is not aligned!\n", loc);
+        return Id::InvalidId();
+    }
+    if (!validateLibraryData(loc, setup.Data, setup.Size, setup.Size)) {
+        return Id::InvalidId();
+    }
+    const auto* hdr = (const AnimLibraryFormat::Header*) setup.Data;
+    return this->createLibraryFromData(setup.Locator, setup.Data, (int16_t*) (setup.Data + hdr->KeysOffset));
+}
+
+//------------------------------------------------------------------------------
+Id
+animMgr::createLibrary(const AnimLibraryStreamSetup& setup) {
+    o_assert_dbg(this->isValid);
+    o_assert_dbg(setup.Locator.HasValidLocation());
+
+    // check if lib already exists
+    Id resId = this->resContainer.registry.Lookup(setup.Locator);
+    if (resId.IsValid()) {
+        o_assert_dbg(resId.Type == resTypeLib);
+        return resId;
+    }
+
+    // only load the header, clip and curve sections, which precede the keys
+    const char* path = setup.Path.AsCStr();
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        o_warn("Anim: failed to open anim library file '%s'!\n", path);
+        return Id::InvalidId();
+    }
+    Buffer data;
+    long fileSize = -1;
+    if (0 == fseek(fp, 0, SEEK_END)) {
+        fileSize = ftell(fp);
+    }
+    AnimLibraryFormat::Header hdr;
+    if ((fileSize >= long(sizeof(hdr))) &&
+        (0 == fseek(fp, 0, SEEK_SET)) && (1 == fread(&hdr, sizeof(hdr), 1, fp)) &&
+        (hdr.KeysOffset >= sizeof(hdr)) && (hdr.KeysOffset <= uint32_t(fileSize))) {
+        data.Add((const uint8_t*)&hdr, sizeof(hdr));
+        const int restSize = hdr.KeysOffset - sizeof(hdr);
+        if ((restSize > 0) && (1 != fread(data.Add(restSize), restSize, 1, fp))) {
+            data.Clear();
+        }
+    }
+    if (data.Empty() || !validateLibraryData(path, data.Data(), data.Size(), uint32_t(fileSize))) {
+        o_warn("Anim: failed to load anim library file '%s'!\n", path);
+        fclose(fp);
+        return Id::InvalidId();
+    }
+    resId = this->createLibraryFromData(setup.Locator, data.Data(), nullptr);
+    if (!resId.IsValid()) {
+        fclose(fp);
+        return resId;
+    }
+
+    // register the clip key blocks with the key cache
+    const auto* fileClips = (const AnimLibraryFormat::Clip*) (data.Data() + hdr.ClipsOffset);
+    this->keyCache.addLibrary(resId.SlotIndex, fp, hdr.NumClips);
+    for (uint32_t i = 0; i < hdr.NumClips; i++) {
+        const uint32_t offset = hdr.KeysOffset + fileClips[i].KeyIndex * sizeof(int16_t);
+        this->keyCache.setBlock(resId.SlotIndex, i, offset, fileClips[i].NumKeys);
+    }
+    return resId;
+}
+
+//------------------------------------------------------------------------------
+Id
+animMgr::createLibraryFromData(const Locator& locator, const uint8_t* data, int16_t* keyData) {
+    const auto* hdr = (const AnimLibraryFormat::Header*) data;
+    const int numCurves = hdr->NumClips * hdr->NumCurves;
+    int clipPoolIndex, curvePoolIndex, keyPoolIndex;
+    if (!this->allocLibraryRanges(hdr->NumClips, numCurves, 0, clipPoolIndex, curvePoolIndex, keyPoolIndex)) {
+        return Id::InvalidId();
+    }
+    const auto* fileClips = (const AnimLibraryFormat::Clip*) (data + hdr->ClipsOffset);
+    const auto* fileCurves = (const AnimLibraryFormat::Curve*) (data + hdr->CurvesOffset);
+
+    // create a new lib, clips and curves are copied, keys are used in
+    // place, or streamed in later if there is no key data
+    Id resId = this->libPool.AllocId();
+    AnimLibrary& lib = this->libPool.Assign(resId, ResourceState::Setup);
+    lib.Locator = locator;
+    lib.ExternalKeys = true;
+    lib.Streaming = (nullptr == keyData);
+    lib.KeysOptimized = true;
+    lib.StaticCurveTolerance = -1.0f;
+    for (uint32_t i = 0; i < hdr->NumCurves; i++) {
+        const auto fmt = (AnimCurveFormat::Enum) fileCurves[i].Format;
+        lib.CurveLayout.Add(fmt);
+        lib.SampleStride += AnimCurveFormat::Stride(fmt);
+    }
+    if (keyData) {
+        lib.Keys = Slice<int16_t>(keyData, hdr->NumKeys);
+    }
+    lib.ClipIndexMap.Reserve(hdr->NumClips);
+    for (uint32_t clipIndex = 0; clipIndex < hdr->NumClips; clipIndex++) {
+        const auto& fileClip = fileClips[clipIndex];
+        lib.ClipIndexMap.Add(StringAtom(fileClip.Name), clipIndex);
+        AnimClip& clip = this->clipPool[clipPoolIndex + clipIndex];
+        clip.Name = fileClip.Name;
+        clip.Length = fileClip.Length;
+        clip.KeyDuration = fileClip.KeyDuration;
+        clip.KeyStride = fileClip.KeyStride;
+        clip.VariableRate = 0 != (fileClip.Flags & AnimLibraryFormat::ClipVariableRate);
+        if (fileClip.NumKeys > 0) {
+            if (keyData) {
+                clip.Keys = lib.Keys.MakeSlice(fileClip.KeyIndex, fileClip.NumKeys);
+            }
+            else {
+                clip.Resident = false;
+            }
+        }
+        const int clipCurveIndex = curvePoolIndex + clipIndex * hdr->NumCurves;
+        for (uint32_t i = 0; i < hdr->NumCurves; i++) {
+            const auto& fileCurve = fileCurves[clipIndex * hdr->NumCurves + i];
+            AnimCurve& curve = this->curvePool[clipCurveIndex + i];
+            curve.Static = 0 != fileCurve.Static;
+            curve.Format = (AnimCurveFormat::Enum) fileCurve.Format;
+            curve.NumValues = AnimCurveFormat::Stride(curve.Format);
+            curve.KeyIndex = fileCurve.Static ? 0 : fileCurve.KeyIndex;
+            curve.KeyStride = fileCurve.Static ? 0 : fileCurve.KeyStride;
+            curve.NumKeys = fileCurve.Static ? 0 : fileCurve.NumKeys;
+            for (int j = 0; j < 4; j++) {
+                curve.StaticValue[j] = fileCurve.StaticValue[j];
+                curve.Magnitude[j] = fileCurve.Magnitude[j];
+                curve.Offset[j] = fileCurve.Offset[j];
+            }
+        }
+        clip.Curves = this->curvePool.MakeSlice(clipCurveIndex, hdr->NumCurves);
+    }
+    lib.Curves = this->curvePool.MakeSlice(curvePoolIndex, numCurves);
+    lib.Clips = this->clipPool.MakeSlice(clipPoolIndex, hdr->NumClips);
+    this->samplePlans[resId.SlotIndex].build(lib);
+
+    this->resContainer.registry.Add(locator, resId, this->resContainer.PeekLabel());
+    this->libPool.UpdateState(resId, ResourceState::Valid);
+    return resId;
+}
+
+//------------------------------------------------------------------------------
+bool
+animMgr::saveLibrary(const AnimLibrary* lib, Buffer& outData) {
+    o_assert_dbg(lib);
+    if (lib->Streaming) {
+        o_warn("Anim::SaveLibrary: can't save streamed library '%s'\n", lib->Locator.Location().AsCStr());
+        return false;
+    }
+    const int numClips = lib->Clips.Size();
+    const int numCurves = lib->CurveLayout.Size();
+    for (const AnimClip& clip : lib->Clips) {
+        if (clip.Name.Length() >= AnimLibraryFormat::MaxClipNameLength) {
+            o_warn("Anim::SaveLibrary: clip name '%s' is too long\n", clip.Name.AsCStr());
+            return false;
+        }
+    }
+
+    AnimLibraryFormat::Header hdr = { };
+    hdr.Magic = AnimLibraryFormat::Magic;
+    hdr.Version = AnimLibraryFormat::Version;
+    hdr.NumClips = numClips;
+    hdr.NumCurves = numCurves;
+    hdr.NumKeys = lib->Keys.Size();
+    hdr.ClipsOffset = alignFileOffset(sizeof(hdr));
+    hdr.CurvesOffset = alignFileOffset(hdr.ClipsOffset + numClips * sizeof(AnimLibraryFormat::Clip));
+    hdr.KeysOffset = alignFileOffset(hdr.CurvesOffset + numClips * numCurves * sizeof(AnimLibraryFormat::Curve));
+    hdr.FileSize = alignFileOffset(hdr.KeysOffset + hdr.NumKeys * sizeof(int16_t));
+
+    // a library appended to a non-empty buffer starts at the next aligned
+    // buffer offset, FileSize and the offsets in the header are relative
+    // to the start of the library
+    const int numPadding = int(alignFileOffset(uint32_t(outData.Size()))) - outData.Size();
+    if (numPadding > 0) {
+        Memory::Clear(outData.Add(numPadding), numPadding);
+    }
+    uint8_t* dst = outData.Add(hdr.FileSize);
+    Memory::Clear(dst, hdr.FileSize);
+    Memory::Copy(&hdr, dst, sizeof(hdr));
+
+    auto* fileClips = (AnimLibraryFormat::Clip*) (dst + hdr.ClipsOffset);
+    auto* fileCurves = (AnimLibraryFormat::Curve*) (dst + hdr.CurvesOffset);
+    for (int clipIndex = 0; clipIndex < numClips; clipIndex++) {
+        const AnimClip& clip = lib->Clips[clipIndex];
+        auto& fileClip = fileClips[clipIndex];
+        Memory::Copy(clip.Name.AsCStr(), fileClip.Name, clip.Name.Length());
+        fileClip.Length = clip.Length;
+        fileClip.KeyDuration = clip.KeyDuration;
+        fileClip.KeyStride = clip.KeyStride;
+        fileClip.KeyIndex = clip.Keys.Empty() ? 0 : clip.Keys.Offset() - lib->Keys.Offset();
+        fileClip.NumKeys = clip.Keys.Size();
+        fileClip.Flags = clip.VariableRate ? AnimLibraryFormat::ClipVariableRate : 0;
+        for (int i = 0; i < numCurves; i++) {
+            const AnimCurve& curve = clip.Curves[i];
+            auto& fileCurve = fileCurves[clipIndex * numCurves + i];
+            fileCurve.Format = curve.Format;
+            fileCurve.Static = curve.Static ? 1 : 0;
+            fileCurve.KeyIndex = curve.KeyIndex;
+            fileCurve.KeyStride = curve.KeyStride;
+            fileCurve.NumKeys = curve.NumKeys;
+            for (int j = 0; j < 4; j++) {
+                fileCurve.StaticValue[j] = curve.StaticValue[j];
+                fileCurve.Magnitude[j] = curve.Magnitude[j];
+                fileCurve.Offset[j] = curve.Offset[j];
+            }
+        }
+    }
+    if (hdr.NumKeys > 0) {
+        Memory::Copy(lib->Keys.begin(), dst + hdr.KeysOffset, hdr.NumKeys * sizeof(int16_t));
+    }
+    return true;
+}
+
 //------------------------------------------------------------------------------
 AnimLibrary*
 animMgr::lookupLibrary(const Id& resId) {
@@ -225,7 +684,13 @@ animMgr::destroyLibrary(const Id& id) {
     if (lib) {
         this->removeClips(lib->Clips);
         this->removeCurves(lib->Curves);
-        this->removeKeys(lib->Keys);
+        if (!lib->ExternalKeys) {
+            this->removeKeys(lib->Keys);
+        }
+        if (lib->Streaming) {
+            this->keyCache.removeLibrary(id.SlotIndex);
+        }
+        this->samplePlans[id.SlotIndex].clear();
         lib->clear();
     }
     this->libPool.Unassign(id);
@@ -246,8 +711,9 @@ animMgr::createSkeleton(const AnimSkeletonSetup& setup) {
     }
     
     // check if resource limits are reached
-    if ((this->matrixPool.Size() + setup.Bones.Size()*2) > this->matrixPool.Capacity()) {
-        o_warn("Anim: matrix pool exhausted!\n");
+    const int matrixPoolIndex = this->matrixAllocator.alloc(setup.Bones.Size() * 2);
+    if (InvalidIndex == matrixPoolIndex) {
+        this->warnAllocFailed("matrix", this->matrixAllocator, setup.Bones.Size() * 2);
         return Id::InvalidId();
     }
     
@@ -256,19 +722,26 @@ animMgr::createSkeleton(const AnimSkeletonSetup& setup) {
     AnimSkeleton& skel = this->skelPool.Assign(resId, ResourceState::Setup);
     skel.Locator = setup.Locator;
     skel.NumBones = setup.Bones.Size();
-    const int matrixPoolIndex = this->matrixPool.Size();
-    for (const auto& bone : setup.Bones) {
-        this->matrixPool.Add(glm::mat4x3(bone.BindPose));
-    }
-    for (const auto& bone : setup.Bones) {
-        this->matrixPool.Add(glm::mat4x3(bone.InvBindPose));
+    skel.SkinFormat = setup.SkinFormat == AnimSkinFormat::Default ? this->animSetup.SkinFormat : setup.SkinFormat;
+    o_assert_dbg(AnimSkinFormat::NumPixels(skel.SkinFormat) > 0);
+    for (int i = 0; i < skel.NumBones; i++) {
+        this->matrixPool[matrixPoolIndex + i] = glm::mat4x3(setup.Bones[i].BindPose);
+        this->matrixPool[matrixPoolIndex + skel.NumBones + i] = glm::mat4x3(setup.Bones[i].InvBindPose);
     }
     skel.Matrices = this->matrixPool.MakeSlice(matrixPoolIndex, skel.NumBones * 2);
     skel.BindPose = skel.Matrices.MakeSlice(0, skel.NumBones);
     skel.InvBindPose = skel.Matrices.MakeSlice(skel.NumBones, skel.NumBones);
     for (int i = 0; i < skel.NumBones; i++) {
+        // parents must come before their children, so that each bone LOD is a closed hierarchy
+        o_assert_dbg(setup.Bones[i].ParentIndex < i);
         skel.ParentIndices[i] = setup.Bones[i].ParentIndex;
     }
+    skel.NumLods = 1 + setup.LodNumBones.Size();
+    skel.LodNumBones[0] = skel.NumBones;
+    for (int i = 0; i < setup.LodNumBones.Size(); i++) {
+        o_assert_dbg((setup.LodNumBones[i] > 0) && (setup.LodNumBones[i] <= skel.LodNumBones[i]));
+        skel.LodNumBones[i + 1] = setup.LodNumBones[i];
+    }
 
     // register the new resource, and done
     this->resContainer.registry.Add(setup.Locator, resId, this->resContainer.PeekLabel());
@@ -295,6 +768,186 @@ animMgr::destroySkeleton(const Id& id) {
     this->skelPool.Unassign(id);
 }
 
+//------------------------------------------------------------------------------
+Id
+animMgr::createBake(const AnimBakeSetup& setup) {
+    o_assert_dbg(this->isValid);
+    o_assert_dbg(setup.Locator.HasValidLocation());
+    o_assert_dbg(setup.Library.IsValid() && setup.Skeleton.IsValid());
+
+    // check if bake already exists
+    Id resId = this->resContainer.registry.Lookup(setup.Locator);
+    if (resId.IsValid()) {
+        o_assert_dbg(resId.Type == resTypeBake);
+        return resId;
+    }
+    AnimLibrary* lib = this->lookupLibrary(setup.Library);
+    AnimSkeleton* skel = this->lookupSkeleton(setup.Skeleton);
+    o_assert_dbg(lib && skel);
+    o_assert_dbg((skel->NumBones * 10) <= lib->SampleStride);
+    if (lib->Streaming) {
+        o_warn("Anim::Create: can't bake clips of streamed library '%s'\n", lib->Locator.Location().AsCStr());
+        return Id::InvalidId();
+    }
+
+    // create new bake and compute its layout
+    resId = this->bakePool.AllocId();
+    AnimBake& bake = this->bakePool.Assign(resId, ResourceState::Setup);
+    bake.Locator = setup.Locator;
+    bake.NumBones = skel->NumBones;
+    bake.SkinFormat = skel->SkinFormat;
+    const int numClips = setup.Clips.Empty() ? lib->Clips.Size() : setup.Clips.Size();
+    bake.Clips.Reserve(numClips);
+    for (int i = 0; i < numClips; i++) {
+        const int clipIndex = setup.Clips.Empty() ? i : setup.Clips[i];
+        const AnimClip& clip = lib->Clips[clipIndex];
+        AnimBake::Clip& bakeClip = bake.Clips.Add();
+        bakeClip.ClipIndex = clipIndex;
+        bakeClip.FirstFrame = bake.NumFrames;
+        bakeClip.NumFrames = clip.Length > 0 ? clip.Length : 1;
+        bakeClip.FrameDuration = clip.KeyDuration;
+        bake.NumFrames += bakeClip.NumFrames;
+    }
+    const int rowSize = bake.NumBones * AnimSkinFormat::NumFloats(bake.SkinFormat);
+    const int numFloats = bake.NumFrames * rowSize;
+    float* matrices = (float*) Memory::Alloc(numFloats * sizeof(float));
+    bake.Matrices = Slice<float>(matrices, numFloats, 0, numFloats);
+
+    // run every frame through the regular evaluation on a
+    // temporary instance which plays only the baked clip
+    const int numSamples = lib->SampleStride;
+    float* samples = (float*) Memory::Alloc(numSamples * sizeof(float));
+    Memory::Clear(samples, numSamples * sizeof(float));
+    const animSamplePlan* plan = &this->samplePlans[lib->Id.SlotIndex];
+    animInstance tmp;
+    tmp.library = lib;
+    tmp.skeleton = skel;
+    tmp.samples = Slice<float>(samples, numSamples, 0, numSamples);
+    for (const auto& bakeClip : bake.Clips) {
+        AnimJob job;
+        job.ClipIndex = bakeClip.ClipIndex;
+        tmp.sequencer.items.Clear();
+        tmp.sequencer.add(0.0, 1, job, bakeClip.NumFrames * bakeClip.FrameDuration);
+        for (int frame = 0; frame < bakeClip.NumFrames; frame++) {
+            tmp.sequencer.eval(lib, plan, frame * bakeClip.FrameDuration, samples, numSamples);
+            tmp.skinMatrices = bake.Matrices.MakeSlice((bakeClip.FirstFrame + frame) * rowSize, rowSize);
+            this->genSkinMatrices(&tmp);
+        }
+    }
+    Memory::Free(samples);
+    tmp.clear();
+
+    // register the new resource, and done
+    this->resContainer.registry.Add(setup.Locator, resId, this->resContainer.PeekLabel());
+    this->bakePool.UpdateState(resId, ResourceState::Valid);
+    return resId;
+}
+
+//------------------------------------------------------------------------------
+AnimBake*
+animMgr::lookupBake(const Id& resId) {
+    o_assert_dbg(this->isValid);
+    o_assert_dbg(resId.Type == resTypeBake);
+    return this->bakePool.Lookup(resId);
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::destroyBake(const Id& id) {
+    AnimBake* bake = this->bakePool.Lookup(id);
+    if (bake) {
+        if (!bake->Matrices.Empty()) {
+            Memory::Free(bake->Matrices.begin());
+        }
+        bake->clear();
+    }
+    this->bakePool.Unassign(id);
+}
+
+//------------------------------------------------------------------------------
+Id
+animMgr::createMask(const AnimMaskSetup& setup) {
+    o_assert_dbg(this->isValid);
+    o_assert_dbg(setup.Locator.HasValidLocation());
+    o_assert_dbg(setup.Library.IsValid());
+
+    // check if mask already exists
+    Id resId = this->resContainer.registry.Lookup(setup.Locator);
+    if (resId.IsValid()) {
+        o_assert_dbg(resId.Type == resTypeMask);
+        return resId;
+    }
+    const AnimLibrary* lib = this->lookupLibrary(setup.Library);
+    o_assert_dbg(lib);
+
+    // create new mask
+    resId = this->maskPool.AllocId();
+    AnimMask& mask = this->maskPool.Assign(resId, ResourceState::Setup);
+    mask.Locator = setup.Locator;
+    mask.SampleStride = lib->SampleStride;
+
+    // convert the enabled curves into sample lane ranges
+    const int numCurves = lib->CurveLayout.Size();
+    StaticArray<bool, AnimConfig::MaxNumCurvesInClip> enabled;
+    o_assert_dbg(numCurves <= enabled.Size());
+    enabled.Fill(false);
+    for (int curveIndex : setup.Curves) {
+        o_assert_dbg((curveIndex >= 0) && (curveIndex < numCurves));
+        enabled[curveIndex] = true;
+    }
+    int laneIndex = 0;
+    for (int curveIndex = 0; curveIndex < numCurves; curveIndex++) {
+        const int numLanes = AnimCurveFormat::Stride(lib->CurveLayout[curveIndex]);
+        if (enabled[curveIndex]) {
+            if (!mask.Ranges.Empty() && ((mask.Ranges.Back().First + mask.Ranges.Back().Num) == laneIndex)) {
+                mask.Ranges.Back().Num += numLanes;
+            }
+            else {
+                AnimMask::Range& range = mask.Ranges.Add();
+                range.First = laneIndex;
+                range.Num = numLanes;
+            }
+        }
+        laneIndex += numLanes;
+    }
+    o_assert_dbg(laneIndex == lib->SampleStride);
+
+    // register the new resource, and done
+    this->resContainer.registry.Add(setup.Locator, resId, this->resContainer.PeekLabel());
+    this->maskPool.UpdateState(resId, ResourceState::Valid);
+    return resId;
+}
+
+//------------------------------------------------------------------------------
+AnimMask*
+animMgr::lookupMask(const Id& resId) {
+    o_assert_dbg(this->isValid);
+    o_assert_dbg(resId.Type == resTypeMask);
+    return this->maskPool.Lookup(resId);
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::destroyMask(const Id& id) {
+    AnimMask* mask = this->maskPool.Lookup(id);
+    if (mask) {
+        // queued anim jobs which still use the mask continue unmasked,
+        // so that a new mask in the same slot doesn't apply to them
+        for (Id::SlotIndexT slotIndex = 0; slotIndex <= this->instPool.LastAllocSlot; slotIndex++) {
+            animInstance& inst = this->instPool.slots[slotIndex];
+            if (inst.Id.IsValid()) {
+                for (auto& item : inst.sequencer.items) {
+                    if (item.mask == mask) {
+                        item.mask = nullptr;
+                    }
+                }
+            }
+        }
+        mask->clear();
+    }
+    this->maskPool.Unassign(id);
+}
+
 //------------------------------------------------------------------------------
 Id
 animMgr::createInstance(const AnimInstanceSetup& setup) {
@@ -310,6 +963,14 @@ animMgr::createInstance(const AnimInstanceSetup& setup) {
         o_assert_dbg(inst.skeleton);
     }
     this->resContainer.registry.Add(Locator::NonShared(), resId, this->resContainer.PeekLabel());
+    o_assert_dbg((setup.UpdateInterval > 0) && (setup.UpdateInterval <= AnimConfig::MaxUpdateInterval));
+    o_assert_dbg(0 == (setup.UpdateInterval & (setup.UpdateInterval - 1)));
+    inst.updateInterval = setup.UpdateInterval;
+    inst.interpolate = setup.InterpolateUpdates;
+    o_assert_dbg(!setup.HalfFloatSamples || inst.skeleton);
+    inst.halfSamples = setup.HalfFloatSamples;
+    o_assert_dbg(!setup.SkinMatricesOnly || inst.skeleton);
+    inst.skinOnly = setup.SkinMatricesOnly;
     this->instPool.UpdateState(resId, ResourceState::Valid);
     return resId;
 }
@@ -327,6 +988,17 @@ void
 animMgr::destroyInstance(const Id& id) {
     animInstance* inst = this->instPool.Lookup(id);
     if (inst) {
+        if (inst->sequencer.keyCursors) {
+            Memory::Free(inst->sequencer.keyCursors);
+            inst->sequencer.keyCursors = nullptr;
+            inst->sequencer.numCursorCurves = 0;
+        }
+        // also frees the pose history
+        this->assignUpdatePhase(inst, 1);
+        if (InvalidIndex != inst->sampleOffset) {
+            this->freeSlots(inst);
+            this->slotInstances.EraseSwap(this->slotInstances.FindIndexLinear(inst));
+        }
         inst->clear();
     }
     this->instPool.Unassign(id);
@@ -335,79 +1007,49 @@ animMgr::destroyInstance(const Id& id) {
 //------------------------------------------------------------------------------
 void
 animMgr::removeKeys(Slice<int16_t> range) {
+    ORYOL_ANIM_ZONE("Anim::removeKeys");
     o_assert_dbg(this->keyPool);
-    if (range.Empty()) {
-        return;
-    }
-    const int numKeysToMove = this->numKeys - (range.Offset() + range.Size());
-    if (numKeysToMove > 0) {
-        Memory::Move(range.end(), (void*)range.begin(), numKeysToMove * sizeof(float)); 
-    }
-    this->numKeys -= range.Size();
-    o_assert_dbg(this->numKeys >= 0);
-
-    // fix the key array views in libs and clips
-    for (Id::SlotIndexT slotIndex = 0; slotIndex <= this->libPool.LastAllocSlot; slotIndex++) {
-        AnimLibrary& lib = this->libPool.slots[slotIndex];
-        if (lib.Id.IsValid()) {
-            lib.Keys.FillGap(range.Offset(), range.Size());
-        }
-    }
-    for (auto& clip : this->clipPool) {
-        clip.Keys.FillGap(range.Offset(), range.Size());
-    }
+    this->keyAllocator.free(range.Offset(), range.Size());
 }
 
 //------------------------------------------------------------------------------
 void
 animMgr::removeCurves(Slice<AnimCurve> range) {
-    this->curvePool.EraseRange(range.Offset(), range.Size()); 
-
-    // fix the curve array views in libs and clips
-    for (Id::SlotIndexT slotIndex = 0; slotIndex <= this->libPool.LastAllocSlot; slotIndex++) {
-        AnimLibrary& lib = this->libPool.slots[slotIndex];
-        if (lib.Id.IsValid()) {
-            lib.Curves.FillGap(range.Offset(), range.Size());
-        }
-    }
-    for (auto& clip : this->clipPool) {
-        clip.Curves.FillGap(range.Offset(), range.Size());
+    ORYOL_ANIM_ZONE("Anim::removeCurves");
+    for (AnimCurve& curve : range) {
+        curve = AnimCurve();
     }
+    this->curveAllocator.free(range.Offset(), range.Size());
 }
 
 //------------------------------------------------------------------------------
 void
 animMgr::removeClips(Slice<AnimClip> range) {
-    this->clipPool.EraseRange(range.Offset(), range.Size());
-
-    // fix the clip array views in libs
-    for (Id::SlotIndexT slotIndex = 0; slotIndex <= this->libPool.LastAllocSlot; slotIndex++) {
-        AnimLibrary& lib = this->libPool.slots[slotIndex];
-        if (lib.Id.IsValid()) {
-            lib.Clips.FillGap(range.Offset(), range.Size());
-        }
+    for (AnimClip& clip : range) {
+        clip = AnimClip();
     }
+    this->clipAllocator.free(range.Offset(), range.Size());
 }
 
 //------------------------------------------------------------------------------
 void
 animMgr::removeMatrices(Slice<glm::mat4x3> range) {
-    this->matrixPool.EraseRange(range.Offset(), range.Size());
-
-    // fix the skeleton matrix slices
-    for (Id::SlotIndexT slotIndex = 0; slotIndex <= this->skelPool.LastAllocSlot; slotIndex++) {
-        AnimSkeleton& skel = this->skelPool.slots[slotIndex];
-        if (skel.Id.IsValid()) {
-            skel.BindPose.FillGap(range.Offset(), range.Size());
-            skel.InvBindPose.FillGap(range.Offset(), range.Size());
-        }
-    }
+    this->matrixAllocator.free(range.Offset(), range.Size());
 }
 
 //------------------------------------------------------------------------------
 void
 animMgr::writeKeys(AnimLibrary* lib, const uint8_t* ptr, int numBytes) {
+    ORYOL_ANIM_ZONE("Anim::writeKeys");
     o_assert_dbg(lib && ptr && numBytes > 0);
+    if (lib->ExternalKeys) {
+        o_warn("Anim::WriteKeys: keys of library '%s' are read-only\n", lib->Locator.Location().AsCStr());
+        return;
+    }
+    if (lib->KeysOptimized) {
+        o_warn("Anim::WriteKeys: keys of library '%s' have already been optimized\n", lib->Locator.Location().AsCStr());
+        return;
+    }
     // if more bytes are incoming that are needed, just silently clamp
     // the size, this may happen because of alignment padding
     const int keyDataSize = lib->Keys.Size() * sizeof(int16_t);
@@ -415,108 +1057,1397 @@ animMgr::writeKeys(AnimLibrary* lib, const uint8_t* ptr, int numBytes) {
         numBytes = keyDataSize;
     }
     Memory::Copy(ptr, lib->Keys.begin(), numBytes);
-}
-
-//------------------------------------------------------------------------------
-void
-animMgr::newFrame() {
-    o_assert_dbg(!this->inFrame);
-    for (animInstance* inst : this->activeInstances) {
-        inst->samples.Reset();
-        inst->skinMatrices.Reset();
+    this->keysVersion++;
+    if (lib->StaticCurveTolerance >= 0.0f) {
+        lib->KeysOptimized |= this->detectStaticCurves(lib);
+    }
+    if (lib->KeyReductionTolerance > 0.0f) {
+        this->reduceKeys(lib);
+        lib->KeysOptimized = true;
+    }
+    if (lib->KeysOptimized) {
+        this->compactKeys(lib);
+        this->samplePlans[lib->Id.SlotIndex].build(*lib);
     }
-    this->activeInstances.Clear();
-    this->numSamples = 0;
-    this->curSkinMatrixTableX = 0;
-    this->curSkinMatrixTableY = 0;
-    this->inFrame = true;
-    this->skinMatrixInfo.SkinMatrixTableByteSize = 0;
-    this->skinMatrixInfo.InstanceInfos.Clear();
 }
 
 //------------------------------------------------------------------------------
 bool
-animMgr::addActiveInstance(animInstance* inst) {
-    o_assert_dbg(inst && inst->library);
+animMgr::detectStaticCurves(AnimLibrary* lib) {
+    o_assert_dbg(lib);
+    bool anyStatic = false;
+    for (AnimClip& clip : lib->Clips) {
+        if (clip.Keys.Empty()) {
+            continue;
+        }
+
+        // a curve is static if the range of each value is within
+        // twice the tolerance, the static value is the center of the range
+        bool clipChanged = false;
+        for (AnimCurve& curve : clip.Curves) {
+            if (curve.Static) {
+                continue;
+            }
+            float minVal[4], maxVal[4], v[4];
+            animSampler::decode(curve, &(clip.Keys[curve.KeyIndex]), minVal);
+            for (int i = 0; i < curve.NumValues; i++) {
+                maxVal[i] = minVal[i];
+            }
+            bool isConstant = true;
+            for (int k = 1; isConstant && (k < clip.Length); k++) {
+                animSampler::decode(curve, &(clip.Keys[k * clip.KeyStride + curve.KeyIndex]), v);
+                for (int i = 0; i < curve.NumValues; i++) {
+                    minVal[i] = v[i] < minVal[i] ? v[i] : minVal[i];
+                    maxVal[i] = v[i] > maxVal[i] ? v[i] : maxVal[i];
+                    if ((maxVal[i] - minVal[i]) > (2.0f * lib->StaticCurveTolerance)) {
+                        isConstant = false;
+                    }
+                }
+            }
+            if (isConstant) {
+                for (int i = 0; i < curve.NumValues; i++) {
+                    curve.StaticValue[i] = (minVal[i] == maxVal[i]) ? minVal[i] : (minVal[i] + maxVal[i]) * 0.5f;
+                }
+                curve.Static = true;
+                clipChanged = true;
+            }
+        }
+        if (!clipChanged) {
+            continue;
+        }
+        anyStatic = true;
+
+        // repack the key rows with the remaining keyed curves, the new
+        // row stride is smaller, so this can be done in place front to back
+        int keyStride = 0;
+        for (const AnimCurve& curve : clip.Curves) {
+            if (!curve.Static) {
+                keyStride += curve.KeyStride;
+            }
+        }
+        for (int row = 0; row < clip.Length; row++) {
+            int dst = row * keyStride;
+            for (const AnimCurve& curve : clip.Curves) {
+                if (!curve.Static) {
+                    const int src = row * clip.KeyStride + curve.KeyIndex;
+                    for (int i = 0; i < curve.KeyStride; i++) {
+                        clip.Keys[dst++] = clip.Keys[src + i];
+                    }
+                }
+            }
+        }
+        keyStride = 0;
+        for (AnimCurve& curve : clip.Curves) {
+            if (curve.Static) {
+                curve.KeyIndex = 0;
+                curve.KeyStride = 0;
+            }
+            else {
+                curve.KeyIndex = keyStride;
+                keyStride += curve.KeyStride;
+            }
+        }
+        clip.KeyStride = keyStride;
+        if (keyStride > 0) {
+            clip.Keys = clip.Keys.MakeSlice(0, keyStride * clip.Length);
+        }
+        else {
+            clip.Keys.Reset();
+        }
+    }
+    return anyStatic;
+}
+
+//------------------------------------------------------------------------------
+static bool
+segmentFits(const int16_t* rows, int rowStride, const AnimCurve& curve, int k0, int k1, float tolerance) {
+    // check if all keys between k0 and k1 can be linearly interpolated
+    // from k0 and k1 with an error below tolerance
+    float v0[4], v1[4], v[4];
+    animSampler::decodePair(curve, rows + k0 * rowStride + curve.KeyIndex, rows + k1 * rowStride + curve.KeyIndex, v0, v1);
+    for (int k = k0 + 1; k < k1; k++) {
+        animSampler::decode(curve, rows + k * rowStride + curve.KeyIndex, v);
+        const float t = float(k - k0) / float(k1 - k0);
+        for (int i = 0; i < curve.NumValues; i++) {
+            const float err = (v0[i] + (v1[i] - v0[i]) * t) - v[i];
+            if ((err > tolerance) || (err < -tolerance)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::reduceKeys(AnimLibrary* lib) {
+    o_assert_dbg(lib);
+    Array<int16_t> rows;
+    Array<int16_t> frames;
+    Array<int> numFrames;
+    for (AnimClip& clip : lib->Clips) {
+        if (clip.VariableRate || clip.Keys.Empty() || (clip.Length < 3)) {
+            continue;
+        }
+
+        // find the frames to keep for each keyed curve, the first
+        // and last frame are always kept
+        rows.Clear();
+        rows.Reserve(clip.Keys.Size());
+        for (int16_t key : clip.Keys) {
+            rows.Add(key);
+        }
+        frames.Clear();
+        numFrames.Clear();
+        int variableSize = 0;
+        for (const AnimCurve& curve : clip.Curves) {
+            if (curve.Static) {
+                continue;
+            }
+            const int first = frames.Size();
+            frames.Add(0);
+            int k0 = 0;
+            for (int k1 = 2; k1 < clip.Length; k1++) {
+                if (!segmentFits(rows.begin(), clip.KeyStride, curve, k0, k1, lib->KeyReductionTolerance)) {
+                    k0 = k1 - 1;
+                    frames.Add(int16_t(k0));
+                }
+            }
+            frames.Add(int16_t(clip.Length - 1));
+            const int num = frames.Size() - first;
+            numFrames.Add(num);
+            variableSize += num * (1 + curve.KeyStride);
+        }
+        if (variableSize >= clip.Keys.Size()) {
+            // the frame indices would eat up the savings
+            continue;
+        }
+
+        // write the key columns of variable-rate curves:
+        // NumKeys frame indices followed by NumKeys keys
+        int keyIndex = 0;
+        int frameIndex = 0;
+        int curveIndex = 0;
+        for (AnimCurve& curve : clip.Curves) {
+            if (curve.Static) {
+                continue;
+            }
+            const int rowOffset = curve.KeyIndex;
+            const int num = numFrames[curveIndex++];
+            curve.KeyIndex = keyIndex;
+            curve.NumKeys = num;
+            for (int i = 0; i < num; i++) {
+                clip.Keys[keyIndex++] = frames[frameIndex + i];
+            }
+            for (int i = 0; i < num; i++) {
+                const int16_t* src = &rows[frames[frameIndex + i] * clip.KeyStride + rowOffset];
+                for (int j = 0; j < curve.KeyStride; j++) {
+                    clip.Keys[keyIndex++] = src[j];
+                }
+            }
+            frameIndex += num;
+        }
+        o_assert_dbg(keyIndex == variableSize);
+        clip.Keys = clip.Keys.MakeSlice(0, variableSize);
+        clip.VariableRate = true;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::compactKeys(AnimLibrary* lib) {
+    o_assert_dbg(lib);
+    // move the clip key blocks to the start of the library's key range,
+    // clips are in key pool order, so this always moves keys down
+    const int libKeyIndex = lib->Keys.Offset();
+    int keyIndex = libKeyIndex;
+    for (AnimClip& clip : lib->Clips) {
+        if (clip.Keys.Empty()) {
+            continue;
+        }
+        const int num = clip.Keys.Size();
+        if (clip.Keys.Offset() != keyIndex) {
+            o_assert_dbg(clip.Keys.Offset() > keyIndex);
+            Memory::Move(clip.Keys.begin(), &(this->keys[keyIndex]), num * sizeof(int16_t));
+        }
+        clip.Keys = this->keys.MakeSlice(keyIndex, num);
+        keyIndex += num;
+    }
+
+    // give the unused tail back to the key pool
+    const int numUnused = (libKeyIndex + lib->Keys.Size()) - keyIndex;
+    if (numUnused > 0) {
+        lib->Keys = this->keys.MakeSlice(libKeyIndex, keyIndex - libKeyIndex);
+        this->removeKeys(this->keys.MakeSlice(keyIndex, numUnused));
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::newFrame() {
+    o_assert_dbg(!this->inFrame);
+    this->updateStreaming();
+    for (animInstance* inst : this->activeInstances) {
+        inst->samples.Reset();
+        inst->skinMatrices.Reset();
+    }
+    this->activeInstances.Clear();
+    // instances keep their slots while they are active in consecutive frames
+    this->releaseSlots(this->frameIndex);
+
+    // switch to the next output buffer which isn't acquired, the output
+    // of the previous frame stays intact for copying unchanged poses
+    const int numOutputs = this->outputs.Size();
+    int nextOutput = InvalidIndex;
+    for (int i = 1; i <= numOutputs; i++) {
+        const int outputIndex = (this->curOutput + i) % numOutputs;
+        if (0 == this->outputs[outputIndex].numAcquired) {
+            nextOutput = outputIndex;
+            break;
+        }
+    }
+    if (InvalidIndex == nextOutput) {
+        o_warn("Anim::NewFrame: all output buffers are acquired, overwriting the oldest!\n");
+        nextOutput = (this->curOutput + 1) % numOutputs;
+    }
+    this->prevOutput = this->curOutput;
+    this->selectOutput(nextOutput);
+    this->numEvaluatedInstances = 0;
+    this->numPoseCacheHits = 0;
+    this->numPoseCacheMisses = 0;
+    this->numUnchangedInstances = 0;
+    #if ORYOL_ANIM_FRAME_STATS
+    // reset the per-frame statistics, but keep the high-water marks
+    AnimFrameStats stats;
+    stats.MaxActiveInstances = this->frameStats.MaxActiveInstances;
+    stats.MaxSamples = this->frameStats.MaxSamples;
+    stats.MaxSkinMatrixPixels = this->frameStats.MaxSkinMatrixPixels;
+    stats.MaxKeys = this->frameStats.MaxKeys;
+    stats.MaxCurves = this->frameStats.MaxCurves;
+    stats.MaxClips = this->frameStats.MaxClips;
+    stats.NumFragmentedPoolFailures = this->frameStats.NumFragmentedPoolFailures;
+    this->frameStats = stats;
+    #endif
+    this->frameIndex++;
+    this->inFrame = true;
+    this->skinMatrixInfo->InstanceInfos.Clear();
+    for (AnimSkinMatrixInfo::Page& page : this->skinMatrixInfo->Pages) {
+        page.SkinMatrixTableByteSize = 0;
+        page.DirtyRows.Clear();
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::selectOutput(int outputIndex) {
+    const int samplePoolCapacity = this->animSetup.SamplePoolCapacity;
+    this->curOutput = outputIndex;
+    this->samples = Slice<float>(this->samplePool + outputIndex * samplePoolCapacity, samplePoolCapacity);
+    this->skinMatrixInfo = &this->outputs[outputIndex].skinMatrixInfo;
+}
+
+//------------------------------------------------------------------------------
+int
+animMgr::acquireOutput() {
+    if (InvalidIndex != this->readyOutput) {
+        this->outputs[this->readyOutput].numAcquired++;
+    }
+    return this->readyOutput;
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::releaseOutput(int outputIndex) {
+    o_assert_dbg(this->outputs[outputIndex].numAcquired > 0);
+    this->outputs[outputIndex].numAcquired--;
+}
+
+//------------------------------------------------------------------------------
+static bool
+isClipReferenced(void* userData, int libSlot, int clipIndex) {
+    // check if any current or future anim job of any instance still
+    // references a clip (stopped jobs linger until garbage collection)
+    const animMgr* self = (const animMgr*) userData;
+    for (Id::SlotIndexT slotIndex = 0; slotIndex <= self->instPool.LastAllocSlot; slotIndex++) {
+        const animInstance& inst = self->instPool.slots[slotIndex];
+        if (inst.Id.IsValid() && inst.library && (inst.library->Id.SlotIndex == libSlot)) {
+            for (const auto& item : inst.sequencer.items) {
+                if ((item.clipIndex == clipIndex) && item.valid && (item.absEndTime > self->curTime)) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::updateStreaming() {
+    // load and evict streamed key blocks, and fix up the clip key views
+    this->keyCache.update(isClipReferenced, this);
+    for (const auto& ref : this->keyCache.changed) {
+        AnimLibrary& lib = this->libPool.slots[ref.libSlot];
+        o_assert_dbg(lib.Id.IsValid() && lib.Streaming);
+        AnimClip& clip = lib.Clips[ref.clipIndex];
+        int16_t* keys = this->keyCache.keys(ref.libSlot, ref.clipIndex);
+        if (keys) {
+            const int numKeys = this->keyCache.libs[ref.libSlot].blocks[ref.clipIndex].numKeys;
+            clip.Keys = Slice<int16_t>(keys, numKeys);
+            clip.Resident = true;
+        }
+        else {
+            clip.Keys.Reset();
+            clip.Resident = false;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+static int
+numFullSamples(int numSamples) {
+    return numSamples < AnimConfig::NumFullPrecisionSamples ? numSamples : AnimConfig::NumFullPrecisionSamples;
+}
+
+//------------------------------------------------------------------------------
+static int
+sampleSlotSize(const animInstance* inst) {
+    // half-float samples keep the root bone in full precision, and
+    // pack 2 half-floats into each float of the sample pool
+    const int numSamples = inst->library->SampleStride;
+    if (inst->halfSamples) {
+        const int numFull = numFullSamples(numSamples);
+        return numFull + (numSamples - numFull + 1) / 2;
+    }
+    else {
+        return numSamples;
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+packSamples(const float* src, float* dst, int numSamples) {
+    const int numFull = numFullSamples(numSamples);
+    const int numHalf = numSamples - numFull;
+    Memory::Copy(src, dst, numFull * sizeof(float));
+    uint16_t* halfDst = (uint16_t*) (dst + numFull);
+    animFloatToHalf(src + numFull, halfDst, numHalf);
+    if (numHalf & 1) {
+        halfDst[numHalf] = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+unpackSamples(const float* src, float* dst, int numSamples) {
+    const int numFull = numFullSamples(numSamples);
+    Memory::Copy(src, dst, numFull * sizeof(float));
+    animHalfToFloat((const uint16_t*) (src + numFull), dst + numFull, numSamples - numFull);
+}
+
+//------------------------------------------------------------------------------
+bool
+animMgr::addActiveInstance(animInstance* inst, int updateInterval) {
+    o_assert_dbg(inst && inst->library);
     o_assert_dbg(this->inFrame);
     
     // check if resource limits are reached for this frame
     if (this->activeInstances.Size() == this->activeInstances.Capacity()) {
         // MaxNumActiveInstances reached
+        #if ORYOL_ANIM_FRAME_STATS
+        this->frameStats.NumRejectedActiveLimit++;
+        #endif
         return false;
     }
-    if ((this->numSamples + inst->library->SampleStride) > this->samples.Size()) {
+    if (InvalidIndex == inst->sampleOffset) {
+        // the instance wasn't active in the previous frame and needs new
+        // slots, if the sample pool or skin matrix table is full, try
+        // again after releasing the slots of instances which were active
+        // in the previous frame but haven't been added yet in this frame
+        bool skinTableFull = false;
+        if (!this->allocSlots(inst, skinTableFull)) {
+            this->releaseSlots(this->frameIndex);
+            if (!this->allocSlots(inst, skinTableFull)) {
+                #if ORYOL_ANIM_FRAME_STATS
+                if (skinTableFull) {
+                    this->frameStats.NumRejectedSkinMatrixTable++;
+                }
+                else {
+                    this->frameStats.NumRejectedSamplePool++;
+                }
+                #endif
+                return false;
+            }
+        }
+        this->slotInstances.Add(inst);
+    }
+    this->activeInstances.Add(inst);
+    inst->poseUnchanged = false;
+    inst->poseShared = false;
+
+    // update-rate LOD: decide whether the instance is evaluated in this
+    // frame, an instance which wasn't active in the previous frame has
+    // no usable pose history and is always evaluated
+    const int interval = updateInterval > 0 ? updateInterval : inst->updateInterval;
+    o_assert_dbg((interval <= AnimConfig::MaxUpdateInterval) && (0 == (interval & (interval - 1))));
+    if (interval != inst->lodInterval) {
+        this->assignUpdatePhase(inst, interval);
+    }
+    if ((interval == 1) || ((inst->lastActiveFrame + 1) != this->frameIndex)) {
+        inst->numHistory = 0;
+    }
+    if ((interval > 1) && !inst->history) {
+        const int numFloats = inst->library->SampleStride + (inst->skeleton ? inst->skeleton->NumBones * AnimSkinFormat::NumFloats(inst->skeleton->SkinFormat) : 0);
+        inst->history = (float*) Memory::Alloc(2 * numFloats * sizeof(float));
+    }
+    inst->lodEval = (0 == inst->numHistory) || ((int(this->frameIndex) & (interval - 1)) == inst->lodPhase);
+    inst->lastActiveFrame = this->frameIndex;
+    if (inst->bake.IsValid() && !this->bakePool.Lookup(inst->bake)) {
+        // the played bake has been destroyed, evaluate the anim jobs again
+        inst->bake = Id::InvalidId();
+    }
+    if (inst->bake.IsValid()) {
+        // baked instances only copy their current baked frame
+        inst->lodEval = false;
+        inst->numHistory = 0;
+    }
+    if (inst->lodEval) {
+        this->numEvaluatedInstances++;
+    }
+
+    // keep the key blocks of streamed clips alive
+    if (inst->library->Streaming) {
+        for (const auto& item : inst->sequencer.items) {
+            this->keyCache.use(inst->library->Id.SlotIndex, item.clipIndex);
+        }
+    }
+
+    // assign the samples slice, half-float samples are unpacked into
+    // scratch memory while the instance is evaluated
+    if (inst->halfSamples) {
+        inst->packedSamples = this->samples.MakeSlice(inst->sampleOffset, sampleSlotSize(inst));
+        inst->samples.Reset();
+    }
+    else {
+        inst->samples = this->samples.MakeSlice(inst->sampleOffset, inst->library->SampleStride);
+    }
+
+    // assign the skin matrix slice
+    if (inst->skeleton) {
+        // one 'pixel' in the skin matrix table is a vec4
+        const int offset = inst->skinSlotY*this->skinMatrixTableStride + inst->skinSlotX * 4;
+        const int numPixels = AnimSkinFormat::NumPixels(inst->skeleton->SkinFormat);
+        inst->skinMatrices = Slice<float>(this->skinPages[inst->skinSlotPage].pool + this->curOutput * this->skinMatrixTableNumFloats,
+            this->skinMatrixTableNumFloats, offset, inst->skeleton->NumBones * numPixels * 4);
+
+        // update skinMatrixInfo
+        AnimSkinMatrixInfo::Page& page = this->skinMatrixInfo->Pages[inst->skinSlotPage];
+        const int byteSize = (inst->skinSlotY+1)*this->skinMatrixTableStride * 4;
+        if (byteSize > page.SkinMatrixTableByteSize) {
+            page.SkinMatrixTableByteSize = byteSize;
+        }
+        inst->skinInfoIndex = this->skinMatrixInfo->InstanceInfos.Size();
+        auto& info = this->skinMatrixInfo->InstanceInfos.Add();
+        info.Instance = inst->Id;
+        info.Page = inst->skinSlotPage;
+        const float halfPixelX = 0.5f / float(this->animSetup.SkinMatrixTableWidth);
+        const float halfPixelY = 0.5f / float(this->animSetup.SkinMatrixTableHeight);
+        info.ShaderInfo.x = (float(inst->skinSlotX)/float(this->animSetup.SkinMatrixTableWidth)) + halfPixelX;
+        info.ShaderInfo.y = (float(inst->skinSlotY)/float(this->animSetup.SkinMatrixTableHeight)) + halfPixelY;
+        info.ShaderInfo.z = float(this->animSetup.SkinMatrixTableWidth);
+        info.ShaderInfo.w = float(numPixels);
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool
+animMgr::allocSlots(animInstance* inst, bool& outSkinTableFull) {
+    o_assert_dbg(InvalidIndex == inst->sampleOffset);
+    outSkinTableFull = false;
+    const int sampleOffset = this->sampleAllocator.alloc(sampleSlotSize(inst));
+    if (InvalidIndex == sampleOffset) {
         // no more room in samples pool
         return false;
     }
     if (inst->skeleton) {
-        if (((this->curSkinMatrixTableX + (inst->skeleton->NumBones*3)) > this->animSetup.SkinMatrixTableWidth) &&
-            ((this->curSkinMatrixTableY + 1) > this->animSetup.SkinMatrixTableHeight))
+        // each skeleton bones in the skin matrix table takes up 4*3 floats for a
+        // transposed 4x3 matrix:
+        //
+        // |x0 x1 x2 x3|y0 y1 y2 y3|z0 z1 z2 z3|
+        //
+        // or 4*2 floats for a dual quaternion (rotation and dual part):
+        //
+        // |qx qy qz qw|dx dy dz dw|
+        //
+        // each "pixel" in the skin matrix table is 4 floats, an instance
+        // goes into the row with the tightest fitting free range of the
+        // first page it fits into (the topmost row on ties), if no page
+        // has room, it spills into a new page
+        const int numPixels = inst->skeleton->NumBones * AnimSkinFormat::NumPixels(inst->skeleton->SkinFormat);
+        for (int pageIndex = 0; ; pageIndex++) {
+            if ((pageIndex == this->skinPages.Size()) && !this->allocSkinPage()) {
+                // not enough room in the skin matrix table
+                this->sampleAllocator.free(sampleOffset, sampleSlotSize(inst));
+                outSkinTableFull = true;
+                return false;
+            }
+            auto& rows = this->skinPages[pageIndex].rowAllocators;
+            int bestRow = InvalidIndex;
+            int bestFit = 0;
+            for (int y = 0; y < rows.Size(); y++) {
+                const int fit = rows[y].smallestFit(numPixels);
+                if ((fit > 0) && ((InvalidIndex == bestRow) || (fit < bestFit))) {
+                    bestRow = y;
+                    bestFit = fit;
+                    if (fit == numPixels) {
+                        break;
+                    }
+                }
+            }
+            if (InvalidIndex != bestRow) {
+                inst->skinSlotPage = pageIndex;
+                inst->skinSlotX = rows[bestRow].alloc(numPixels);
+                inst->skinSlotY = bestRow;
+                break;
+            }
+        }
+    }
+    inst->sampleOffset = sampleOffset;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::freeSlots(animInstance* inst) {
+    o_assert_dbg(InvalidIndex != inst->sampleOffset);
+    this->sampleAllocator.free(inst->sampleOffset, sampleSlotSize(inst));
+    inst->sampleOffset = InvalidIndex;
+    inst->lastPoseFrame = 0;
+    inst->lodTailOutputs = 0;
+    if (InvalidIndex != inst->skinSlotY) {
+        const int numPixels = inst->skeleton->NumBones * AnimSkinFormat::NumPixels(inst->skeleton->SkinFormat);
+        this->skinPages[inst->skinSlotPage].rowAllocators[inst->skinSlotY].free(inst->skinSlotX, numPixels);
+        inst->skinSlotPage = InvalidIndex;
+        inst->skinSlotX = InvalidIndex;
+        inst->skinSlotY = InvalidIndex;
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+animMgr::allocSkinPage() {
+    if (this->skinPages.Size() == this->skinPages.Capacity()) {
+        return false;
+    }
+    // one table per output buffer, the page entry is added to all outputs
+    const int numOutputs = this->outputs.Size();
+    const int poolSize = numOutputs * this->skinMatrixTableNumFloats * sizeof(float);
+    skinPage& page = this->skinPages.Add();
+    page.pool = (float*) Memory::Alloc(poolSize);
+    Memory::Clear(page.pool, poolSize);
+    if (this->animSetup.HalfFloatSkinMatrixTable) {
+        const int halfPoolSize = numOutputs * this->skinMatrixTableNumFloats * sizeof(uint16_t);
+        page.halfPool = (uint16_t*) Memory::Alloc(halfPoolSize);
+        Memory::Clear(page.halfPool, halfPoolSize);
+    }
+    page.rowAllocators.SetFixedCapacity(this->animSetup.SkinMatrixTableHeight);
+    for (int y = 0; y < this->animSetup.SkinMatrixTableHeight; y++) {
+        page.rowAllocators.Add().setup(this->animSetup.SkinMatrixTableWidth);
+    }
+    for (int i = 0; i < numOutputs; i++) {
+        AnimSkinMatrixInfo::Page& info = this->outputs[i].skinMatrixInfo.Pages.Add();
+        info.SkinMatrixTable = page.pool + i * this->skinMatrixTableNumFloats;
+        if (page.halfPool) {
+            info.HalfSkinMatrixTable = page.halfPool + i * this->skinMatrixTableNumFloats;
+        }
+        info.DirtyRows.Reserve(this->animSetup.SkinMatrixTableHeight);
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+float*
+animMgr::skinSlot(const animInstance* inst, int outputIndex) const {
+    o_assert_dbg(InvalidIndex != inst->skinSlotPage);
+    return this->skinPages[inst->skinSlotPage].pool + outputIndex * this->skinMatrixTableNumFloats +
+        inst->skinSlotY*this->skinMatrixTableStride + inst->skinSlotX*4;
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::releaseSlots(uint32_t minActiveFrame) {
+    for (int i = this->slotInstances.Size() - 1; i >= 0; i--) {
+        animInstance* inst = this->slotInstances[i];
+        if (inst->lastActiveFrame < minActiveFrame) {
+            this->freeSlots(inst);
+            this->slotInstances.EraseSwap(i);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::gatherDirtyRows() {
+    // rows which contain the skin matrices of instances which wrote
+    // their own slot in this frame (instances sharing another instance's
+    // pose don't write their slot), the flags of all pages are stored
+    // back to back
+    const int height = this->animSetup.SkinMatrixTableHeight;
+    const int numPages = this->skinMatrixInfo->Pages.Size();
+    Memory::Clear(this->skinRowDirty.begin(), numPages * height);
+    for (const animInstance* inst : this->activeInstances) {
+        if (inst->skeleton &&
+            this->skinMatrixInfo->InstanceInfos[inst->skinInfoIndex].Changed &&
+            (inst->skinMatrices.begin() == this->skinSlot(inst, this->curOutput)))
+        {
+            this->skinRowDirty[inst->skinSlotPage*height + inst->skinSlotY] = 1;
+        }
+    }
+    for (int pageIndex = 0; pageIndex < numPages; pageIndex++) {
+        auto& dirtyRows = this->skinMatrixInfo->Pages[pageIndex].DirtyRows;
+        dirtyRows.Clear();
+        const uint8_t* rowDirty = &(this->skinRowDirty[pageIndex*height]);
+        for (int y = 0; y < height; y++) {
+            if (rowDirty[y]) {
+                if (!dirtyRows.Empty() && ((dirtyRows.Back().FirstRow + dirtyRows.Back().NumRows) == y)) {
+                    dirtyRows.Back().NumRows++;
+                }
+                else {
+                    auto& range = dirtyRows.Add();
+                    range.FirstRow = y;
+                    range.NumRows = 1;
+                }
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::assignUpdatePhase(animInstance* inst, int interval) {
+    // each phase slot counts the instances evaluated in frames where
+    // (frameIndex % MaxUpdateInterval) == slot, an instance with interval
+    // N and phase P is evaluated in all slots where (slot % N) == P
+    const int maxInterval = AnimConfig::MaxUpdateInterval;
+    if (inst->lodInterval > 1) {
+        for (int slot = inst->lodPhase; slot < maxInterval; slot += inst->lodInterval) {
+            this->phaseLoad[slot]--;
+            o_assert_dbg(this->phaseLoad[slot] >= 0);
+        }
+    }
+    inst->lodInterval = interval;
+    inst->lodPhase = 0;
+    if (interval > 1) {
+        // pick the phase with the lowest peak load
+        int bestLoad = 0;
+        for (int phase = 0; phase < interval; phase++) {
+            int load = 0;
+            for (int slot = phase; slot < maxInterval; slot += interval) {
+                load = this->phaseLoad[slot] > load ? this->phaseLoad[slot] : load;
+            }
+            if ((0 == phase) || (load < bestLoad)) {
+                bestLoad = load;
+                inst->lodPhase = phase;
+            }
+        }
+        for (int slot = inst->lodPhase; slot < maxInterval; slot += interval) {
+            this->phaseLoad[slot]++;
+        }
+    }
+    else if (inst->history) {
+        // full-rate instances don't need the pose history, it is
+        // allocated again when the interval goes up
+        Memory::Free(inst->history);
+        inst->history = nullptr;
+        inst->numHistory = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+static int
+numLodBones(const animInstance* inst) {
+    return inst->skeleton->LodNumBones[inst->boneLod];
+}
+
+//------------------------------------------------------------------------------
+static int
+numLodSamples(const animInstance* inst, const animSamplePlan* plan) {
+    // with a reduced bone LOD only the TRS samples (10 floats per
+    // bone) of the bones in the LOD are evaluated, other curve layouts
+    // are sampled completely and only the bone hierarchy is reduced
+    const int numSamples = inst->samples.Size();
+    if (inst->skeleton && (inst->boneLod > 0) && (animSamplePlan::TRS == plan->layout)) {
+        const int lodSamples = numLodBones(inst) * 10;
+        return lodSamples < numSamples ? lodSamples : numSamples;
+    }
+    return numSamples;
+}
+
+//------------------------------------------------------------------------------
+static void
+fillLodSamples(animInstance* inst, const animSamplePlan* plan, double curTime, int outputIndex) {
+    // the samples of bones outside the bone LOD are never evaluated, they
+    // get the static pose of the first visible clip, once per output buffer
+    // after the clip, the bone LOD or the sample slot changed, unpacked
+    // half-float samples start from the previous output and are filled
+    // in every evaluation
+    const int numEvaluated = numLodSamples(inst, plan);
+    const int numSamples = inst->samples.Size();
+    if (numEvaluated == numSamples) {
+        return;
+    }
+    const int clipIndex = inst->sequencer.items[inst->sequencer.firstVisibleItem(curTime)].clipIndex;
+    if (clipIndex != inst->lodTailClip) {
+        inst->lodTailClip = clipIndex;
+        inst->lodTailOutputs = 0;
+    }
+    const uint32_t outputBit = 1 << outputIndex;
+    if (inst->halfSamples || (0 == (inst->lodTailOutputs & outputBit))) {
+        const float* fallback = &(plan->fallback[plan->clips[clipIndex].firstValue]);
+        Memory::Copy(fallback + numEvaluated, inst->samples.begin() + numEvaluated, (numSamples - numEvaluated) * sizeof(float));
+        inst->lodTailOutputs |= outputBit;
+    }
+}
+
+//------------------------------------------------------------------------------
+static void
+evaluateChunk(void* userData, int chunkIndex, int participant) {
+    animMgr* self = (animMgr*) userData;
+    const int chunkSize = self->animSetup.EvaluateChunkSize;
+    const int begin = chunkIndex * chunkSize;
+    int end = begin + chunkSize;
+    if (end > self->activeInstances.Size()) {
+        end = self->activeInstances.Size();
+    }
+    self->evaluateRange(begin, end, chunkIndex, participant);
+}
+
+//------------------------------------------------------------------------------
+static void
+copySharedChunk(void* userData, int chunkIndex, int participant) {
+    animMgr* self = (animMgr*) userData;
+    const int chunkSize = self->animSetup.EvaluateChunkSize;
+    const int begin = chunkIndex * chunkSize;
+    int end = begin + chunkSize;
+    if (end > self->activeInstances.Size()) {
+        end = self->activeInstances.Size();
+    }
+    self->copySharedPoses(begin, end);
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::evaluate(double frameDur) {
+    ORYOL_ANIM_ZONE("Anim::evaluate");
+    o_assert_dbg(this->inFrame);
+    #if ORYOL_ANIM_FRAME_STATS
+    const TimePoint startTime = Clock::Now();
+    #endif
+    if (this->animSetup.PoseCacheEnabled) {
+        this->sharePoses();
+    }
+    if (this->animSetup.DirtyTrackingEnabled) {
+        this->skipUnchanged();
+    }
+    #if ORYOL_ANIM_FRAME_STATS
+    const Duration prepareTime = Clock::Since(startTime);
+    #endif
+    // each active instance only writes its own sequencer, samples and
+    // skin matrices, so chunks of instances can be evaluated independently
+    const int numInsts = this->activeInstances.Size();
+    const int chunkSize = this->animSetup.EvaluateChunkSize;
+    const bool parallel = this->workerPool.isValid && (chunkSize > 0) && (numInsts > chunkSize);
+    const int numChunks = parallel ? (numInsts + chunkSize - 1) / chunkSize : 1;
+    if (parallel) {
+        this->workerPool.run(numChunks, evaluateChunk, this);
+    }
+    else {
+        this->evaluateRange(0, numInsts, 0, 0);
+    }
+    // once all shared poses are evaluated, copy them into the own slots
+    // of the aliasing instances
+    if (this->numPoseCacheHits > 0) {
+        if (parallel) {
+            this->workerPool.run(numChunks, copySharedChunk, this);
+        }
+        else {
+            this->copySharedPoses(0, numInsts);
+        }
+    }
+    this->gatherDirtyRows();
+    #if ORYOL_ANIM_FRAME_STATS
+    this->updateFrameStats(prepareTime, Clock::Since(startTime));
+    #endif
+    this->readyOutput = this->curOutput;
+    this->curTime += frameDur;
+    this->inFrame = false;
+}
+
+//------------------------------------------------------------------------------
+static int64_t
+quantizeTime(double t, double quantum) {
+    if (quantum > 0.0) {
+        return int64_t(floor(t / quantum));
+    }
+    else {
+        int64_t bits;
+        static_assert(sizeof(bits) == sizeof(t), "double must be 64 bits");
+        Memory::Copy(&t, &bits, sizeof(bits));
+        return bits;
+    }
+}
+
+//------------------------------------------------------------------------------
+static uint64_t
+hashCombine(uint64_t h, uint64_t v) {
+    // FNV-1a style mixing of 64-bit values
+    return (h ^ v) * 0x100000001B3ULL;
+}
+
+//------------------------------------------------------------------------------
+static uint64_t
+poseHash(const animInstance* inst, double curTime, double quantum) {
+    // hash everything which affects the evaluated pose: library,
+    // skeleton and bone LOD, and the clip, mask, clip time and weight
+    // of all visible active anim jobs
+    uint64_t h = 0xCBF29CE484222325ULL;
+    h = hashCombine(h, uint64_t(uintptr_t(inst->library)));
+    h = hashCombine(h, uint64_t(uintptr_t(inst->skeleton)));
+    h = hashCombine(h, uint64_t(inst->boneLod));
+    h = hashCombine(h, uint64_t(inst->halfSamples));
+    h = hashCombine(h, uint64_t(inst->skinOnly));
+    const auto& seq = inst->sequencer;
+    for (int i = seq.firstVisibleItem(curTime); i < seq.items.Size(); i++) {
+        const auto& item = seq.items[i];
+        if (animSequencer::isActive(item, curTime)) {
+            const float w = animSequencer::weight(item, curTime);
+            uint32_t wBits;
+            Memory::Copy(&w, &wBits, sizeof(wBits));
+            h = hashCombine(h, uint64_t(item.clipIndex));
+            h = hashCombine(h, uint64_t(uintptr_t(item.mask)));
+            h = hashCombine(h, uint64_t(quantizeTime(curTime - item.absStartTime, quantum)));
+            h = hashCombine(h, uint64_t(wBits));
+        }
+    }
+    return h;
+}
+
+//------------------------------------------------------------------------------
+static bool
+samePose(const animInstance* a, const animInstance* b, double curTime, double quantum) {
+    if ((a->library != b->library) || (a->skeleton != b->skeleton) || (a->boneLod != b->boneLod) ||
+        (a->halfSamples != b->halfSamples) || (a->skinOnly != b->skinOnly))
+    {
+        return false;
+    }
+    const auto& seqA = a->sequencer;
+    const auto& seqB = b->sequencer;
+    int ia = seqA.firstVisibleItem(curTime);
+    int ib = seqB.firstVisibleItem(curTime);
+    for (;;) {
+        while ((ia < seqA.items.Size()) && !animSequencer::isActive(seqA.items[ia], curTime)) {
+            ia++;
+        }
+        while ((ib < seqB.items.Size()) && !animSequencer::isActive(seqB.items[ib], curTime)) {
+            ib++;
+        }
+        const bool endA = ia == seqA.items.Size();
+        const bool endB = ib == seqB.items.Size();
+        if (endA || endB) {
+            return endA && endB;
+        }
+        const auto& itemA = seqA.items[ia++];
+        const auto& itemB = seqB.items[ib++];
+        if ((itemA.clipIndex != itemB.clipIndex) ||
+            (itemA.mask != itemB.mask) ||
+            (quantizeTime(curTime - itemA.absStartTime, quantum) != quantizeTime(curTime - itemB.absStartTime, quantum)) ||
+            (animSequencer::weight(itemA, curTime) != animSequencer::weight(itemB, curTime)))
         {
-            // not enough room in the skin matrix table
             return false;
         }
     }
-    this->activeInstances.Add(inst);
-
-    // assign the samples slice
-    inst->samples = this->samples.MakeSlice(this->numSamples, inst->library->SampleStride);
-    this->numSamples += inst->library->SampleStride;
+}
 
-    // assign the skin matrix slice
-    if (inst->skeleton) {
-        // each skeleton bones in the skin matrix table takes up 4*3 floats for a
-        // transposed 4x3 matrix:
-        //
-        // |x0 x1 x2 x3|y0 y1 y2 y3|z0 z1 z2 z3|
-        //
-        // each "pixel" in the skin matrix table is 4 floats
-        //
-        if ((this->curSkinMatrixTableX + (inst->skeleton->NumBones*3)) > this->animSetup.SkinMatrixTableWidth) {
-            // doesn't fit into current skin matrix table row, start a new row
-            this->curSkinMatrixTableX = 0;
-            this->curSkinMatrixTableY++;
+//------------------------------------------------------------------------------
+static bool
+hasActiveJobs(const animInstance* inst, double curTime) {
+    const auto& seq = inst->sequencer;
+    for (int i = seq.firstVisibleItem(curTime); i < seq.items.Size(); i++) {
+        if (animSequencer::isActive(seq.items[i], curTime)) {
+            return true;
         }
-        // one 'pixel' in the skin matrix table is a vec4
-        const int offset = this->curSkinMatrixTableY*this->skinMatrixTableStride + this->curSkinMatrixTableX * 4;
-        inst->skinMatrices = this->skinMatrixTable.MakeSlice(offset, inst->skeleton->NumBones * 3 * 4);
+    }
+    return false;
+}
 
-        // update skinMatrixInfo
-        this->skinMatrixInfo.SkinMatrixTableByteSize = (this->curSkinMatrixTableY+1)*this->skinMatrixTableStride * 4;
-        auto& info = this->skinMatrixInfo.InstanceInfos.Add();
-        info.Instance = inst->Id;
-        const float halfPixelX = 0.5f / float(this->animSetup.SkinMatrixTableWidth);
-        const float halfPixelY = 0.5f / float(this->animSetup.SkinMatrixTableHeight);
-        info.ShaderInfo.x = (float(this->curSkinMatrixTableX)/float(this->animSetup.SkinMatrixTableWidth)) + halfPixelX;
-        info.ShaderInfo.y = (float(this->curSkinMatrixTableY)/float(this->animSetup.SkinMatrixTableHeight)) + halfPixelY;
-        info.ShaderInfo.z = float(this->animSetup.SkinMatrixTableWidth);
+//------------------------------------------------------------------------------
+void
+animMgr::sharePoses() {
+    // find active instances which would evaluate to the same pose, the
+    // first of them is evaluated, the others alias its samples and skin
+    // matrices, reduced-rate instances keep their own pose history and
+    // instances without active anim jobs keep their own previous pose,
+    // so they don't take part
+    const double quantum = this->animSetup.PoseCacheTimeQuantum;
+    const int slotMask = this->poseCacheSlots.Size() - 1;
+    for (int& slot : this->poseCacheSlots) {
+        slot = InvalidIndex;
+    }
+    for (int i = 0; i < this->activeInstances.Size(); i++) {
+        animInstance* inst = this->activeInstances[i];
+        if (!inst->lodEval || (inst->lodInterval > 1)) {
+            continue;
+        }
+        inst->sequencer.garbageCollect(this->curTime);
+        if (!hasActiveJobs(inst, this->curTime)) {
+            continue;
+        }
+        inst->poseHash = poseHash(inst, this->curTime, quantum);
+        for (int slotIndex = int(inst->poseHash & slotMask); ; slotIndex = (slotIndex + 1) & slotMask) {
+            const int ownerIndex = this->poseCacheSlots[slotIndex];
+            if (InvalidIndex == ownerIndex) {
+                this->poseCacheSlots[slotIndex] = i;
+                this->numPoseCacheMisses++;
+                break;
+            }
+            const animInstance* owner = this->activeInstances[ownerIndex];
+            if ((owner->poseHash == inst->poseHash) && samePose(owner, inst, this->curTime, quantum)) {
+                inst->samples = owner->samples;
+                inst->packedSamples = owner->packedSamples;
+                if (inst->skeleton) {
+                    inst->skinMatrices = owner->skinMatrices;
+                    auto& infos = this->skinMatrixInfo->InstanceInfos;
+                    infos[inst->skinInfoIndex].ShaderInfo = infos[owner->skinInfoIndex].ShaderInfo;
+                    infos[inst->skinInfoIndex].Page = infos[owner->skinInfoIndex].Page;
+                }
+                inst->lodEval = false;
+                inst->poseShared = true;
+                this->numEvaluatedInstances--;
+                this->numPoseCacheHits++;
+                break;
+            }
+        }
+    }
+}
 
-        // advance to next skin matrix table position
-        this->curSkinMatrixTableX += inst->skeleton->NumBones * 3;
+//------------------------------------------------------------------------------
+static uint64_t
+stateHash(const animInstance* inst, double curTime, uint32_t keysVersion) {
+    // like poseHash(), but with the sampled key positions instead of
+    // the clip time, so that clips without keys (only static curves
+    // or not yet streamed in) don't change the hash over time
+    uint64_t h = 0xCBF29CE484222325ULL;
+    h = hashCombine(h, uint64_t(uintptr_t(inst->library)));
+    h = hashCombine(h, uint64_t(uintptr_t(inst->skeleton)));
+    h = hashCombine(h, uint64_t(inst->boneLod));
+    h = hashCombine(h, uint64_t(keysVersion));
+    const auto& seq = inst->sequencer;
+    for (int i = seq.firstVisibleItem(curTime); i < seq.items.Size(); i++) {
+        const auto& item = seq.items[i];
+        if (animSequencer::isActive(item, curTime)) {
+            const AnimClip& clip = inst->library->Clips[item.clipIndex];
+            const float w = animSequencer::weight(item, curTime);
+            uint32_t wBits;
+            Memory::Copy(&w, &wBits, sizeof(wBits));
+            h = hashCombine(h, uint64_t(item.clipIndex));
+            h = hashCombine(h, uint64_t(uintptr_t(item.mask)));
+            h = hashCombine(h, uint64_t(wBits));
+            h = hashCombine(h, uint64_t(clip.Resident));
+            if (!clip.Keys.Empty()) {
+                int key0, key1;
+                float keyPos;
+                animSequencer::samplePos(clip, item, curTime, key0, key1, keyPos);
+                uint32_t posBits;
+                Memory::Copy(&keyPos, &posBits, sizeof(posBits));
+                h = hashCombine(h, uint64_t(key0));
+                h = hashCombine(h, uint64_t(key1));
+                h = hashCombine(h, uint64_t(posBits));
+            }
+        }
     }
-    return true;
+    return h;
 }
 
 //------------------------------------------------------------------------------
 void
-animMgr::evaluate(double frameDur) {
-    o_assert_dbg(this->inFrame);
-    // garbage-collect anim jobs in all active instances
+animMgr::skipUnchanged() {
+    // an instance which was active in the previous frame (and thus
+    // kept its slots), and whose anim jobs sample the same keys, would
+    // produce the same pose again, so the pose from the previous frame
+    // is kept, reduced-rate, baked and pose-sharing instances don't
+    // take part
     for (animInstance* inst : this->activeInstances) {
+        if (!inst->lodEval || (inst->lodInterval > 1)) {
+            continue;
+        }
         inst->sequencer.garbageCollect(this->curTime);
+        const uint64_t h = stateHash(inst, this->curTime, this->keysVersion);
+        const bool unchanged = (h == inst->stateHash) && ((inst->lastPoseFrame + 1) == this->frameIndex);
+        inst->stateHash = h;
+        inst->lastPoseFrame = this->frameIndex;
+        if (unchanged) {
+            inst->lodEval = false;
+            inst->poseUnchanged = true;
+            if (inst->skeleton) {
+                this->skinMatrixInfo->InstanceInfos[inst->skinInfoIndex].Changed = false;
+            }
+            this->numEvaluatedInstances--;
+            this->numUnchangedInstances++;
+        }
     }
-    // evaluate animation of all active instances
-    for (animInstance* inst : this->activeInstances) {
-        inst->sequencer.eval(inst->library, this->curTime, inst->samples.begin(), inst->samples.Size());
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::evaluateRange(int begin, int end, int chunkIndex, int participant) {
+    ORYOL_ANIM_ZONE("Anim::evaluateRange");
+    // each chunk collects its statistics separately, they are
+    // summed up in updateFrameStats()
+    #if ORYOL_ANIM_FRAME_STATS
+    chunkStats& stats = this->evalChunkStats[chunkIndex];
+    stats = chunkStats();
+    animSequencer::evalStats* seqStats = &stats.eval;
+    TimePoint t = Clock::Now();
+    #else
+    animSequencer::evalStats* seqStats = nullptr;
+    #endif
+
+    // garbage-collect anim jobs in all evaluated instances
+    for (int i = begin; i < end; i++) {
+        animInstance* inst = this->activeInstances[i];
+        if (inst->lodEval) {
+            inst->sequencer.garbageCollect(this->curTime);
+        }
     }
-    // compute the skinning matrices for all active instances (which have skeletons)
-    for (animInstance* inst : this->activeInstances) {
+    this->unpackHalfSamples(begin, end, participant);
+    #if ORYOL_ANIM_FRAME_STATS
+    stats.gcTime = Clock::LapTime(t);
+    #endif
+    // evaluate animation of all evaluated instances, if only the skin
+    // matrices are needed, a single clip of a TRS library is sampled
+    // while generating the skin matrices instead
+    for (int i = begin; i < end; i++) {
+        animInstance* inst = this->activeInstances[i];
+        if (inst->lodEval) {
+            const animSamplePlan* plan = &this->samplePlans[inst->library->Id.SlotIndex];
+            inst->fusedEval = inst->skinOnly && !inst->halfSamples && (1 == inst->lodInterval) &&
+                (animSamplePlan::TRS == plan->layout) &&
+                inst->sequencer.singleClip(inst->library, plan, this->curTime, numLodSamples(inst, plan), inst->fusedClip, seqStats);
+            if (!inst->fusedEval) {
+                if (inst->sequencer.eval(inst->library, plan, this->curTime, inst->samples.begin(), numLodSamples(inst, plan), seqStats)) {
+                    fillLodSamples(inst, plan, this->curTime, this->curOutput);
+                }
+                else {
+                    // no active anim jobs, keep the previous samples
+                    this->copyPrevPose(inst);
+                }
+            }
+        }
+    }
+    #if ORYOL_ANIM_FRAME_STATS
+    stats.sampleTime = Clock::LapTime(t);
+    #endif
+    // compute the skinning matrices for all evaluated instances (which have skeletons)
+    this->genSkinMatricesRange(begin, end, participant);
+    #if ORYOL_ANIM_FRAME_STATS
+    stats.skinTime = Clock::LapTime(t);
+    #endif
+    // record or restore the poses of reduced-rate instances, copy the
+    // skin matrices of baked instances and the poses of unchanged instances
+    for (int i = begin; i < end; i++) {
+        animInstance* inst = this->activeInstances[i];
+        if (inst->poseUnchanged) {
+            this->copyPrevPose(inst);
+        }
+        else if (inst->bake.IsValid()) {
+            this->copyBakedFrame(inst);
+        }
+        else if (inst->lodInterval > 1) {
+            this->updateHistory(inst);
+        }
+    }
+    this->packHalfSamples(begin, end);
+    if (this->animSetup.HalfFloatSkinMatrixTable) {
+        for (int i = begin; i < end; i++) {
+            this->storeHalfSkinMatrices(this->activeInstances[i]);
+        }
+    }
+    #if ORYOL_ANIM_FRAME_STATS
+    stats.copyTime = Clock::LapTime(t);
+    #endif
+}
+
+//------------------------------------------------------------------------------
+static bool
+needsUnpackedSamples(const animInstance* inst) {
+    // evaluated instances, and reduced-rate instances which restore
+    // their samples from the pose history
+    return inst->halfSamples && (inst->lodEval || ((inst->lodInterval > 1) && !inst->bake.IsValid()));
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::unpackHalfSamples(int begin, int end, int participant) {
+    int numScratch = 0;
+    for (int i = begin; i < end; i++) {
+        const animInstance* inst = this->activeInstances[i];
+        if (needsUnpackedSamples(inst)) {
+            numScratch += inst->library->SampleStride;
+        }
+    }
+    if (0 == numScratch) {
+        return;
+    }
+    evalScratch& scratch = this->evalScratches[participant];
+    if (numScratch > scratch.capacity) {
+        if (scratch.samples) {
+            Memory::Free(scratch.samples);
+        }
+        scratch.samples = (float*) Memory::Alloc(numScratch * sizeof(float));
+        scratch.capacity = numScratch;
+    }
+    // evaluation starts from the previous frame's samples (lanes which
+    // no anim job writes keep their value)
+    const float* prevSamples = this->samplePool + this->prevOutput * this->animSetup.SamplePoolCapacity;
+    int offset = 0;
+    for (int i = begin; i < end; i++) {
+        animInstance* inst = this->activeInstances[i];
+        if (needsUnpackedSamples(inst)) {
+            const int numSamples = inst->library->SampleStride;
+            inst->samples = Slice<float>(scratch.samples, scratch.capacity, offset, numSamples);
+            offset += numSamples;
+            if (inst->lodEval) {
+                unpackSamples(prevSamples + inst->sampleOffset, inst->samples.begin(), numSamples);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::packHalfSamples(int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        animInstance* inst = this->activeInstances[i];
+        if (needsUnpackedSamples(inst)) {
+            packSamples(inst->samples.begin(), inst->packedSamples.begin(), inst->samples.Size());
+            inst->samples.Reset();
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::storeHalfSkinMatrices(const animInstance* inst) {
+    // only instances which own their skin matrix table slot, unchanged
+    // skin matrices are already in place with a single output buffer
+    if (!inst->skeleton) {
+        return;
+    }
+    if (inst->skinMatrices.begin() != this->skinSlot(inst, this->curOutput)) {
+        return;
+    }
+    if ((this->prevOutput == this->curOutput) && !this->skinMatrixInfo->InstanceInfos[inst->skinInfoIndex].Changed) {
+        return;
+    }
+    // the half-float table has the same layout as the float table
+    const skinPage& page = this->skinPages[inst->skinSlotPage];
+    const int offset = int(inst->skinMatrices.begin() - page.pool);
+    animFloatToHalf(inst->skinMatrices.begin(), page.halfPool + offset, inst->skinMatrices.Size());
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::updateFrameStats(Duration prepareTime, Duration evaluateTime) {
+    AnimFrameStats& stats = this->frameStats;
+    const int numInsts = this->activeInstances.Size();
+    stats.NumActiveInstances = numInsts;
+    stats.NumEvaluatedInstances = this->numEvaluatedInstances;
+    stats.NumPoseCacheHits = this->numPoseCacheHits;
+    stats.NumUnchangedInstances = this->numUnchangedInstances;
+    for (const animInstance* inst : this->activeInstances) {
+        if (inst->bake.IsValid()) {
+            stats.NumBakedInstances++;
+        }
+        else if ((inst->lodInterval > 1) && !inst->lodEval) {
+            stats.NumUpdateRateSkipped++;
+        }
+    }
+
+    // sum up the chunk statistics
+    const int chunkSize = this->animSetup.EvaluateChunkSize;
+    const bool parallel = this->workerPool.isValid && (chunkSize > 0) && (numInsts > chunkSize);
+    const int numChunks = parallel ? (numInsts + chunkSize - 1) / chunkSize : 1;
+    for (int i = 0; i < numChunks; i++) {
+        const chunkStats& chunk = this->evalChunkStats[i];
+        stats.NumItemsProcessed += chunk.eval.numItems;
+        stats.NumItemsSkipped += chunk.eval.numSkippedItems;
+        stats.NumCurvesSampled += chunk.eval.numCurves;
+        stats.NumKeysSampled += chunk.eval.numKeys;
+        stats.GarbageCollectTime += chunk.gcTime;
+        stats.SampleTime += chunk.sampleTime;
+        stats.SkinTime += chunk.skinTime;
+        stats.CopyTime += chunk.copyTime;
+    }
+    stats.PrepareTime = prepareTime;
+    stats.EvaluateTime = evaluateTime;
+
+    // skin matrix table usage: free pixels which aren't in the largest
+    // free range of their row are fragmented, free ranges which are
+    // smaller than the smallest instance slot are wasted
+    int minSlotPixels = 0;
+    for (const animInstance* inst : this->slotInstances) {
         if (inst->skeleton) {
-            this->genSkinMatrices(inst);
+            const int slotPixels = inst->skeleton->NumBones * AnimSkinFormat::NumPixels(inst->skeleton->SkinFormat);
+            if ((0 == minSlotPixels) || (slotPixels < minSlotPixels)) {
+                minSlotPixels = slotPixels;
+            }
+        }
+    }
+    int numPixels = 0;
+    int numFreePixels = 0;
+    int numLargestFreePixels = 0;
+    int numWastedPixels = 0;
+    for (const skinPage& page : this->skinPages) {
+        for (const animRangeAllocator& row : page.rowAllocators) {
+            numPixels += row.numUsed;
+            numFreePixels += row.capacity - row.numUsed;
+            numLargestFreePixels += row.largestFree();
+            for (const animRangeAllocator::range& r : row.freeRanges) {
+                if (r.num < minSlotPixels) {
+                    numWastedPixels += r.num;
+                }
+            }
+        }
+    }
+    const int tablePixels = this->skinPages.Size() * this->animSetup.SkinMatrixTableWidth * this->animSetup.SkinMatrixTableHeight;
+    stats.NumSkinMatrixPages = this->skinPages.Size();
+    stats.SkinMatrixTableFill = tablePixels > 0 ? float(numPixels) / float(tablePixels) : 0.0f;
+    stats.SkinMatrixTableFragmentation = numFreePixels > 0 ? 1.0f - float(numLargestFreePixels) / float(numFreePixels) : 0.0f;
+    stats.SkinMatrixTableWaste = tablePixels > 0 ? float(numWastedPixels) / float(tablePixels) : 0.0f;
+
+    // pool high-water marks
+    if (numInsts > stats.MaxActiveInstances) {
+        stats.MaxActiveInstances = numInsts;
+    }
+    if (this->sampleAllocator.numUsed > stats.MaxSamples) {
+        stats.MaxSamples = this->sampleAllocator.numUsed;
+    }
+    if (numPixels > stats.MaxSkinMatrixPixels) {
+        stats.MaxSkinMatrixPixels = numPixels;
+    }
+    if (this->keyAllocator.numUsed > stats.MaxKeys) {
+        stats.MaxKeys = this->keyAllocator.numUsed;
+    }
+    if (this->curveAllocator.numUsed > stats.MaxCurves) {
+        stats.MaxCurves = this->curveAllocator.numUsed;
+    }
+    if (this->clipAllocator.numUsed > stats.MaxClips) {
+        stats.MaxClips = this->clipAllocator.numUsed;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::copyPrevPose(animInstance* inst) {
+    if (this->prevOutput == this->curOutput) {
+        // single output buffer, the pose is already in place
+        return;
+    }
+    const float* srcSamples = this->samplePool + this->prevOutput * this->animSetup.SamplePoolCapacity + inst->sampleOffset;
+    Slice<float>& dstSamples = inst->halfSamples ? inst->packedSamples : inst->samples;
+    Memory::Copy(srcSamples, dstSamples.begin(), dstSamples.Size() * sizeof(float));
+    if (inst->skeleton) {
+        const float* srcSkin = this->skinSlot(inst, this->prevOutput);
+        Memory::Copy(srcSkin, inst->skinMatrices.begin(), inst->skinMatrices.Size() * sizeof(float));
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::copySharedPoses(int begin, int end) {
+    // an aliasing instance never evaluates into its own slots, without
+    // the copy it would fall back to a stale pose when it has no active
+    // anim jobs in a later frame, or when lanes aren't written by its jobs
+    float* samplePool = this->samplePool + this->curOutput * this->animSetup.SamplePoolCapacity;
+    for (int i = begin; i < end; i++) {
+        const animInstance* inst = this->activeInstances[i];
+        if (!inst->poseShared) {
+            continue;
+        }
+        const Slice<float>& srcSamples = inst->halfSamples ? inst->packedSamples : inst->samples;
+        Memory::Copy(srcSamples.begin(), samplePool + inst->sampleOffset, srcSamples.Size() * sizeof(float));
+        if (inst->skeleton) {
+            Memory::Copy(inst->skinMatrices.begin(), this->skinSlot(inst, this->curOutput), inst->skinMatrices.Size() * sizeof(float));
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::copyBakedFrame(animInstance* inst) {
+    o_assert_dbg(inst->bake.IsValid() && inst->skeleton);
+    const AnimBake* bake = this->bakePool.Lookup(inst->bake);
+    if (!bake) {
+        // destroyed after the instance was added, keep the previous pose
+        return;
+    }
+    const AnimBake::Clip& clip = bake->Clips[inst->bakeClip];
+    int frame = 0;
+    if (clip.FrameDuration > 0.0) {
+        const double t = this->curTime - inst->bakeStartTime;
+        // use the nearest baked frame
+        frame = t > 0.0 ? (int(t / clip.FrameDuration + 0.5) % clip.NumFrames) : 0;
+    }
+    const int rowSize = bake->NumBones * AnimSkinFormat::NumFloats(bake->SkinFormat);
+    const float* src = &(bake->Matrices[(clip.FirstFrame + frame) * rowSize]);
+    Memory::Copy(src, inst->skinMatrices.begin(), rowSize * sizeof(float));
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::updateHistory(animInstance* inst) {
+    o_assert_dbg(inst->history);
+    const int numSamples = inst->samples.Size();
+    const int numSkinFloats = inst->skinMatrices.Size();
+    const int stride = numSamples + numSkinFloats;
+    if (inst->lodEval) {
+        // store the new pose, the previous pose becomes the interpolation start
+        inst->historyIndex ^= 1;
+        float* dst = inst->history + inst->historyIndex * stride;
+        Memory::Copy(inst->samples.begin(), dst, numSamples * sizeof(float));
+        if (numSkinFloats > 0) {
+            Memory::Copy(inst->skinMatrices.begin(), dst + numSamples, numSkinFloats * sizeof(float));
+        }
+        if (inst->numHistory < 2) {
+            inst->numHistory++;
+        }
+        inst->lastEvalFrame = this->frameIndex;
+    }
+    const float* last = inst->history + inst->historyIndex * stride;
+    if (inst->interpolate && (2 == inst->numHistory)) {
+        // blend from the previous towards the last pose, this lags
+        // behind by up to (interval-1) frames but moves every frame
+        const float* prev = inst->history + (inst->historyIndex ^ 1) * stride;
+        float t = float(this->frameIndex - inst->lastEvalFrame + 1) / float(inst->lodInterval);
+        t = t > 1.0f ? 1.0f : t;
+        float* smp = inst->samples.begin();
+        for (int i = 0; i < numSamples; i++) {
+            smp[i] = prev[i] + (last[i] - prev[i]) * t;
+        }
+        if (numSkinFloats > 0) {
+            float* skin = inst->skinMatrices.begin();
+            for (int i = numSamples; i < stride; i++) {
+                skin[i - numSamples] = prev[i] + (last[i] - prev[i]) * t;
+            }
+        }
+    }
+    else if (!inst->lodEval) {
+        Memory::Copy(last, inst->samples.begin(), numSamples * sizeof(float));
+        if (numSkinFloats > 0) {
+            Memory::Copy(last + numSamples, inst->skinMatrices.begin(), numSkinFloats * sizeof(float));
         }
     }
-    this->curTime += frameDur;
-    this->inFrame = false;
 }
 
 //------------------------------------------------------------------------------
@@ -562,23 +2493,121 @@ mx_copy(const float* src, float* dst) {
 }
 
 //------------------------------------------------------------------------------
-void
-animMgr::genSkinMatrices(animInstance* inst) {
-    o_assert_dbg(inst && inst->skeleton);
+static void
+mx_to_dualquat(const float* m, float* dq) {
+    // convert a transposed 4x3 skin matrix into a unit dual quaternion,
+    // the scale is removed by normalizing the rotation columns
+    float r[9];
+    for (int c = 0; c < 3; c++) {
+        const float len = sqrtf(m[c]*m[c] + m[4+c]*m[4+c] + m[8+c]*m[8+c]);
+        const float s = len > 0.0f ? 1.0f / len : 0.0f;
+        r[c] = m[c] * s; r[3+c] = m[4+c] * s; r[6+c] = m[8+c] * s;
+    }
+    float qx, qy, qz, qw;
+    const float trace = r[0] + r[4] + r[8];
+    if (trace > 0.0f) {
+        const float s = 0.5f / sqrtf(trace + 1.0f);
+        qw = 0.25f / s;
+        qx = (r[7] - r[5]) * s;
+        qy = (r[2] - r[6]) * s;
+        qz = (r[3] - r[1]) * s;
+    }
+    else if ((r[0] > r[4]) && (r[0] > r[8])) {
+        const float s = 0.5f / sqrtf(1.0f + r[0] - r[4] - r[8]);
+        qw = (r[7] - r[5]) * s;
+        qx = 0.25f / s;
+        qy = (r[1] + r[3]) * s;
+        qz = (r[2] + r[6]) * s;
+    }
+    else if (r[4] > r[8]) {
+        const float s = 0.5f / sqrtf(1.0f + r[4] - r[0] - r[8]);
+        qw = (r[2] - r[6]) * s;
+        qx = (r[1] + r[3]) * s;
+        qy = 0.25f / s;
+        qz = (r[5] + r[7]) * s;
+    }
+    else {
+        const float s = 0.5f / sqrtf(1.0f + r[8] - r[0] - r[4]);
+        qw = (r[3] - r[1]) * s;
+        qx = (r[2] + r[6]) * s;
+        qy = (r[5] + r[7]) * s;
+        qz = 0.25f / s;
+    }
+    // renormalize, and keep w positive so that neighbouring bones
+    // usually are in the same hemisphere for blending in the shader
+    float n = 1.0f / sqrtf(qx*qx + qy*qy + qz*qz + qw*qw);
+    if (qw < 0.0f) {
+        n = -n;
+    }
+    qx *= n; qy *= n; qz *= n; qw *= n;
+    // the dual part is 0.5 * t * q
+    const float tx = m[3]; const float ty = m[7]; const float tz = m[11];
+    dq[0] = qx; dq[1] = qy; dq[2] = qz; dq[3] = qw;
+    dq[4] = 0.5f * ( tx*qw + ty*qz - tz*qy);
+    dq[5] = 0.5f * (-tx*qz + ty*qw + tz*qx);
+    dq[6] = 0.5f * ( tx*qy - ty*qx + tz*qw);
+    dq[7] = -0.5f * (tx*qx + ty*qy + tz*qz);
+}
+
+//------------------------------------------------------------------------------
+static void
+copyLodBones(const AnimSkeleton* skel, int firstBone, float* skinMatrices) {
+    // bones outside the evaluated LOD move rigidly with their parent,
+    // parents come before children, so whole chains are covered
+    static const float identity[12] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+    static const float identityDualQuat[8] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    const bool dualQuat = AnimSkinFormat::DualQuaternion == skel->SkinFormat;
+    const int numFloats = AnimSkinFormat::NumFloats(skel->SkinFormat);
+    for (int boneIndex = firstBone; boneIndex < skel->NumBones; boneIndex++) {
+        const int32_t parentIndex = skel->ParentIndices[boneIndex];
+        const float* src = (-1 != parentIndex) ? &skinMatrices[parentIndex * numFloats] : (dualQuat ? identityDualQuat : identity);
+        Memory::Copy(src, &skinMatrices[boneIndex * numFloats], numFloats * sizeof(float));
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    The sample sources of genSkinMatricesFrom(), bone() returns the 10
+    TRS samples of a bone, either from the evaluated sample buffer, or
+    sampled straight from the keys of a single clip into tmp.
+*/
+struct sampleBufferSource {
+    const float* samples = nullptr;
+    const float* bone(int boneIndex, float* /*tmp*/) const {
+        return this->samples + boneIndex * 10;
+    }
+};
+struct trsKeySource {
+    const int16_t* src0 = nullptr;
+    const int16_t* src1 = nullptr;
+    const uint16_t* laneKeys = nullptr;
+    const float* values = nullptr;
+    float keyPos = 0.0f;
+    const float* bone(int boneIndex, float* tmp) const {
+        const int lane = boneIndex * 10;
+        animSampler::sampleLanes<10>(this->src0, this->src1, this->laneKeys + lane, this->values + lane, this->keyPos, tmp);
+        return tmp;
+    }
+};
+
+//------------------------------------------------------------------------------
+template<class SOURCE> static void
+genSkinMatricesFrom(animInstance* inst, const SOURCE& source, float* tmpBoneMatrices) {
     const int32_t* parentIndices = &inst->skeleton->ParentIndices[0];
     // pointer to skeleton's inverse bind pose matrices
     const float* invBindPose = &(inst->skeleton->InvBindPose[0][0][0]);
     // output are transposed 4x3 matrices ready for upload to GPU
     float* outSkinMatrices = &(inst->skinMatrices[0]);
-    // input samples (result of animation evaluation)
-    const float* smp = &(inst->samples[0]);
 
-    float m0[12], m1[12];
-    float tmpBoneMatrices[AnimConfig::MaxNumSkeletonBones][12];
-    const int numBones = inst->skeleton->NumBones;
-    for (int boneIndex=0; boneIndex<numBones; boneIndex++, smp+=10, outSkinMatrices+=12) {
+    const bool dualQuat = AnimSkinFormat::DualQuaternion == inst->skeleton->SkinFormat;
+    const int numSkinFloats = AnimSkinFormat::NumFloats(inst->skeleton->SkinFormat);
+
+    float m0[12], m1[12], skin[12], tmp[10];
+    const int numBones = numLodBones(inst);
+    for (int boneIndex=0; boneIndex<numBones; boneIndex++, outSkinMatrices+=numSkinFloats) {
 
         // samples bone translate, rotate (quat), scale to matrix
+        const float* smp = source.bone(boneIndex, tmp);
         float tx=smp[0]; float ty=smp[1]; float tz=smp[2];
         float qx=smp[3]; float qy=smp[4]; float qz=smp[5]; float qw=smp[6];
         float sx=smp[7]; float sy=smp[8]; float sz=smp[9];
@@ -594,17 +2623,272 @@ animMgr::genSkinMatrices(animInstance* inst) {
         const int32_t parentIndex = parentIndices[boneIndex];
         const float* m;
         if (-1 != parentIndex) {
-            mx_mul4x3(&tmpBoneMatrices[parentIndex][0], m0, m1);
+            mx_mul4x3(&tmpBoneMatrices[parentIndex * 12], m0, m1);
             m = m1;
         }
         else {
             m = m0;
         }
-        mx_copy(m, &tmpBoneMatrices[boneIndex][0]);
+        mx_copy(m, &tmpBoneMatrices[boneIndex * 12]);
 
         // multiply with inverse bind pose matrix into transposed skin matrix
-        mx_mul4x3_transpose(m, &invBindPose[boneIndex * 12], outSkinMatrices);
+        if (dualQuat) {
+            mx_mul4x3_transpose(m, &invBindPose[boneIndex * 12], skin);
+            mx_to_dualquat(skin, outSkinMatrices);
+        }
+        else {
+            mx_mul4x3_transpose(m, &invBindPose[boneIndex * 12], outSkinMatrices);
+        }
+    }
+    if (numBones < inst->skeleton->NumBones) {
+        copyLodBones(inst->skeleton, numBones, &(inst->skinMatrices[0]));
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::genSkinMatrices(animInstance* inst, int participant) {
+    o_assert_dbg(inst && inst->skeleton);
+    float* tmpBoneMatrices = this->evalScratches[participant].boneMatrices;
+    o_assert_dbg(tmpBoneMatrices);
+    if (inst->fusedEval) {
+        // fused path, the samples of each bone are only kept on the stack
+        const animSamplePlan& plan = this->samplePlans[inst->library->Id.SlotIndex];
+        const animSamplePlan::clipPlan& cp = plan.clips[inst->fusedClip.clipIndex];
+        o_assert_dbg((animSamplePlan::TRS == plan.layout) && cp.laneSampled);
+        o_assert_dbg((numLodBones(inst) * 10) <= inst->library->SampleStride);
+        trsKeySource source;
+        source.src0 = inst->fusedClip.src0;
+        source.src1 = inst->fusedClip.src1;
+        source.laneKeys = &(plan.laneKeys[cp.firstValue]);
+        source.values = &(plan.values[cp.firstValue]);
+        source.keyPos = inst->fusedClip.keyPos;
+        genSkinMatricesFrom(inst, source, tmpBoneMatrices);
+    }
+    else {
+        // input samples (result of animation evaluation)
+        sampleBufferSource source;
+        source.samples = &(inst->samples[0]);
+        genSkinMatricesFrom(inst, source, tmpBoneMatrices);
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::genSkinMatricesRange(int begin, int end, int participant) {
+    ORYOL_ANIM_ZONE("Anim::genSkinMatrices");
+    #if ORYOL_ANIM_USE_SIMD_LANES
+    // collect instances with the same skeleton into batches, and
+    // process full batches in SIMD lanes, if too many different
+    // skeletons are in flight, fall back to the scalar path
+    struct batch {
+        const AnimSkeleton* skeleton = nullptr;
+        int numBones = 0;
+        int num = 0;
+        animInstance* insts[animVecLanes];
+    };
+    static const int maxBatches = 8;
+    batch batches[maxBatches];
+    int numBatches = 0;
+    for (int i = begin; i < end; i++) {
+        animInstance* inst = this->activeInstances[i];
+        if (!inst->skeleton || !inst->lodEval) {
+            continue;
+        }
+        if (inst->fusedEval) {
+            // samples straight from the keys, there's no sample buffer to gather from
+            this->genSkinMatrices(inst, participant);
+            continue;
+        }
+        batch* b = nullptr;
+        const int numBones = numLodBones(inst);
+        for (int bi = 0; bi < numBatches; bi++) {
+            if ((batches[bi].skeleton == inst->skeleton) && (batches[bi].numBones == numBones)) {
+                b = &batches[bi];
+                break;
+            }
+        }
+        if (!b) {
+            if (numBatches == maxBatches) {
+                this->genSkinMatrices(inst, participant);
+                continue;
+            }
+            b = &batches[numBatches++];
+            b->skeleton = inst->skeleton;
+            b->numBones = numBones;
+        }
+        b->insts[b->num++] = inst;
+        if (b->num == animVecLanes) {
+            this->genSkinMatricesBatch(b->insts, b->num, participant);
+            b->num = 0;
+        }
+    }
+    // flush partial batches
+    for (int bi = 0; bi < numBatches; bi++) {
+        const batch& b = batches[bi];
+        if (b.num > 1) {
+            this->genSkinMatricesBatch(b.insts, b.num, participant);
+        }
+        else if (b.num == 1) {
+            this->genSkinMatrices(b.insts[0], participant);
+        }
+    }
+    #else
+    for (int i = begin; i < end; i++) {
+        animInstance* inst = this->activeInstances[i];
+        if (inst->skeleton && inst->lodEval) {
+            this->genSkinMatrices(inst, participant);
+        }
+    }
+    #endif
+}
+
+#if ORYOL_ANIM_USE_SIMD_LANES
+//------------------------------------------------------------------------------
+void
+animMgr::genSkinMatricesBatch(animInstance* const* insts, int num, int participant) {
+    // this is the same computation as genSkinMatrices() in the same
+    // order of operations, but for up to animVecLanes instances of the
+    // same skeleton and bone LOD in SoA layout (one instance per SIMD lane), unused
+    // lanes compute the first instance again but are not written back
+    o_assert_dbg((num > 0) && (num <= animVecLanes));
+    const AnimSkeleton* skel = insts[0]->skeleton;
+    const int32_t* parentIndices = &skel->ParentIndices[0];
+    const float* invBindPose = &(skel->InvBindPose[0][0][0]);
+    const float* smp[animVecLanes];
+    float* out[animVecLanes];
+    for (int l = 0; l < animVecLanes; l++) {
+        animInstance* inst = insts[(l < num) ? l : 0];
+        o_assert_dbg((inst->skeleton == skel) && (numLodBones(inst) == numLodBones(insts[0])));
+        smp[l] = &(inst->samples[0]);
+        out[l] = &(inst->skinMatrices[0]);
+    }
+
+    const animVec one = animVecSet(1.0f);
+    const animVec two = animVecSet(2.0f);
+    const bool dualQuat = AnimSkinFormat::DualQuaternion == skel->SkinFormat;
+    animVec m0[12], m1[12], ib[12];
+    alignas(32) float lanes[animVecLanes];
+    float skin[animVecLanes][12];
+    animVec* tmpBoneMatrices = (animVec*) this->evalScratches[participant].boneMatrices;
+    o_assert_dbg(tmpBoneMatrices);
+    const int numBones = numLodBones(insts[0]);
+    for (int boneIndex = 0; boneIndex < numBones; boneIndex++) {
+        const int s = boneIndex * 10;
+        animVec tx=animVecGather(smp,s+0); animVec ty=animVecGather(smp,s+1); animVec tz=animVecGather(smp,s+2);
+        animVec qx=animVecGather(smp,s+3); animVec qy=animVecGather(smp,s+4); animVec qz=animVecGather(smp,s+5); animVec qw=animVecGather(smp,s+6);
+        animVec sx=animVecGather(smp,s+7); animVec sy=animVecGather(smp,s+8); animVec sz=animVecGather(smp,s+9);
+        animVec qxx=qx*qx; animVec qyy=qy*qy; animVec qzz=qz*qz;
+        animVec qxz=qx*qz; animVec qxy=qx*qy; animVec qyz=qy*qz;
+        animVec qwx=qw*qx; animVec qwy=qw*qy; animVec qwz=qw*qz;
+        m0[0]=sx*(one-two*(qyy+qzz)); m0[1]=sx*(two*(qxy+qwz));     m0[2]=sx*(two*(qxz-qwy));
+        m0[3]=sy*(two*(qxy-qwz));     m0[4]=sy*(one-two*(qxx+qzz)); m0[5]=sy*(two*(qyz+qwx));
+        m0[6]=sz*(two*(qxz+qwy));     m0[7]=sz*(two*(qyz-qwx));     m0[8]=sz*(one-two*(qxx+qyy));
+        m0[9]=tx;                     m0[10]=ty;                    m0[11]=tz;
+
+        // multiply with parent bone matrix
+        const int32_t parentIndex = parentIndices[boneIndex];
+        const animVec* m;
+        if (-1 != parentIndex) {
+            const animVec* p = &tmpBoneMatrices[parentIndex * 12];
+            m1[0]  = p[0]*m0[0] + p[3]*m0[1]  + p[6]*m0[2];
+            m1[1]  = p[1]*m0[0] + p[4]*m0[1]  + p[7]*m0[2];
+            m1[2]  = p[2]*m0[0] + p[5]*m0[1]  + p[8]*m0[2];
+            m1[3]  = p[0]*m0[3] + p[3]*m0[4]  + p[6]*m0[5];
+            m1[4]  = p[1]*m0[3] + p[4]*m0[4]  + p[7]*m0[5];
+            m1[5]  = p[2]*m0[3] + p[5]*m0[4]  + p[8]*m0[5];
+            m1[6]  = p[0]*m0[6] + p[3]*m0[7]  + p[6]*m0[8];
+            m1[7]  = p[1]*m0[6] + p[4]*m0[7]  + p[7]*m0[8];
+            m1[8]  = p[2]*m0[6] + p[5]*m0[7]  + p[8]*m0[8];
+            m1[9]  = p[0]*m0[9] + p[3]*m0[10] + p[6]*m0[11] + p[9];
+            m1[10] = p[1]*m0[9] + p[4]*m0[10] + p[7]*m0[11] + p[10];
+            m1[11] = p[2]*m0[9] + p[5]*m0[10] + p[8]*m0[11] + p[11];
+            m = m1;
+        }
+        else {
+            m = m0;
+        }
+        animVec* dst = &tmpBoneMatrices[boneIndex * 12];
+        for (int i = 0; i < 12; i++) {
+            dst[i] = m[i];
+            ib[i] = animVecSet(invBindPose[boneIndex * 12 + i]);
+        }
+
+        // multiply with inverse bind pose matrix into transposed skin matrices
+        animVec r[12];
+        r[0]  = m[0]*ib[0] + m[3]*ib[1]  + m[6]*ib[2];
+        r[1]  = m[0]*ib[3] + m[3]*ib[4]  + m[6]*ib[5];
+        r[2]  = m[0]*ib[6] + m[3]*ib[7]  + m[6]*ib[8];
+        r[3]  = m[0]*ib[9] + m[3]*ib[10] + m[6]*ib[11] + m[9];
+        r[4]  = m[1]*ib[0] + m[4]*ib[1]  + m[7]*ib[2];
+        r[5]  = m[1]*ib[3] + m[4]*ib[4]  + m[7]*ib[5];
+        r[6]  = m[1]*ib[6] + m[4]*ib[7]  + m[7]*ib[8];
+        r[7]  = m[1]*ib[9] + m[4]*ib[10] + m[7]*ib[11] + m[10];
+        r[8]  = m[2]*ib[0] + m[5]*ib[1]  + m[8]*ib[2];
+        r[9]  = m[2]*ib[3] + m[5]*ib[4]  + m[8]*ib[5];
+        r[10] = m[2]*ib[6] + m[5]*ib[7]  + m[8]*ib[8];
+        r[11] = m[2]*ib[9] + m[5]*ib[10] + m[8]*ib[11] + m[11];
+        if (dualQuat) {
+            for (int i = 0; i < 12; i++) {
+                animVecStore(lanes, r[i]);
+                for (int l = 0; l < num; l++) {
+                    skin[l][i] = lanes[l];
+                }
+            }
+            for (int l = 0; l < num; l++) {
+                mx_to_dualquat(skin[l], &out[l][boneIndex * 8]);
+            }
+        }
+        else {
+            const int o = boneIndex * 12;
+            for (int i = 0; i < 12; i++) {
+                animVecStore(lanes, r[i]);
+                for (int l = 0; l < num; l++) {
+                    out[l][o + i] = lanes[l];
+                }
+            }
+        }
+    }
+    if (numBones < skel->NumBones) {
+        for (int l = 0; l < num; l++) {
+            copyLodBones(skel, numBones, out[l]);
+        }
+    }
+}
+#endif
+
+//------------------------------------------------------------------------------
+void
+animMgr::setBoneLod(animInstance* inst, int lodIndex) {
+    o_assert_dbg(inst && inst->skeleton);
+    o_assert_dbg((lodIndex >= 0) && (lodIndex < inst->skeleton->NumLods));
+    if (lodIndex != inst->boneLod) {
+        inst->boneLod = lodIndex;
+        inst->lodTailOutputs = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::playBaked(animInstance* inst, const AnimBake* bake, int clipIndex, float startTime) {
+    o_assert_dbg(inst && bake && inst->skeleton);
+    o_assert_dbg((bake->NumBones == inst->skeleton->NumBones) && (bake->SkinFormat == inst->skeleton->SkinFormat));
+    for (int i = 0; i < bake->Clips.Size(); i++) {
+        if (bake->Clips[i].ClipIndex == clipIndex) {
+            inst->bake = bake->Id;
+            inst->bakeClip = i;
+            inst->bakeStartTime = this->curTime + startTime;
+            return;
+        }
     }
+    o_warn("Anim::PlayBaked: clip %d has not been baked\n", clipIndex);
+}
+
+//------------------------------------------------------------------------------
+void
+animMgr::stopBaked(animInstance* inst) {
+    o_assert_dbg(inst);
+    inst->bake = Id::InvalidId();
 }
 
 //------------------------------------------------------------------------------
@@ -613,8 +2897,24 @@ animMgr::play(animInstance* inst, const AnimJob& job) {
     inst->sequencer.garbageCollect(this->curTime);
     AnimJobId jobId = ++this->curAnimJobId;
     const auto& clip = inst->library->Clips[job.ClipIndex];
+    if (inst->library->Streaming) {
+        this->keyCache.use(inst->library->Id.SlotIndex, job.ClipIndex);
+    }
+    if (clip.VariableRate && !inst->sequencer.keyCursors) {
+        // variable-rate clips cache their key positions per job and curve
+        const int numCurves = inst->library->CurveLayout.Size();
+        const int size = animSequencer::maxItems * numCurves * sizeof(uint16_t);
+        inst->sequencer.keyCursors = (uint16_t*) Memory::Alloc(size);
+        inst->sequencer.numCursorCurves = numCurves;
+        Memory::Clear(inst->sequencer.keyCursors, size);
+    }
+    const AnimMask* mask = nullptr;
+    if (job.Mask.IsValid()) {
+        mask = this->lookupMask(job.Mask);
+        o_assert_dbg(mask && (mask->SampleStride == inst->library->SampleStride));
+    }
     double clipDuration = clip.KeyDuration * clip.Length;
-    if (inst->sequencer.add(this->curTime, jobId, job, clipDuration)) {
+    if (inst->sequencer.add(this->curTime, jobId, job, clipDuration, mask)) {
         return jobId;
     }
     else {
@@ -7,8 +7,13 @@
 */
 #include "Resource/ResourceContainerBase.h"
 #include "Resource/ResourcePool.h"
+#include "Core/Containers/Buffer.h"
 #include "Anim/AnimTypes.h"
 #include "Anim/private/animInstance.h"
+#include "Anim/private/animWorkerPool.h"
+#include "Anim/private/animSampler.h"
+#include "Anim/private/animKeyCache.h"
+#include "Anim/private/animRangeAllocator.h"
 
 namespace Oryol {
 namespace _priv {
@@ -28,6 +33,14 @@ public:
 
     /// create an animation library
     Id createLibrary(const AnimLibrarySetup& setup);
+    /// create an animation library from AnimLibraryFormat data (keys are not copied)
+    Id createLibrary(const AnimLibraryDataSetup& setup);
+    /// create a streamed animation library from an AnimLibraryFormat file
+    Id createLibrary(const AnimLibraryStreamSetup& setup);
+    /// create an animation library from validated AnimLibraryFormat data (keyData is nullptr for streamed libraries)
+    Id createLibraryFromData(const Locator& locator, const uint8_t* data, int16_t* keyData);
+    /// append an animation library in AnimLibraryFormat at the next aligned buffer offset, return false on error
+    bool saveLibrary(const AnimLibrary* lib, Buffer& outData);
     /// lookup pointer to an animation library
     AnimLibrary* lookupLibrary(const Id& resId);
     /// destroy an animation library
@@ -40,6 +53,20 @@ public:
     /// destroy a skeleton
     void destroySkeleton(const Id& resId);
 
+    /// bake the skin matrices of library clips on a skeleton
+    Id createBake(const AnimBakeSetup& setup);
+    /// lookup pointer to baked skin matrices
+    AnimBake* lookupBake(const Id& resId);
+    /// destroy baked skin matrices
+    void destroyBake(const Id& resId);
+
+    /// create a curve mask
+    Id createMask(const AnimMaskSetup& setup);
+    /// lookup pointer to a curve mask
+    AnimMask* lookupMask(const Id& resId);
+    /// destroy a curve mask
+    void destroyMask(const Id& resId);
+
     /// create an animation instance
     Id createInstance(const AnimInstanceSetup& setup);
     /// lookup pointer to an animation instance
@@ -47,25 +74,86 @@ public:
     /// destroy an animation instance
     void destroyInstance(const Id& resId);
 
-    /// remove a range of keys from key pool and fixup indices in curves and clips
+    /// allocate the clip, curve and key ranges for a new library
+    bool allocLibraryRanges(int numClips, int numCurves, int numKeys, int& outClipIndex, int& outCurveIndex, int& outKeyIndex);
+    /// warn about a failed pool allocation, and count it if it only failed because of fragmentation
+    void warnAllocFailed(const char* poolName, const animRangeAllocator& allocator, int num);
+    /// release a range of keys to the key pool
     void removeKeys(Slice<int16_t> keyRange);
-    /// remove a range of curves from curve pool, and fixup clips
+    /// release a range of curves to the curve pool
     void removeCurves(Slice<AnimCurve> curveRange);
-    /// remove a range of clips from clip pool, and fixup libraries
+    /// release a range of clips to the clip pool
     void removeClips(Slice<AnimClip> clipRange);
-    /// remove a range of matrices from the matrix pool
+    /// release a range of matrices to the matrix pool
     void removeMatrices(Slice<glm::mat4x3> matrixRange);
 
     /// write animition library keys
     void writeKeys(AnimLibrary* lib, const uint8_t* ptr, int numBytes);
+    /// turn constant curves static and remove their keys, return true if any were found
+    bool detectStaticCurves(AnimLibrary* lib);
+    /// convert the clips of a library to variable-rate keys where this saves memory
+    void reduceKeys(AnimLibrary* lib);
+    /// pack the key blocks of a library's clips and release unused keys to the key pool
+    void compactKeys(AnimLibrary* lib);
 
     /// begin a new frame, resets the active instances
     void newFrame();
-    /// add an active instance for the current frame
-    bool addActiveInstance(animInstance* inst);
+    /// load and evict key blocks of streamed libraries
+    void updateStreaming();
+    /// add an active instance for the current frame (updateInterval 0: use the instance's interval)
+    bool addActiveInstance(animInstance* inst, int updateInterval=0);
+    /// allocate the persistent samples and skin matrix table slots of an instance,
+    /// on failure outSkinTableFull tells whether the skin matrix table or the sample pool had no room
+    bool allocSlots(animInstance* inst, bool& outSkinTableFull);
+    /// free the persistent slots of an instance
+    void freeSlots(animInstance* inst);
+    /// allocate a new skin matrix table page, return false if MaxNumSkinMatrixPages is reached
+    bool allocSkinPage();
+    /// pointer to the skin matrix table slot of an instance in an output buffer
+    float* skinSlot(const animInstance* inst, int outputIndex) const;
+    /// free the slots of all instances which were last active before a frame
+    void releaseSlots(uint32_t minActiveFrame);
+    /// gather the skin matrix table rows written in the current frame
+    void gatherDirtyRows();
+    /// make an output buffer the current output
+    void selectOutput(int outputIndex);
+    /// copy the pose of an instance from the previous frame's output buffer
+    void copyPrevPose(animInstance* inst);
+    /// copy the shared poses of aliasing instances into their own slots
+    void copySharedPoses(int begin, int end);
+    /// acquire the output of the most recently evaluated frame, return output index
+    int acquireOutput();
+    /// release an acquired frame output
+    void releaseOutput(int outputIndex);
+    /// assign a balanced update phase to an instance (interval 1 releases the phase)
+    void assignUpdatePhase(animInstance* inst, int interval);
+    /// record the pose of an evaluated instance, or restore the pose of a skipped instance
+    void updateHistory(animInstance* inst);
     /// evaluate all active instances, and reset active instance array
     void evaluate(double frameDurationInSeconds);
+    /// evaluate a range of active instances (called from worker threads)
+    void evaluateRange(int begin, int end, int chunkIndex, int participant);
+    /// unpack the half-float samples of instances in a range into per-thread scratch memory
+    void unpackHalfSamples(int begin, int end, int participant);
+    /// pack the evaluated samples of half-float sample instances in a range
+    void packHalfSamples(int begin, int end);
+    /// convert the skin matrices of an instance into the half-float skin matrix table
+    void storeHalfSkinMatrices(const animInstance* inst);
+    /// update the frame statistics at the end of evaluate()
+    void updateFrameStats(Duration prepareTime, Duration evaluateTime);
+    /// let active instances with identical anim jobs share one evaluation
+    void sharePoses();
+    /// skip evaluation of active instances whose pose didn't change since the previous frame
+    void skipUnchanged();
 
+    /// set the skeleton bone LOD level of an instance
+    void setBoneLod(animInstance* inst, int lodIndex);
+    /// play a baked clip on an instance instead of evaluating it
+    void playBaked(animInstance* inst, const AnimBake* bake, int clipIndex, float startTime);
+    /// stop playing a baked clip
+    void stopBaked(animInstance* inst);
+    /// copy the current baked frame into the skin matrices of an instance
+    void copyBakedFrame(animInstance* inst);
     /// start an animation on an instance (active or inactive)
     AnimJobId play(animInstance* inst, const AnimJob& job);
     /// stop a specific anim job
@@ -75,38 +163,94 @@ public:
     /// stop all anim jobs
     void stopAll(animInstance* inst, bool allowFadeOut);
 
-    /// generate the skinning matrices for animInstance
-    void genSkinMatrices(animInstance* inst);
+    /// generate the skinning matrices for animInstance (from the samples, or the keys of a fused evaluation)
+    void genSkinMatrices(animInstance* inst, int participant=0);
+    /// generate skinning matrices for a range of active instances, batching identical skeletons
+    void genSkinMatricesRange(int begin, int end, int participant);
+    #if ORYOL_ANIM_USE_SIMD_LANES
+    /// generate skinning matrices for up to animVecLanes instances with the same skeleton
+    void genSkinMatricesBatch(animInstance* const* insts, int num, int participant);
+    #endif
 
     static const Id::TypeT resTypeLib = 1;
     static const Id::TypeT resTypeSkeleton = 2;
     static const Id::TypeT resTypeInstance = 3;
+    static const Id::TypeT resTypeMask = 4;
+    static const Id::TypeT resTypeBake = 5;
 
     AnimSetup animSetup;
     bool isValid = false;
     bool inFrame = false;
     double curTime = 0.0;
+    uint32_t frameIndex = 0;
     uint32_t curAnimJobId = 0;
     ResourceContainerBase resContainer;
     ResourcePool<AnimLibrary> libPool;
+    Array<animSamplePlan> samplePlans;  // indexed by library slot index
     ResourcePool<AnimSkeleton> skelPool;
     ResourcePool<animInstance> instPool;
+    ResourcePool<AnimMask> maskPool;
+    ResourcePool<AnimBake> bakePool;
     Array<AnimClip> clipPool;
     Array<AnimCurve> curvePool;
     Array<glm::mat4x3> matrixPool;
+    animRangeAllocator clipAllocator;
+    animRangeAllocator curveAllocator;
+    animRangeAllocator matrixAllocator;
+    animRangeAllocator keyAllocator;
     Array<animInstance*> activeInstances;
-    AnimSkinMatrixInfo skinMatrixInfo;
-    int numKeys = 0;
+    int numEvaluatedInstances = 0;
+    Array<int> poseCacheSlots;      // open-addressing hash table of active instance indices
+    int numPoseCacheHits = 0;
+    int numPoseCacheMisses = 0;
+    int numUnchangedInstances = 0;
+    /// statistics collected by one chunk of evaluateRange()
+    struct chunkStats {
+        animSequencer::evalStats eval;
+        Duration gcTime;
+        Duration sampleTime;
+        Duration skinTime;
+        Duration copyTime;
+    };
+    Array<chunkStats> evalChunkStats;   // one per evaluation chunk
+    AnimFrameStats frameStats;
+    uint32_t keysVersion = 0;       // incremented when keys of a library are overwritten
+    int phaseLoad[AnimConfig::MaxUpdateInterval] = { };  // number of instances evaluated in each phase slot
+    animWorkerPool workerPool;
+    animKeyCache keyCache;
+    struct output {
+        AnimSkinMatrixInfo skinMatrixInfo;
+        int numAcquired = 0;
+    };
+    Array<output> outputs;          // one per output buffer
+    int curOutput = 0;              // output buffer of the current frame
+    int prevOutput = 0;             // output buffer of the previous frame
+    int readyOutput = InvalidIndex; // output buffer of the most recently evaluated frame
+    AnimSkinMatrixInfo* skinMatrixInfo = nullptr;   // skin matrix info of the current output
     Slice<int16_t> keys;
     int16_t* keyPool;
-    int numSamples = 0;
-    Slice<float> samples;
+    Slice<float> samples;           // sample pool view of the current output
     float* samplePool = nullptr;
-    int curSkinMatrixTableX = 0;
-    int curSkinMatrixTableY = 0;
+    animRangeAllocator sampleAllocator;
+    Array<animInstance*> slotInstances;             // instances which own persistent slots
+    Array<uint8_t> skinRowDirty;                    // scratch flags for gatherDirtyRows()
     int skinMatrixTableStride = 0;  // in number of floats
-    Slice<float> skinMatrixTable;
-    float* skinMatrixPool = nullptr;
+    int skinMatrixTableNumFloats = 0;   // size of one page of one output in number of floats
+    /// a skin matrix table page, with one table per output buffer
+    struct skinPage {
+        float* pool = nullptr;
+        uint16_t* halfPool = nullptr;   // half-float tables (optional)
+        Array<animRangeAllocator> rowAllocators;    // one per row, in pixels
+    };
+    Array<skinPage> skinPages;
+    /// per-thread scratch memory for unpacked half-float samples and skeleton bone matrices
+    struct evalScratch {
+        float* samples = nullptr;
+        int capacity = 0;
+        float* boneMatrices = nullptr;  // 32-byte aligned bone matrices of genSkinMatrices()
+        void* boneAlloc = nullptr;
+    };
+    evalScratch evalScratches[animWorkerPool::MaxNumThreads + 1];
 };
 
 } // namespace _priv
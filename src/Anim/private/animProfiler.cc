@@ -0,0 +1,139 @@
+//------------------------------------------------------------------------------
+//  animProfiler.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "animProfiler.h"
+#include "Core/Memory/Memory.h"
+#include <stdio.h>
+
+namespace Oryol {
+namespace _priv {
+
+#if ORYOL_ANIM_PROFILING
+namespace {
+    // the rings are never freed, since threads keep a pointer to their ring
+    std::atomic<int> numRegistered{0};
+    std::atomic<animProfiler::ring*> rings[animProfiler::MaxNumThreads];
+    thread_local animProfiler::ring* threadRing = nullptr;
+    thread_local bool threadRegistered = false;
+}
+
+//------------------------------------------------------------------------------
+void
+animProfiler::record(const char* name, int64_t begin, int64_t end) {
+    if (!threadRegistered) {
+        threadRegistered = true;
+        const int index = numRegistered.fetch_add(1);
+        if (index < MaxNumThreads) {
+            threadRing = Memory::New<ring>();
+            rings[index].store(threadRing, std::memory_order_release);
+        }
+        else {
+            o_warn("Anim: too many threads for profiling, zones of this thread are dropped\n");
+        }
+    }
+    ring* r = threadRing;
+    if (r) {
+        const uint32_t head = r->head.load(std::memory_order_relaxed);
+        event& e = r->events[head & (RingSize - 1)];
+        e.name = name;
+        e.begin = begin;
+        e.end = end;
+        r->head.store(head + 1, std::memory_order_release);
+    }
+}
+
+//------------------------------------------------------------------------------
+int
+animProfiler::numEvents() {
+    int num = 0;
+    for (int i = 0; i < MaxNumThreads; i++) {
+        const ring* r = rings[i].load(std::memory_order_acquire);
+        if (r) {
+            const uint32_t head = r->head.load(std::memory_order_acquire);
+            num += head < uint32_t(RingSize) ? int(head) : RingSize;
+        }
+    }
+    return num;
+}
+
+//------------------------------------------------------------------------------
+void
+animProfiler::reset() {
+    for (int i = 0; i < MaxNumThreads; i++) {
+        ring* r = rings[i].load(std::memory_order_acquire);
+        if (r) {
+            r->head.store(0, std::memory_order_release);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+bool
+animProfiler::writeChromeTrace(const char* path) {
+    o_assert_dbg(path);
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        o_warn("Anim: failed to open profile trace file '%s'\n", path);
+        return false;
+    }
+    // timestamps are written in microseconds relative to the earliest zone
+    bool first = true;
+    int64_t base = 0;
+    for (int i = 0; i < MaxNumThreads; i++) {
+        const ring* r = rings[i].load(std::memory_order_acquire);
+        if (r) {
+            const uint32_t head = r->head.load(std::memory_order_acquire);
+            const uint32_t num = head < uint32_t(RingSize) ? head : uint32_t(RingSize);
+            for (uint32_t n = head - num; n != head; n++) {
+                const event& e = r->events[n & (RingSize - 1)];
+                if (first || (e.begin < base)) {
+                    base = e.begin;
+                    first = false;
+                }
+            }
+        }
+    }
+    fprintf(fp, "{\"traceEvents\":[");
+    first = true;
+    for (int i = 0; i < MaxNumThreads; i++) {
+        const ring* r = rings[i].load(std::memory_order_acquire);
+        if (r) {
+            const uint32_t head = r->head.load(std::memory_order_acquire);
+            const uint32_t num = head < uint32_t(RingSize) ? head : uint32_t(RingSize);
+            for (uint32_t n = head - num; n != head; n++) {
+                const event& e = r->events[n & (RingSize - 1)];
+                const double ts = TimePoint(e.begin).Since(TimePoint(base)).AsMicroSeconds();
+                const double dur = TimePoint(e.end).Since(TimePoint(e.begin)).AsMicroSeconds();
+                fprintf(fp, "%s\n{\"name\":\"%s\",\"cat\":\"Anim\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%d}",
+                    first ? "" : ",", e.name, ts, dur, i);
+                first = false;
+            }
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    const bool success = (0 == ferror(fp));
+    fclose(fp);
+    if (!success) {
+        o_warn("Anim: failed to write profile trace file '%s'\n", path);
+    }
+    return success;
+}
+
+#else
+//------------------------------------------------------------------------------
+void
+animProfiler::reset() {
+    // empty
+}
+
+//------------------------------------------------------------------------------
+bool
+animProfiler::writeChromeTrace(const char* path) {
+    o_warn("Anim: profiling zones are not compiled in (cmake option ORYOL_ANIM_PROFILING)\n");
+    return false;
+}
+#endif
+
+} // namespace _priv
+} // namespace Oryol
@@ -0,0 +1,82 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::_priv::animProfiler
+    @ingroup _priv
+    @brief hot-path profiling zones with Chrome trace export
+
+    Profiling zones are only compiled in if ORYOL_ANIM_PROFILING is 1
+    (cmake option ORYOL_ANIM_PROFILING), otherwise ORYOL_ANIM_ZONE()
+    expands to nothing and writeChromeTrace() fails.
+
+    Each thread records its zones into its own ring buffer, which is
+    created when the thread records its first zone, so recording a zone
+    doesn't take a lock or touch any state shared with other threads.
+    When a ring is full, the oldest zones are overwritten. The recorded
+    zones should be written between frames, when no other thread is
+    recording zones.
+*/
+#include "Core/Types.h"
+
+#ifndef ORYOL_ANIM_PROFILING
+#define ORYOL_ANIM_PROFILING (0)
+#endif
+#if ORYOL_ANIM_PROFILING
+#include "Core/Time/Clock.h"
+#include <atomic>
+#endif
+
+#if ORYOL_ANIM_PROFILING
+#define _ORYOL_ANIM_ZONE_NAME2(line) _animZone##line
+#define _ORYOL_ANIM_ZONE_NAME(line) _ORYOL_ANIM_ZONE_NAME2(line)
+/// record a profiling zone until the end of the current scope (name must be a string literal)
+#define ORYOL_ANIM_ZONE(name) Oryol::_priv::animProfiler::zone _ORYOL_ANIM_ZONE_NAME(__LINE__)(name)
+#else
+#define ORYOL_ANIM_ZONE(name)
+#endif
+
+namespace Oryol {
+namespace _priv {
+
+class animProfiler {
+public:
+    /// write the recorded zones of all threads as Chrome trace event JSON file
+    static bool writeChromeTrace(const char* path);
+    /// discard all recorded zones
+    static void reset();
+
+    #if ORYOL_ANIM_PROFILING
+    /// max number of threads which can record zones
+    static const int MaxNumThreads = 64;
+    /// number of zones per thread (must be power of 2)
+    static const int RingSize = 16 * 1024;
+
+    /// a recorded zone
+    struct event {
+        const char* name = nullptr;
+        int64_t begin = 0;
+        int64_t end = 0;
+    };
+    /// per-thread ring buffer, only written by its owner thread
+    struct ring {
+        std::atomic<uint32_t> head{0};  // number of zones recorded so far
+        event events[RingSize];
+    };
+    /// a scoped zone
+    struct zone {
+        zone(const char* name_) : name(name_), begin(Clock::Now().getRaw()) { }
+        ~zone() {
+            animProfiler::record(this->name, this->begin, Clock::Now().getRaw());
+        }
+        const char* name;
+        int64_t begin;
+    };
+    /// record a finished zone into the calling thread's ring
+    static void record(const char* name, int64_t begin, int64_t end);
+    /// number of zones currently held by all rings
+    static int numEvents();
+    #endif
+};
+
+} // namespace _priv
+} // namespace Oryol
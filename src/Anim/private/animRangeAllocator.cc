@@ -0,0 +1,142 @@
+//------------------------------------------------------------------------------
+//  animRangeAllocator.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "animRangeAllocator.h"
+
+namespace Oryol {
+namespace _priv {
+
+//------------------------------------------------------------------------------
+void
+animRangeAllocator::setup(int capacity_) {
+    o_assert_dbg(capacity_ >= 0);
+    this->capacity = capacity_;
+    this->numUsed = 0;
+    this->freeRanges.Clear();
+    if (capacity_ > 0) {
+        range& r = this->freeRanges.Add();
+        r.offset = 0;
+        r.num = capacity_;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animRangeAllocator::discard() {
+    this->freeRanges.Clear();
+    this->capacity = 0;
+    this->numUsed = 0;
+}
+
+//------------------------------------------------------------------------------
+int
+animRangeAllocator::alloc(int num) {
+    o_assert_dbg(num >= 0);
+    if (0 == num) {
+        return 0;
+    }
+    // best fit: find the smallest free range which is big enough
+    int best = InvalidIndex;
+    for (int i = 0; i < this->freeRanges.Size(); i++) {
+        const range& r = this->freeRanges[i];
+        if ((r.num >= num) && ((InvalidIndex == best) || (r.num < this->freeRanges[best].num))) {
+            best = i;
+            if (r.num == num) {
+                break;
+            }
+        }
+    }
+    if (InvalidIndex == best) {
+        return InvalidIndex;
+    }
+    range& r = this->freeRanges[best];
+    const int offset = r.offset;
+    if (r.num == num) {
+        this->freeRanges.Erase(best);
+    }
+    else {
+        r.offset += num;
+        r.num -= num;
+    }
+    this->numUsed += num;
+    return offset;
+}
+
+//------------------------------------------------------------------------------
+void
+animRangeAllocator::free(int offset, int num) {
+    o_assert_dbg((offset >= 0) && (num >= 0) && ((offset + num) <= this->capacity));
+    if (0 == num) {
+        return;
+    }
+    // find the first free range after the freed range
+    int lo = 0;
+    int hi = this->freeRanges.Size();
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (this->freeRanges[mid].offset < offset) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    const int index = lo;
+    o_assert_dbg((index == this->freeRanges.Size()) || ((offset + num) <= this->freeRanges[index].offset));
+    o_assert_dbg((index == 0) || ((this->freeRanges[index-1].offset + this->freeRanges[index-1].num) <= offset));
+
+    // coalesce with the previous and/or next free range
+    const bool mergePrev = (index > 0) && ((this->freeRanges[index-1].offset + this->freeRanges[index-1].num) == offset);
+    const bool mergeNext = (index < this->freeRanges.Size()) && (this->freeRanges[index].offset == (offset + num));
+    if (mergePrev && mergeNext) {
+        this->freeRanges[index-1].num += num + this->freeRanges[index].num;
+        this->freeRanges.Erase(index);
+    }
+    else if (mergePrev) {
+        this->freeRanges[index-1].num += num;
+    }
+    else if (mergeNext) {
+        this->freeRanges[index].offset = offset;
+        this->freeRanges[index].num += num;
+    }
+    else {
+        range r;
+        r.offset = offset;
+        r.num = num;
+        this->freeRanges.Insert(index, r);
+    }
+    this->numUsed -= num;
+    o_assert_dbg(this->numUsed >= 0);
+}
+
+//------------------------------------------------------------------------------
+int
+animRangeAllocator::largestFree() const {
+    int largest = 0;
+    for (const range& r : this->freeRanges) {
+        if (r.num > largest) {
+            largest = r.num;
+        }
+    }
+    return largest;
+}
+
+//------------------------------------------------------------------------------
+int
+animRangeAllocator::smallestFit(int num) const {
+    o_assert_dbg(num > 0);
+    int fit = 0;
+    for (const range& r : this->freeRanges) {
+        if ((r.num >= num) && ((0 == fit) || (r.num < fit))) {
+            fit = r.num;
+            if (r.num == num) {
+                break;
+            }
+        }
+    }
+    return fit;
+}
+
+} // namespace _priv
+} // namespace Oryol
@@ -0,0 +1,46 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::_priv::animRangeAllocator
+    @ingroup _priv
+    @brief free-list allocator for ranges of pool elements
+
+    Manages the element ranges of a fixed-capacity pool (keys, curves,
+    clips or matrices). Free ranges are kept sorted by offset and are
+    coalesced with their neighbours when freed, allocation picks the
+    smallest free range which fits. Allocated elements never move, so
+    freeing a range doesn't require to fix up any array views into
+    the pool. A part of an allocated range can be freed on its own.
+*/
+#include "Core/Types.h"
+#include "Core/Containers/Array.h"
+
+namespace Oryol {
+namespace _priv {
+
+class animRangeAllocator {
+public:
+    /// setup with the pool capacity
+    void setup(int capacity);
+    /// discard the allocator
+    void discard();
+    /// allocate a range of num elements, return offset or InvalidIndex
+    int alloc(int num);
+    /// free a range of elements
+    void free(int offset, int num);
+    /// return the size of the largest free range
+    int largestFree() const;
+    /// return the size of the free range alloc(num) would pick, or 0 if none fits
+    int smallestFit(int num) const;
+
+    struct range {
+        int offset = 0;
+        int num = 0;
+    };
+    Array<range> freeRanges;    // sorted by offset
+    int capacity = 0;
+    int numUsed = 0;
+};
+
+} // namespace _priv
+} // namespace Oryol
@@ -0,0 +1,353 @@
+//------------------------------------------------------------------------------
+//  animSampler.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "animSampler.h"
+#include <math.h>
+
+namespace Oryol {
+namespace _priv {
+
+//------------------------------------------------------------------------------
+void
+animSamplePlan::clear() {
+    this->layout = Generic;
+    this->spans.Clear();
+    this->values.Clear();
+    this->laneKeys.Clear();
+    this->fallback.Clear();
+    this->laneCurves.Clear();
+    this->clips.Clear();
+}
+
+//------------------------------------------------------------------------------
+animSamplePlan::layoutKind
+animSamplePlan::matchLayout(const AnimLibrary& lib) {
+    const int numCurves = lib.CurveLayout.Size();
+    if ((0 == numCurves) || (0 != (numCurves % 3))) {
+        return Generic;
+    }
+    for (int i = 0; i < numCurves; i += 3) {
+        if ((AnimCurveFormat::Float3 != lib.CurveLayout[i]) ||
+            (AnimCurveFormat::Quaternion != lib.CurveLayout[i+1]) ||
+            (AnimCurveFormat::Float3 != lib.CurveLayout[i+2]))
+        {
+            return Generic;
+        }
+    }
+    return TRS;
+}
+
+//------------------------------------------------------------------------------
+void
+animSamplePlan::build(const AnimLibrary& lib) {
+    this->clear();
+    this->layout = matchLayout(lib);
+    this->clips.Reserve(lib.Clips.Size());
+    this->values.Reserve(lib.Clips.Size() * lib.SampleStride);
+    this->laneKeys.Reserve(lib.Clips.Size() * lib.SampleStride);
+    this->fallback.Reserve(lib.Clips.Size() * lib.SampleStride);
+    this->laneCurves.Reserve(lib.SampleStride + 1);
+    for (int curveIndex = 0; curveIndex < lib.CurveLayout.Size(); curveIndex++) {
+        for (int i = 0; i < AnimCurveFormat::Stride(lib.CurveLayout[curveIndex]); i++) {
+            this->laneCurves.Add(uint16_t(curveIndex));
+        }
+    }
+    this->laneCurves.Add(uint16_t(lib.CurveLayout.Size()));
+    o_assert_dbg(this->laneCurves.Size() == (lib.SampleStride + 1));
+    for (const AnimClip& clip : lib.Clips) {
+        clipPlan& cp = this->clips.Add();
+        cp.firstSpan = this->spans.Size();
+        cp.firstValue = this->values.Size();
+        cp.laneSampled = !clip.VariableRate;
+        int dstIndex = 0;
+        for (int curveIndex = 0; curveIndex < clip.Curves.Size(); curveIndex++) {
+            const AnimCurve& curve = clip.Curves[curveIndex];
+            uint16_t kind = Static;
+            if (!curve.Static) {
+                if (clip.VariableRate) {
+                    kind = VariableKeys;
+                }
+                else if (AnimCurveFormat::IsPacked(curve.Format)) {
+                    kind = PackedKeys;
+                }
+                else {
+                    kind = Keys;
+                }
+            }
+            for (int i = 0; i < curve.NumValues; i++) {
+                this->values.Add(curve.Static ? curve.StaticValue[i] : curve.Magnitude[i]);
+                this->fallback.Add(curve.StaticValue[i]);
+                this->laneKeys.Add((Keys == kind) ? uint16_t(curve.KeyIndex + i) : StaticLane);
+            }
+            if ((Static != kind) && (Keys != kind)) {
+                cp.laneSampled = false;
+            }
+            // merge with the previous span if possible, keyed curves
+            // are tightly packed in the key row, so their key
+            // indices are always contiguous
+            const bool mergeable = (Static == kind) || (Keys == kind);
+            if ((this->spans.Size() > cp.firstSpan) && (this->spans.Back().kind == kind) && mergeable) {
+                this->spans.Back().num += curve.NumValues;
+            }
+            else {
+                span& s = this->spans.Add();
+                s.kind = kind;
+                s.num = curve.NumValues;
+                s.dstIndex = dstIndex;
+                s.keyIndex = ((Keys == kind) || (PackedKeys == kind)) ? curve.KeyIndex : 0;
+                s.curveIndex = curveIndex;
+            }
+            dstIndex += curve.NumValues;
+        }
+        o_assert_dbg(dstIndex == lib.SampleStride);
+        cp.numSpans = this->spans.Size() - cp.firstSpan;
+    }
+}
+
+//------------------------------------------------------------------------------
+static inline float
+unpack(int16_t p, float m) {
+    return float(p) * m;
+}
+
+#if ORYOL_ANIM_USE_AVX2
+//------------------------------------------------------------------------------
+static inline __m256
+unpack8(const int16_t* src, const float* mag) {
+    __m256i k = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)src));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(k), _mm256_loadu_ps(mag));
+}
+#elif ORYOL_ANIM_USE_SSE
+//------------------------------------------------------------------------------
+static inline void
+unpack8(const int16_t* src, const float* mag, __m128& lo, __m128& hi) {
+    // sign-extend 8 int16 to 2x4 int32 by unpacking into the high halves
+    __m128i k = _mm_loadu_si128((const __m128i*)src);
+    lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(k, k), 16));
+    hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(k, k), 16));
+    lo = _mm_mul_ps(lo, _mm_loadu_ps(mag));
+    hi = _mm_mul_ps(hi, _mm_loadu_ps(mag + 4));
+}
+#endif
+
+//------------------------------------------------------------------------------
+void
+animSampler::sample(const int16_t* src0, const int16_t* src1, const float* mag, float keyPos, float* dst, int num) {
+    int i = 0;
+    #if ORYOL_ANIM_USE_AVX2
+    const __m256 kp = _mm256_set1_ps(keyPos);
+    for (; (i + 8) <= num; i += 8) {
+        __m256 v0 = unpack8(src0 + i, mag + i);
+        __m256 v1 = unpack8(src1 + i, mag + i);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(v0, _mm256_mul_ps(_mm256_sub_ps(v1, v0), kp)));
+    }
+    #elif ORYOL_ANIM_USE_SSE
+    const __m128 kp = _mm_set1_ps(keyPos);
+    for (; (i + 8) <= num; i += 8) {
+        __m128 v0lo, v0hi, v1lo, v1hi;
+        unpack8(src0 + i, mag + i, v0lo, v0hi);
+        unpack8(src1 + i, mag + i, v1lo, v1hi);
+        _mm_storeu_ps(dst + i, _mm_add_ps(v0lo, _mm_mul_ps(_mm_sub_ps(v1lo, v0lo), kp)));
+        _mm_storeu_ps(dst + i + 4, _mm_add_ps(v0hi, _mm_mul_ps(_mm_sub_ps(v1hi, v0hi), kp)));
+    }
+    #endif
+    for (; i < num; i++) {
+        const float v0 = unpack(src0[i], mag[i]);
+        const float v1 = unpack(src1[i], mag[i]);
+        dst[i] = v0 + (v1 - v0) * keyPos;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animSampler::sampleMix(const int16_t* src0, const int16_t* src1, const float* mag, float keyPos, float weight, float* dst, int num) {
+    int i = 0;
+    #if ORYOL_ANIM_USE_AVX2
+    const __m256 kp = _mm256_set1_ps(keyPos);
+    const __m256 w = _mm256_set1_ps(weight);
+    for (; (i + 8) <= num; i += 8) {
+        __m256 v0 = unpack8(src0 + i, mag + i);
+        __m256 v1 = unpack8(src1 + i, mag + i);
+        __m256 s1 = _mm256_add_ps(v0, _mm256_mul_ps(_mm256_sub_ps(v1, v0), kp));
+        __m256 s0 = _mm256_loadu_ps(dst + i);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(s0, _mm256_mul_ps(_mm256_sub_ps(s1, s0), w)));
+    }
+    #elif ORYOL_ANIM_USE_SSE
+    const __m128 kp = _mm_set1_ps(keyPos);
+    const __m128 w = _mm_set1_ps(weight);
+    for (; (i + 8) <= num; i += 8) {
+        __m128 v0lo, v0hi, v1lo, v1hi;
+        unpack8(src0 + i, mag + i, v0lo, v0hi);
+        unpack8(src1 + i, mag + i, v1lo, v1hi);
+        __m128 s1lo = _mm_add_ps(v0lo, _mm_mul_ps(_mm_sub_ps(v1lo, v0lo), kp));
+        __m128 s1hi = _mm_add_ps(v0hi, _mm_mul_ps(_mm_sub_ps(v1hi, v0hi), kp));
+        __m128 s0lo = _mm_loadu_ps(dst + i);
+        __m128 s0hi = _mm_loadu_ps(dst + i + 4);
+        _mm_storeu_ps(dst + i, _mm_add_ps(s0lo, _mm_mul_ps(_mm_sub_ps(s1lo, s0lo), w)));
+        _mm_storeu_ps(dst + i + 4, _mm_add_ps(s0hi, _mm_mul_ps(_mm_sub_ps(s1hi, s0hi), w)));
+    }
+    #endif
+    for (; i < num; i++) {
+        const float v0 = unpack(src0[i], mag[i]);
+        const float v1 = unpack(src1[i], mag[i]);
+        const float s0 = dst[i];
+        const float s1 = v0 + (v1 - v0) * keyPos;
+        dst[i] = s0 + (s1 - s0) * weight;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animSampler::copy(const float* values, float* dst, int num) {
+    for (int i = 0; i < num; i++) {
+        dst[i] = values[i];
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animSampler::copyMix(const float* values, float weight, float* dst, int num) {
+    int i = 0;
+    #if ORYOL_ANIM_USE_AVX2
+    const __m256 w = _mm256_set1_ps(weight);
+    for (; (i + 8) <= num; i += 8) {
+        __m256 s0 = _mm256_loadu_ps(dst + i);
+        __m256 s1 = _mm256_loadu_ps(values + i);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(s0, _mm256_mul_ps(_mm256_sub_ps(s1, s0), w)));
+    }
+    #elif ORYOL_ANIM_USE_SSE
+    const __m128 w = _mm_set1_ps(weight);
+    for (; (i + 4) <= num; i += 4) {
+        __m128 s0 = _mm_loadu_ps(dst + i);
+        __m128 s1 = _mm_loadu_ps(values + i);
+        _mm_storeu_ps(dst + i, _mm_add_ps(s0, _mm_mul_ps(_mm_sub_ps(s1, s0), w)));
+    }
+    #endif
+    for (; i < num; i++) {
+        const float s0 = dst[i];
+        const float s1 = values[i];
+        dst[i] = s0 + (s1 - s0) * weight;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    48-bit smallest-three quaternions store the 3 smallest components
+    in the upper 15 bits of each key element, the low bits of the
+    first 2 elements hold the index of the omitted largest component,
+    which is always positive and reconstructed from the unit length.
+*/
+static const float quat48Scale = 0.70710678f / 16383.0f;
+
+//------------------------------------------------------------------------------
+void
+animSampler::decode(const AnimCurve& curve, const int16_t* src, float* dst) {
+    switch (curve.Format) {
+        case AnimCurveFormat::FloatU8:
+        case AnimCurveFormat::Float2U8:
+        case AnimCurveFormat::Float3U8:
+        case AnimCurveFormat::Float4U8:
+            for (int i = 0; i < curve.NumValues; i++) {
+                const int q = (uint16_t(src[i >> 1]) >> ((i & 1) * 8)) & 0xFF;
+                dst[i] = curve.Offset[i] + float(q) * curve.Magnitude[i];
+            }
+            break;
+        case AnimCurveFormat::Quaternion48:
+            {
+                const int largest = (src[0] & 1) | ((src[1] & 1) << 1);
+                float sum = 0.0f;
+                int j = 0;
+                for (int i = 0; i < 4; i++) {
+                    if (i != largest) {
+                        const float c = float(src[j++] >> 1) * quat48Scale;
+                        dst[i] = c;
+                        sum += c * c;
+                    }
+                }
+                dst[largest] = sqrtf(sum < 1.0f ? 1.0f - sum : 0.0f);
+            }
+            break;
+        default:
+            for (int i = 0; i < curve.NumValues; i++) {
+                dst[i] = unpack(src[i], curve.Magnitude[i]);
+            }
+            break;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animSampler::decodePair(const AnimCurve& curve, const int16_t* src0, const int16_t* src1, float* dst0, float* dst1) {
+    decode(curve, src0, dst0);
+    decode(curve, src1, dst1);
+    if (AnimCurveFormat::Quaternion48 == curve.Format) {
+        // q and -q are the same rotation, but the encoding picks the
+        // sign, so make sure to interpolate along the short path
+        const float dot = dst0[0]*dst1[0] + dst0[1]*dst1[1] + dst0[2]*dst1[2] + dst0[3]*dst1[3];
+        if (dot < 0.0f) {
+            for (int i = 0; i < 4; i++) {
+                dst1[i] = -dst1[i];
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animSampler::sampleCurve(const AnimCurve& curve, const int16_t* src0, const int16_t* src1, float keyPos, float weight, bool mix, float* dst) {
+    float v0[4], v1[4];
+    decodePair(curve, src0, src1, v0, v1);
+    for (int i = 0; i < curve.NumValues; i++) {
+        const float s1 = v0[i] + (v1[i] - v0[i]) * keyPos;
+        if (mix) {
+            const float s0 = dst[i];
+            dst[i] = s0 + (s1 - s0) * weight;
+        }
+        else {
+            dst[i] = s1;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animSampler::encodeU8(const AnimCurve& curve, const float* values, int16_t* dst) {
+    o_assert_dbg(AnimCurveFormat::IsPacked(curve.Format) && (curve.Format != AnimCurveFormat::Quaternion48));
+    uint16_t packed[2] = { 0, 0 };
+    for (int i = 0; i < curve.NumValues; i++) {
+        int q = 0;
+        if (curve.Magnitude[i] > 0.0f) {
+            q = int(floorf((values[i] - curve.Offset[i]) / curve.Magnitude[i] + 0.5f));
+            q = q < 0 ? 0 : (q > 255 ? 255 : q);
+        }
+        packed[i >> 1] |= uint16_t(q << ((i & 1) * 8));
+    }
+    for (int i = 0; i < curve.KeyStride; i++) {
+        dst[i] = int16_t(packed[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animSampler::encodeQuat48(const float* quat, int16_t* dst) {
+    int largest = 0;
+    for (int i = 1; i < 4; i++) {
+        if (fabsf(quat[i]) > fabsf(quat[largest])) {
+            largest = i;
+        }
+    }
+    const float sign = quat[largest] < 0.0f ? -1.0f : 1.0f;
+    int j = 0;
+    for (int i = 0; i < 4; i++) {
+        if (i != largest) {
+            int v = int(floorf(sign * quat[i] / quat48Scale + 0.5f));
+            v = v < -16383 ? -16383 : (v > 16383 ? 16383 : v);
+            const int bit = (j < 2) ? ((largest >> j) & 1) : 0;
+            dst[j++] = int16_t(v * 2 + bit);
+        }
+    }
+}
+
+} // namespace _priv
+} // namespace Oryol
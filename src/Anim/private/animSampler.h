@@ -0,0 +1,135 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::_priv::animSampler
+    @ingroup _priv
+    @brief sampling kernels and per-library sampling plans
+
+    A sampling plan is built once per anim library and describes
+    each clip as a short list of spans. A span is a run of sample
+    lanes which are either all static or all keyed. Keyed lanes of
+    adjacent curves are contiguous both in the key table and in the
+    sample buffer, so they merge into a single span. Evaluation then
+    only dispatches once per span instead of branching on the curve
+    format and static flag per curve and value.
+
+    The plan also stores one float per sample lane: the static
+    value for static lanes, and the premultiplied key magnitude for
+    keyed lanes. A second set of values holds the static value of
+    every lane, this is sampled while the keys of a streamed clip are
+    not resident.
+
+    Variable-rate curves have their own key columns, and packed
+    formats (8-bit keys and 48-bit quaternions) can't be unpacked
+    lane by lane, so both get one span per curve.
+
+    The kernels are vectorized with AVX2 or SSE2 if available at
+    compile time and have a scalar fallback which computes the exact
+    same results.
+
+    The curve layout of the library is matched when the plan is built.
+    For the common TRS layout (Float3 translation, Quaternion rotation
+    and Float3 scale per bone), clips which only have static and
+    unpacked keyed curves can also be sampled bone by bone through
+    the per-lane key indices, which lets the skinning code build the
+    bone matrices straight from the keys without a sample buffer.
+*/
+#include "Core/Types.h"
+#include "Core/Containers/Array.h"
+#include "Anim/AnimTypes.h"
+#include "Anim/private/animSimd.h"
+
+namespace Oryol {
+namespace _priv {
+
+class animSamplePlan {
+public:
+    /// span types
+    enum spanKind : uint16_t {
+        Static = 0,     ///< copy or mix static values
+        Keys,           ///< unpack, lerp and copy or mix int16 keys
+        VariableKeys,   ///< a single variable-rate curve
+        PackedKeys,     ///< a single curve with a packed key format
+    };
+    /// curve layouts with specialized kernels
+    enum layoutKind : uint8_t {
+        Generic = 0,    ///< any curve layout, only the span kernels
+        TRS,            ///< Float3, Quaternion, Float3 per bone (10 lanes)
+    };
+    /// the lane key index of static lanes in laneKeys
+    static const uint16_t StaticLane = 0xFFFF;
+    /// a run of sample lanes of the same kind
+    struct span {
+        uint16_t kind = Static;
+        uint16_t num = 0;
+        uint16_t dstIndex = 0;  ///< first lane in sample buffer and plan values
+        uint16_t keyIndex = 0;  ///< first key in clip key row (Keys and PackedKeys spans)
+        uint16_t curveIndex = 0;    ///< the curve index (VariableKeys and PackedKeys spans)
+    };
+    /// the spans and values of one clip
+    struct clipPlan {
+        int firstSpan = 0;
+        int numSpans = 0;
+        int firstValue = 0;
+        bool laneSampled = false;   ///< uniform-rate with only Static and Keys spans (can use laneKeys)
+    };
+
+    /// build the plan for all clips in a library
+    void build(const AnimLibrary& lib);
+    /// clear the plan
+    void clear();
+    /// return the specialized layout matching the curve layout of a library
+    static layoutKind matchLayout(const AnimLibrary& lib);
+
+    layoutKind layout = Generic;
+    Array<span> spans;
+    Array<float> values;
+    Array<uint16_t> laneKeys;   ///< key index in the clip key row of every lane, or StaticLane
+    Array<float> fallback;  ///< static value of every lane (fallback pose of non-resident clips)
+    Array<uint16_t> laneCurves; ///< curve index of every lane, followed by the number of curves (same for all clips)
+    Array<clipPlan> clips;
+};
+
+struct animSampler {
+    /// unpack and interpolate num int16 keys
+    static void sample(const int16_t* src0, const int16_t* src1, const float* mag, float keyPos, float* dst, int num);
+    /// unpack, interpolate and mix num int16 keys into dst
+    static void sampleMix(const int16_t* src0, const int16_t* src1, const float* mag, float keyPos, float weight, float* dst, int num);
+    /// copy num static values
+    static void copy(const float* values, float* dst, int num);
+    /// mix num static values into dst
+    static void copyMix(const float* values, float weight, float* dst, int num);
+    /// sample N lanes through their lane key indices (copies the value of static lanes)
+    template<int N> static void sampleLanes(const int16_t* src0, const int16_t* src1, const uint16_t* laneKeys, const float* values, float keyPos, float* dst);
+
+    /// decode a single key of any curve format into NumValues floats
+    static void decode(const AnimCurve& curve, const int16_t* src, float* dst);
+    /// decode 2 keys of a curve for interpolation (flips quaternions into the same hemisphere)
+    static void decodePair(const AnimCurve& curve, const int16_t* src0, const int16_t* src1, float* dst0, float* dst1);
+    /// decode, interpolate and copy or mix a single key of any curve format
+    static void sampleCurve(const AnimCurve& curve, const int16_t* src0, const int16_t* src1, float keyPos, float weight, bool mix, float* dst);
+    /// encode a key of an 8-bit curve format (values are clamped to the curve range)
+    static void encodeU8(const AnimCurve& curve, const float* values, int16_t* dst);
+    /// encode a normalized quaternion (x,y,z,w) as a 48-bit smallest-three key
+    static void encodeQuat48(const float* quat, int16_t* dst);
+};
+
+//------------------------------------------------------------------------------
+template<int N> inline void
+animSampler::sampleLanes(const int16_t* src0, const int16_t* src1, const uint16_t* laneKeys, const float* values, float keyPos, float* dst) {
+    // same arithmetic as sample() and copy(), so the results are identical
+    for (int i = 0; i < N; i++) {
+        const uint16_t k = laneKeys[i];
+        if (animSamplePlan::StaticLane != k) {
+            const float v0 = float(src0[k]) * values[i];
+            const float v1 = float(src1[k]) * values[i];
+            dst[i] = v0 + (v1 - v0) * keyPos;
+        }
+        else {
+            dst[i] = values[i];
+        }
+    }
+}
+
+} // namespace _priv
+} // namespace Oryol
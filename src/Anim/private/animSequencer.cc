@@ -3,6 +3,8 @@
 //------------------------------------------------------------------------------
 #include "Pre.h"
 #include "animSequencer.h"
+#include "animSampler.h"
+#include "animProfiler.h"
 #include <float.h>
 #include <math.h>
 
@@ -19,7 +21,7 @@ checkValidateItem(animSequencer::item& item) {
 
 //------------------------------------------------------------------------------
 bool
-animSequencer::add(double curTime, AnimJobId jobId, const AnimJob& job, double clipDuration) {
+animSequencer::add(double curTime, AnimJobId jobId, const AnimJob& job, double clipDuration, const AnimMask* mask) {
     if (this->items.Full()) {
         // no more free job slots
         return false;
@@ -49,12 +51,25 @@ animSequencer::add(double curTime, AnimJobId jobId, const AnimJob& job, double c
             break;
         }
     }
+    // find a free row in the key cursor table
+    uint32_t usedCursorSlots = 0;
+    for (const auto& curItem : this->items) {
+        usedCursorSlots |= (1 << curItem.cursorSlot);
+    }
+    int cursorSlot = 0;
+    while (usedCursorSlots & (1 << cursorSlot)) {
+        cursorSlot++;
+    }
+    o_assert_dbg(cursorSlot < maxItems);
+
     item newItem;
     newItem.id = jobId;
+    newItem.cursorSlot = cursorSlot;
     newItem.valid = true;
     newItem.clipIndex = job.ClipIndex;
     newItem.trackIndex = job.TrackIndex;
     newItem.mixWeight = job.MixWeight;
+    newItem.mask = mask;
     newItem.absStartTime = absStartTime;
     newItem.absFadeInTime = absStartTime + job.FadeIn;
     if (job.Duration > 0.0f) {
@@ -183,6 +198,39 @@ static float fadeWeight(float w0, float w1, double t, double t0, double t1) {
     return w0 + rt*(w1-w0);
 }
 
+//------------------------------------------------------------------------------
+bool
+animSequencer::isActive(const item& item, double curTime) {
+    return item.valid && (item.absStartTime <= curTime) && (item.absEndTime > curTime);
+}
+
+//------------------------------------------------------------------------------
+float
+animSequencer::weight(const item& item, double curTime) {
+    float w = item.mixWeight;
+    if (curTime < item.absFadeInTime) {
+        w = fadeWeight(0.0f, w, curTime, item.absStartTime, item.absFadeInTime);
+    }
+    else if (curTime > item.absFadeOutTime) {
+        w = fadeWeight(w, 0.0f, curTime, item.absFadeOutTime, item.absEndTime);
+    }
+    return w;
+}
+
+//------------------------------------------------------------------------------
+int
+animSequencer::firstVisibleItem(double curTime) const {
+    // items are sorted by priority, an active unmasked item at full
+    // weight completely overwrites the result of all items before it
+    for (int i = this->items.Size() - 1; i > 0; i--) {
+        const item& item = this->items[i];
+        if (!item.mask && isActive(item, curTime) && (weight(item, curTime) >= 1.0f)) {
+            return i;
+        }
+    }
+    return 0;
+}
+
 //------------------------------------------------------------------------------
 static int clampKeyIndex(int keyIndex, int clipNumKeys) {
     // FIXME: handle clamp vs loop here
@@ -195,122 +243,344 @@ static int clampKeyIndex(int keyIndex, int clipNumKeys) {
 }
 
 //------------------------------------------------------------------------------
-static float unpack(int16_t p, float m) {
-    return float(p) * m;
+void
+animSequencer::samplePos(const AnimClip& clip, const item& item, double curTime, int& outKey0, int& outKey1, float& outKeyPos) {
+    outKey0 = 0;
+    outKey1 = 0;
+    outKeyPos = 0.0f;
+    if (clip.Length > 0) {
+        o_assert_dbg(clip.KeyDuration > 0.0f);
+        const double clipTime = curTime - item.absStartTime;
+        int key0 = int(clipTime / clip.KeyDuration);
+        outKeyPos = float((clipTime - (key0 * clip.KeyDuration)) / clip.KeyDuration);
+        outKey0 = clampKeyIndex(key0, clip.Length);
+        outKey1 = clampKeyIndex(outKey0 + 1, clip.Length);
+    }
 }
 
+//------------------------------------------------------------------------------
+static int
+findKey(const int16_t* times, int numKeys, int frame, uint16_t* cursor) {
+    // find the last key at or before frame, start at the cached
+    // cursor position, which makes sequential playback O(1), and
+    // fall back to a binary search after seeking or looping
+    int k = cursor ? *cursor : 0;
+    if ((k >= numKeys) || (times[k] > frame)) {
+        k = 0;
+    }
+    int steps = 0;
+    while (((k + 1) < numKeys) && (times[k + 1] <= frame)) {
+        if (++steps > 4) {
+            int lo = k + 1;
+            int hi = numKeys - 1;
+            while (lo < hi) {
+                const int mid = (lo + hi + 1) / 2;
+                if (times[mid] <= frame) {
+                    lo = mid;
+                }
+                else {
+                    hi = mid - 1;
+                }
+            }
+            k = lo;
+            break;
+        }
+        k++;
+    }
+    if (cursor) {
+        *cursor = uint16_t(k);
+    }
+    return k;
+}
+
+//------------------------------------------------------------------------------
+static void
+sampleVariable(const AnimClip& clip, const AnimCurve& curve, int frame, float framePos, uint16_t* cursor, float weight, bool mix, float* dst) {
+    // the keys of a variable-rate curve are stored as a column of
+    // NumKeys frame indices, followed by NumKeys packed values, the
+    // first and last frame always have a key, and the last key
+    // interpolates towards the first key like a uniform clip
+    const int16_t* times = &(clip.Keys[curve.KeyIndex]);
+    const int16_t* keys = times + curve.NumKeys;
+    const int k0 = findKey(times, curve.NumKeys, frame, cursor);
+    int k1;
+    float t1;
+    if ((k0 + 1) < curve.NumKeys) {
+        k1 = k0 + 1;
+        t1 = float(times[k1]);
+    }
+    else {
+        k1 = 0;
+        t1 = float(clip.Length);
+    }
+    const float t0 = float(times[k0]);
+    const float keyPos = (framePos - t0) / (t1 - t0);
+    const int16_t* src0 = keys + k0 * curve.KeyStride;
+    const int16_t* src1 = keys + k1 * curve.KeyStride;
+    animSampler::sampleCurve(curve, src0, src1, keyPos, weight, mix, dst);
+}
+
+//------------------------------------------------------------------------------
+/**
+    The per-item state for sampling the spans of a clip.
+*/
+struct spanContext {
+    const AnimClip* clip = nullptr;
+    const animSamplePlan::span* spans = nullptr;
+    int numSpans = 0;
+    const float* values = nullptr;
+    const float* fallback = nullptr;    // if set, copy or mix the fallback pose instead of sampling
+    const int16_t* src0 = nullptr;
+    const int16_t* src1 = nullptr;
+    float keyPos = 0.0f;
+    int key0 = 0;
+    float framePos = 0.0f;
+    uint16_t* cursors = nullptr;
+    float weight = 1.0f;
+    bool mix = false;
+};
+
+//------------------------------------------------------------------------------
+static int
+sampleSpans(const spanContext& ctx, int spanIndex, int begin, int end, float* sampleBuffer) {
+    // sample (or mix) the sample lanes [begin, end) starting at spanIndex,
+    // Static and Keys spans may be clipped, single-curve spans can't
+    // be split so the lane range must be on curve boundaries, returns
+    // the index of the first span which may overlap following lanes
+    if (ctx.fallback) {
+        if (ctx.mix) {
+            animSampler::copyMix(ctx.fallback + begin, ctx.weight, sampleBuffer + begin, end - begin);
+        }
+        else {
+            animSampler::copy(ctx.fallback + begin, sampleBuffer + begin, end - begin);
+        }
+        return spanIndex;
+    }
+    // NOTE: simply use linear interpolation for quaternions,
+    // just assume they are close together
+    // FIXME: may need to do proper quaternion slerp when mixing
+    // rotation curves
+    for (; spanIndex < ctx.numSpans; spanIndex++) {
+        const animSamplePlan::span& s = ctx.spans[spanIndex];
+        const int spanEnd = s.dstIndex + s.num;
+        if (spanEnd <= begin) {
+            continue;
+        }
+        if (s.dstIndex >= end) {
+            break;
+        }
+        const int first = s.dstIndex > begin ? s.dstIndex : begin;
+        const int num = (spanEnd < end ? spanEnd : end) - first;
+        const int offset = first - s.dstIndex;
+        float* dst = sampleBuffer + first;
+        if (animSamplePlan::Keys == s.kind) {
+            const int16_t* src0 = ctx.src0 + s.keyIndex + offset;
+            const int16_t* src1 = ctx.src1 + s.keyIndex + offset;
+            if (ctx.mix) {
+                animSampler::sampleMix(src0, src1, ctx.values + first, ctx.keyPos, ctx.weight, dst, num);
+            }
+            else {
+                animSampler::sample(src0, src1, ctx.values + first, ctx.keyPos, dst, num);
+            }
+        }
+        else if (animSamplePlan::Static == s.kind) {
+            if (ctx.mix) {
+                animSampler::copyMix(ctx.values + first, ctx.weight, dst, num);
+            }
+            else {
+                animSampler::copy(ctx.values + first, dst, num);
+            }
+        }
+        else {
+            o_assert_dbg((0 == offset) && (num == s.num));
+            const AnimCurve& curve = ctx.clip->Curves[s.curveIndex];
+            if (animSamplePlan::PackedKeys == s.kind) {
+                animSampler::sampleCurve(curve, ctx.src0 + s.keyIndex, ctx.src1 + s.keyIndex, ctx.keyPos, ctx.weight, ctx.mix, dst);
+            }
+            else {
+                sampleVariable(*ctx.clip, curve, ctx.key0, ctx.framePos,
+                    ctx.cursors ? ctx.cursors + s.curveIndex : nullptr, ctx.weight, ctx.mix, dst);
+            }
+        }
+        if (spanEnd > end) {
+            // the rest of this span may be in the next lane range
+            break;
+        }
+    }
+    return spanIndex;
+}
+
+#if ORYOL_ANIM_FRAME_STATS
+//------------------------------------------------------------------------------
+static void
+countSampled(const animSamplePlan* plan, int clipIndex, const AnimClip& clip, int begin, int end, animSequencer::evalStats* stats) {
+    // count the curves and keys of the lanes [begin, end) which are
+    // actually sampled, masks and the bone LOD only sample some lanes,
+    // the lane range must be on curve boundaries
+    stats->numCurves += plan->laneCurves[end] - plan->laneCurves[begin];
+    if (!clip.Resident) {
+        return;
+    }
+    const animSamplePlan::clipPlan& cp = plan->clips[clipIndex];
+    for (int spanIndex = cp.firstSpan; spanIndex < (cp.firstSpan + cp.numSpans); spanIndex++) {
+        const animSamplePlan::span& s = plan->spans[spanIndex];
+        if (s.dstIndex >= end) {
+            break;
+        }
+        const int first = s.dstIndex > begin ? s.dstIndex : begin;
+        const int last = (s.dstIndex + s.num) < end ? (s.dstIndex + s.num) : end;
+        if (first < last) {
+            // 2 keys are interpolated
+            if (animSamplePlan::Keys == s.kind) {
+                stats->numKeys += 2 * (last - first);
+            }
+            else if (animSamplePlan::Static != s.kind) {
+                stats->numKeys += 2 * clip.Curves[s.curveIndex].KeyStride;
+            }
+        }
+    }
+}
+#endif
+
 //------------------------------------------------------------------------------
 bool
-animSequencer::eval(const AnimLibrary* lib, double curTime, float* sampleBuffer, int numSamples) {
+animSequencer::eval(const AnimLibrary* lib, const animSamplePlan* plan, double curTime, float* sampleBuffer, int numSamples, evalStats* stats) {
+    ORYOL_ANIM_ZONE("Anim::sequencerEval");
+    o_assert_dbg(lib && plan);
+    o_assert_dbg(numSamples <= lib->SampleStride);
 
-    // for each item which crosses the current play time...
-    // FIXME: currently items are evaluated even if they are culled
-    // completely by higher priority items
+    // for each item which crosses the current play time, starting
+    // at the first item which isn't culled by higher priority items...
     int numProcessedItems = 0;
-    for (const auto& item : this->items) {
+    const int numItems = this->items.Size();
+    const int firstItem = this->firstVisibleItem(curTime);
+    #if ORYOL_ANIM_FRAME_STATS
+    if (stats) {
+        stats->numSkippedItems += firstItem;
+    }
+    #endif
+    for (int itemIndex = firstItem; itemIndex < numItems; itemIndex++) {
+        const item& item = this->items[itemIndex];
         // skip current item if it isn't valid or doesn't cross the play cursor
-        if (!item.valid || (item.absStartTime > curTime) || (item.absEndTime <= curTime)) {
+        if (!isActive(item, curTime)) {
+            #if ORYOL_ANIM_FRAME_STATS
+            if (stats) {
+                stats->numSkippedItems++;
+            }
+            #endif
             continue;
         }
         const AnimClip& clip = lib->Clips[item.clipIndex];
+        #if ORYOL_ANIM_FRAME_STATS
+        if (stats) {
+            stats->numItems++;
+        }
+        #endif
 
         // compute sampling parameters
         int key0 = 0;
         int key1 = 0;
         float keyPos = 0.0f;
-        if (clip.Length > 0) {
-            o_assert_dbg(clip.KeyDuration > 0.0f);
-            const double clipTime = curTime - item.absStartTime;
-            key0 = int(clipTime / clip.KeyDuration);
-            keyPos = float((clipTime - (key0 * clip.KeyDuration)) / clip.KeyDuration);
-            key0 = clampKeyIndex(key0, clip.Length);
-            key1 = clampKeyIndex(key0 + 1, clip.Length);
-        }
+        samplePos(clip, item, curTime, key0, key1, keyPos);
+        const bool uniform = !clip.VariableRate && !clip.Keys.Empty();
+        const int16_t* src0 = uniform ? &(clip.Keys[key0 * clip.KeyStride]) : nullptr;
+        const int16_t* src1 = uniform ? &(clip.Keys[key1 * clip.KeyStride]) : nullptr;
+        const float framePos = float(key0) + keyPos;
+        uint16_t* cursors = this->keyCursors ? &(this->keyCursors[item.cursorSlot * this->numCursorCurves]) : nullptr;
 
+        // the precomputed spans of this clip
+        const animSamplePlan::clipPlan& cp = plan->clips[item.clipIndex];
+        spanContext ctx;
+        ctx.clip = &clip;
+        ctx.spans = &(plan->spans[cp.firstSpan]);
+        ctx.numSpans = cp.numSpans;
+        ctx.values = &(plan->values[cp.firstValue]);
+        ctx.src0 = src0;
+        ctx.src1 = src1;
+        ctx.keyPos = keyPos;
+        ctx.key0 = key0;
+        ctx.framePos = framePos;
+        ctx.cursors = cursors;
         // only sample, or sample and mix with previous track?
-        const int16_t* src0 = clip.Keys.Empty() ? nullptr : &(clip.Keys[key0 * clip.KeyStride]);
-        const int16_t* src1 = clip.Keys.Empty() ? nullptr : &(clip.Keys[key1 * clip.KeyStride]);
-        float* dst = sampleBuffer;
-        #if ORYOL_DEBUG
-        const float* dstEnd = dst + numSamples;
-        #endif
-        float s0, s1, v0, v1;
-        if (0 == numProcessedItems) {
-            // first processed track, only need to sample, not mix with previous track
-            for (const auto& curve : clip.Curves) {
-                const int num = curve.NumValues;
-                if (curve.Static) {
-                    if (num >= 1) *dst++ = curve.StaticValue[0];
-                    if (num >= 2) *dst++ = curve.StaticValue[1];
-                    if (num >= 3) *dst++ = curve.StaticValue[2];
-                    if (num >= 4) *dst++ = curve.StaticValue[3];
+        ctx.mix = numProcessedItems > 0;
+        ctx.weight = ctx.mix ? animSequencer::weight(item, curTime) : 1.0f;
+
+        // the keys of a streamed clip may still be loading, use the fallback pose
+        const float* fallback = &(plan->fallback[cp.firstValue]);
+        ctx.fallback = clip.Resident ? nullptr : fallback;
+
+        if (item.mask) {
+            // masked lanes are not touched, if this is the first
+            // processed item, they get the fallback pose
+            o_assert_dbg(item.mask->SampleStride == lib->SampleStride);
+            if (!ctx.mix) {
+                animSampler::copy(fallback, sampleBuffer, numSamples);
+            }
+            int spanIndex = 0;
+            for (const auto& range : item.mask->Ranges) {
+                if (range.First >= numSamples) {
+                    break;
                 }
-                else {
-                    // NOTE: simply use linear interpolation for quaternions,
-                    // just assume they are close together
-                    const float* m = curve.Magnitude;
-                    if (num >= 1) { v0=unpack(*src0++,m[0]); v1=unpack(*src1++,m[0]); *dst++=v0+(v1-v0)*keyPos; }
-                    if (num >= 2) { v0=unpack(*src0++,m[1]); v1=unpack(*src1++,m[1]); *dst++=v0+(v1-v0)*keyPos; }
-                    if (num >= 3) { v0=unpack(*src0++,m[2]); v1=unpack(*src1++,m[2]); *dst++=v0+(v1-v0)*keyPos; }
-                    if (num >= 4) { v0=unpack(*src0++,m[3]); v1=unpack(*src1++,m[3]); *dst++=v0+(v1-v0)*keyPos; }
+                const int rangeEnd = range.First + range.Num < numSamples ? range.First + range.Num : numSamples;
+                spanIndex = sampleSpans(ctx, spanIndex, range.First, rangeEnd, sampleBuffer);
+                #if ORYOL_ANIM_FRAME_STATS
+                if (stats) {
+                    countSampled(plan, item.clipIndex, clip, range.First, rangeEnd, stats);
                 }
+                #endif
             }
         }
         else {
-            // evaluate track and mix with previous sampling+mixing result
-            // FIXME: may need to do proper quaternion slerp when mixing
-            // rotation curves
-            float weight = item.mixWeight;
-            if (curTime < item.absFadeInTime) {
-                weight = fadeWeight(0.0f, weight, curTime, item.absStartTime, item.absFadeInTime);
-            }
-            else if (curTime > item.absFadeOutTime) {
-                weight = fadeWeight(weight, 0.0f, curTime, item.absFadeOutTime, item.absEndTime);
+            sampleSpans(ctx, 0, 0, numSamples, sampleBuffer);
+            #if ORYOL_ANIM_FRAME_STATS
+            if (stats) {
+                countSampled(plan, item.clipIndex, clip, 0, numSamples, stats);
             }
-            for (const auto& curve : clip.Curves) {
-                const int num = curve.NumValues;
-                if (curve.Static) {
-                    if (num >= 1) { s0=*dst; s1=curve.StaticValue[0]; *dst++=s0+(s1-s0)*weight; }
-                    if (num >= 2) { s0=*dst; s1=curve.StaticValue[1]; *dst++=s0+(s1-s0)*weight; }
-                    if (num >= 3) { s0=*dst; s1=curve.StaticValue[2]; *dst++=s0+(s1-s0)*weight; }
-                    if (num >= 4) { s0=*dst; s1=curve.StaticValue[3]; *dst++=s0+(s1-s0)*weight; }
-                }
-                else {
-                    const float* m = curve.Magnitude;
-                    if (num >= 1) {
-                        v0=unpack(*src0++,m[0]); v1=unpack(*src1++,m[0]);
-                        s0=*dst; s1=v0+(v1-v0)*keyPos;
-                        *dst++=s0+(s1-s0)*weight;
-                    }
-                    if (num >= 2) {
-                        v0=unpack(*src0++,m[1]); v1=unpack(*src1++,m[1]);
-                        s0=*dst; s1=v0+(v1-v0)*keyPos;
-                        *dst++=s0+(s1-s0)*weight;
-                    }
-                    if (num >= 3) {
-                        v0=unpack(*src0++,m[2]); v1=unpack(*src1++,m[2]);
-                        s0=*dst; s1=v0+(v1-v0)*keyPos;
-                        *dst++=s0+(s1-s0)*weight;
-                    }
-                    if (num >= 4) {
-                        v0=unpack(*src0++,m[3]); v1=unpack(*src1++,m[3]);
-                        s0=*dst; s1=v0+(v1-v0)*keyPos;
-                        *dst++=s0+(s1-s0)*weight;
-                    }
-                }
-            }
-        }
-        o_assert_dbg(dst == dstEnd);
-        #if ORYOL_DEBUG
-        if (src0 && src1) {
-            o_assert_dbg(src0 == (&(clip.Keys[key0 * clip.KeyStride]) + clip.KeyStride));
-            o_assert_dbg(src1 == (&(clip.Keys[key1 * clip.KeyStride]) + clip.KeyStride));
+            #endif
         }
-        #endif
         numProcessedItems++;
     }
     return numProcessedItems > 0;
 }
 
+//------------------------------------------------------------------------------
+bool
+animSequencer::singleClip(const AnimLibrary* lib, const animSamplePlan* plan, double curTime, int numSamples, clipSample& out, evalStats* stats) const {
+    o_assert_dbg(lib && plan);
+    // a single active item is sampled without mixing, which is what
+    // eval() would compute, the caller falls back to eval() otherwise
+    const int numItems = this->items.Size();
+    const item* single = nullptr;
+    for (int itemIndex = this->firstVisibleItem(curTime); itemIndex < numItems; itemIndex++) {
+        if (isActive(this->items[itemIndex], curTime)) {
+            if (single) {
+                return false;
+            }
+            single = &(this->items[itemIndex]);
+        }
+    }
+    if (!single || single->mask) {
+        return false;
+    }
+    const AnimClip& clip = lib->Clips[single->clipIndex];
+    if (!clip.Resident || !plan->clips[single->clipIndex].laneSampled) {
+        return false;
+    }
+    #if ORYOL_ANIM_FRAME_STATS
+    if (stats) {
+        stats->numSkippedItems += numItems - 1;
+        stats->numItems++;
+        countSampled(plan, single->clipIndex, clip, 0, numSamples, stats);
+    }
+    #endif
+    int key0 = 0;
+    int key1 = 0;
+    out.clipIndex = single->clipIndex;
+    samplePos(clip, *single, curTime, key0, key1, out.keyPos);
+    out.src0 = clip.Keys.Empty() ? nullptr : &(clip.Keys[key0 * clip.KeyStride]);
+    out.src1 = clip.Keys.Empty() ? nullptr : &(clip.Keys[key1 * clip.KeyStride]);
+    return true;
+}
+
 } // namespace _priv
 } // namespace Oryol
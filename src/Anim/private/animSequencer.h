@@ -12,6 +12,8 @@
 namespace Oryol {
 namespace _priv {
 
+class animSamplePlan;
+
 class animSequencer {
 public:
     /// a track item for evaluating an anim job
@@ -34,14 +36,36 @@ public:
         double absFadeInTime = 0.0;
         /// the absolute time when fade-out starts
         double absFadeOutTime = 0.0;
+        /// the item's row in the key cursor table
+        int cursorSlot = 0;
+        /// optional curve mask
+        const AnimMask* mask = nullptr;
+    };
+    /// counters collected by eval() for the frame statistics
+    struct evalStats {
+        int numItems = 0;
+        int numSkippedItems = 0;
+        int numCurves = 0;
+        int numKeys = 0;
+    };
+    /// the key position of a single clip which is sampled through its lane key indices
+    struct clipSample {
+        int clipIndex = InvalidIndex;
+        const int16_t* src0 = nullptr;
+        const int16_t* src1 = nullptr;
+        float keyPos = 0.0f;
     };
     /// max number of items that can be queued
     static const int maxItems = 16;
     /// room for enqueued items
     InlineArray<item, maxItems> items;
+    /// optional per-item, per-curve key cursors for variable-rate clips (maxItems rows)
+    uint16_t* keyCursors = nullptr;
+    /// number of curves per row in keyCursors
+    int numCursorCurves = 0;
 
     /// enqueue a new anim job, return false if queue is full, or job was dropped
-    bool add(double curTime, AnimJobId jobId, const AnimJob& job, double clipDuration);
+    bool add(double curTime, AnimJobId jobId, const AnimJob& job, double clipDuration, const AnimMask* mask=nullptr);
     /// stop a job, this will just set the end time to the current time
     void stop(double curTime, AnimJobId jobId, bool allowFadeOut);
     /// stop a track, this will set the end time of jobs overlapping curTime, and invalidate future jobs
@@ -50,8 +74,18 @@ public:
     void stopAll(double curTime, bool allowFadeOut);
     /// remove invalid and expired items
     void garbageCollect(double curTime);
-    /// evaluate all active anim jobs into sample buffer, return false if there was nothing to do
-    bool eval(const AnimLibrary* lib, double curTime, float* sampleBuffer, int numSamples);
+    /// return true if an item crosses the play cursor
+    static bool isActive(const item& item, double curTime);
+    /// compute the effective mixing weight of an active item (including fades)
+    static float weight(const item& item, double curTime);
+    /// compute the keys and key position at which an active item samples its clip
+    static void samplePos(const AnimClip& clip, const item& item, double curTime, int& outKey0, int& outKey1, float& outKeyPos);
+    /// index of first item which isn't completely occluded by higher priority items
+    int firstVisibleItem(double curTime) const;
+    /// evaluate all active anim jobs into sample buffer (numSamples may be a prefix of the sample stride), return false if there was nothing to do
+    bool eval(const AnimLibrary* lib, const animSamplePlan* plan, double curTime, float* sampleBuffer, int numSamples, evalStats* stats=nullptr);
+    /// if the result is a single unmasked, resident and lane-sampled clip, return its key position instead of evaluating (numSamples is only counted in stats)
+    bool singleClip(const AnimLibrary* lib, const animSamplePlan* plan, double curTime, int numSamples, clipSample& out, evalStats* stats=nullptr) const;
 };
 
 } // namespace _priv
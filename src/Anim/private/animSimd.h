@@ -0,0 +1,72 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @file Anim/private/animSimd.h
+    @ingroup _priv
+    @brief SIMD feature detection and a minimal float vector type
+
+    The instruction set is selected at compile time. animVec is an
+    8-wide (AVX) or 4-wide (SSE2) float vector used by the batched
+    kernels which process several anim instances in SoA lanes.
+    ORYOL_ANIM_USE_SIMD_LANES is not defined if neither is available,
+    the callers must provide a scalar path in that case.
+*/
+#include "Core/Types.h"
+
+#if defined(__AVX2__)
+#define ORYOL_ANIM_USE_AVX2 (1)
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define ORYOL_ANIM_USE_SSE (1)
+#endif
+
+#if ORYOL_ANIM_USE_AVX2
+#include <immintrin.h>
+#define ORYOL_ANIM_USE_SIMD_LANES (1)
+#elif ORYOL_ANIM_USE_SSE
+#include <emmintrin.h>
+#define ORYOL_ANIM_USE_SIMD_LANES (1)
+#endif
+
+#if ORYOL_ANIM_USE_SIMD_LANES
+namespace Oryol {
+namespace _priv {
+
+#if ORYOL_ANIM_USE_AVX2
+typedef __m256 animVec;
+static const int animVecLanes = 8;
+inline animVec animVecSet(float f) { return _mm256_set1_ps(f); }
+inline animVec animVecLoad(const float* p) { return _mm256_loadu_ps(p); }
+inline void animVecStore(float* p, animVec v) { _mm256_storeu_ps(p, v); }
+#if !defined(__clang__) && !defined(__GNUC__)
+// GCC and clang already provide arithmetic operators for vector types
+inline animVec operator+(animVec a, animVec b) { return _mm256_add_ps(a, b); }
+inline animVec operator-(animVec a, animVec b) { return _mm256_sub_ps(a, b); }
+inline animVec operator*(animVec a, animVec b) { return _mm256_mul_ps(a, b); }
+#endif
+#else
+typedef __m128 animVec;
+static const int animVecLanes = 4;
+inline animVec animVecSet(float f) { return _mm_set1_ps(f); }
+inline animVec animVecLoad(const float* p) { return _mm_loadu_ps(p); }
+inline void animVecStore(float* p, animVec v) { _mm_storeu_ps(p, v); }
+#if !defined(__clang__) && !defined(__GNUC__)
+// GCC and clang already provide arithmetic operators for vector types
+inline animVec operator+(animVec a, animVec b) { return _mm_add_ps(a, b); }
+inline animVec operator-(animVec a, animVec b) { return _mm_sub_ps(a, b); }
+inline animVec operator*(animVec a, animVec b) { return _mm_mul_ps(a, b); }
+#endif
+#endif
+
+/// gather one float per lane from lane pointers (SoA transpose)
+inline animVec animVecGather(const float* const* ptrs, int offset) {
+    alignas(32) float tmp[animVecLanes];
+    for (int i = 0; i < animVecLanes; i++) {
+        tmp[i] = ptrs[i][offset];
+    }
+    return animVecLoad(tmp);
+}
+
+} // namespace _priv
+} // namespace Oryol
+#endif
@@ -0,0 +1,151 @@
+//------------------------------------------------------------------------------
+//  animWorkerPool.cc
+//------------------------------------------------------------------------------
+#include "Pre.h"
+#include "animWorkerPool.h"
+
+namespace Oryol {
+namespace _priv {
+
+//------------------------------------------------------------------------------
+animWorkerPool::~animWorkerPool() {
+    o_assert_dbg(!this->isValid);
+}
+
+//------------------------------------------------------------------------------
+void
+animWorkerPool::setup(int numThreads) {
+    o_assert_dbg(!this->isValid);
+    o_assert_dbg(numThreads >= 0);
+    this->isValid = true;
+    #if ORYOL_HAS_THREADS
+    if (numThreads > MaxNumThreads) {
+        o_warn("Anim: clamping number of worker threads to %d\n", MaxNumThreads);
+        numThreads = MaxNumThreads;
+    }
+    this->numWorkers = numThreads;
+    this->generation = 0;
+    this->numBusy = 0;
+    this->stopRequested = false;
+    for (int i = 0; i < this->numWorkers; i++) {
+        this->threads[i] = std::thread(&animWorkerPool::threadFunc, this, i);
+    }
+    #endif
+}
+
+//------------------------------------------------------------------------------
+void
+animWorkerPool::discard() {
+    o_assert_dbg(this->isValid);
+    #if ORYOL_HAS_THREADS
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopRequested = true;
+    }
+    this->startCond.notify_all();
+    for (int i = 0; i < this->numWorkers; i++) {
+        this->threads[i].join();
+    }
+    this->numWorkers = 0;
+    #endif
+    this->isValid = false;
+}
+
+//------------------------------------------------------------------------------
+int
+animWorkerPool::numThreads() const {
+    #if ORYOL_HAS_THREADS
+    return this->numWorkers;
+    #else
+    return 0;
+    #endif
+}
+
+//------------------------------------------------------------------------------
+void
+animWorkerPool::run(int numChunks, chunkFunc func, void* userData) {
+    o_assert_dbg(this->isValid && func);
+    #if ORYOL_HAS_THREADS
+    if ((this->numWorkers > 0) && (numChunks > 1)) {
+        // distribute the chunk range evenly over all participants,
+        // the calling thread is the last participant
+        const int numParticipants = this->numWorkers + 1;
+        const int chunksPerParticipant = numChunks / numParticipants;
+        const int remainder = numChunks % numParticipants;
+        int begin = 0;
+        for (int i = 0; i < numParticipants; i++) {
+            const int num = chunksPerParticipant + ((i < remainder) ? 1 : 0);
+            this->queues[i].next.store(begin, std::memory_order_relaxed);
+            this->queues[i].end = begin + num;
+            begin += num;
+        }
+        o_assert_dbg(begin == numChunks);
+
+        // wake up workers, and help out on this thread
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->curFunc = func;
+            this->curUserData = userData;
+            this->numBusy = this->numWorkers;
+            this->generation++;
+        }
+        this->startCond.notify_all();
+        this->work(this->numWorkers);
+
+        // wait until all workers are done
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->doneCond.wait(lock, [this] { return 0 == this->numBusy; });
+        this->curFunc = nullptr;
+        this->curUserData = nullptr;
+        return;
+    }
+    #endif
+    for (int i = 0; i < numChunks; i++) {
+        func(userData, i, 0);
+    }
+}
+
+#if ORYOL_HAS_THREADS
+//------------------------------------------------------------------------------
+void
+animWorkerPool::work(int participant) {
+    // first drain the own queue, then go around and steal
+    // from the other participants until all queues are empty
+    const int numParticipants = this->numWorkers + 1;
+    for (int i = 0; i < numParticipants; i++) {
+        queue& q = this->queues[(participant + i) % numParticipants];
+        int chunkIndex;
+        while ((chunkIndex = q.next.fetch_add(1, std::memory_order_relaxed)) < q.end) {
+            this->curFunc(this->curUserData, chunkIndex, participant);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+animWorkerPool::threadFunc(int participant) {
+    uint32_t seenGeneration = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->startCond.wait(lock, [this, seenGeneration] {
+                return this->stopRequested || (this->generation != seenGeneration);
+            });
+            if (this->stopRequested) {
+                return;
+            }
+            seenGeneration = this->generation;
+        }
+        this->work(participant);
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (0 == --this->numBusy) {
+                this->doneCond.notify_one();
+            }
+        }
+    }
+}
+#endif
+
+} // namespace _priv
+} // namespace Oryol
@@ -0,0 +1,82 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class Oryol::_priv::animWorkerPool
+    @ingroup _priv
+    @brief worker threads for parallel anim evaluation
+
+    The caller splits its work into a number of independent chunks,
+    and calls run() with a function which processes a single chunk.
+    The chunk range is initially distributed evenly over all
+    participants (the worker threads plus the calling thread), when a
+    participant runs out of chunks it steals chunks from the other
+    participants. run() returns when all chunks have been processed.
+    The chunk function also gets the index of the participant which
+    processes the chunk (0..numThreads()), to select per-thread
+    scratch memory.
+
+    On platforms without threading support, or if the pool has
+    been setup with 0 threads, all chunks are processed on the
+    calling thread.
+*/
+#include "Core/Types.h"
+#if ORYOL_HAS_THREADS
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#endif
+
+namespace Oryol {
+namespace _priv {
+
+class animWorkerPool {
+public:
+    /// function which processes one chunk of work
+    typedef void (*chunkFunc)(void* userData, int chunkIndex, int participant);
+
+    /// destructor
+    ~animWorkerPool();
+
+    /// start the worker threads
+    void setup(int numThreads);
+    /// stop and join the worker threads
+    void discard();
+    /// return number of worker threads (not including the calling thread)
+    int numThreads() const;
+    /// process chunks [0, numChunks) on all threads, return when finished
+    void run(int numChunks, chunkFunc func, void* userData);
+
+    /// max number of worker threads
+    static const int MaxNumThreads = 32;
+    bool isValid = false;
+
+#if ORYOL_HAS_THREADS
+    /// per-participant chunk queue, owner and thieves advance 'next'
+    struct queue {
+        std::atomic<int> next{0};
+        int end = 0;
+        // avoid false sharing between participants
+        char pad[64 - sizeof(std::atomic<int>) - sizeof(int)];
+    };
+    /// process own chunks, then steal from other participants
+    void work(int participant);
+    /// worker thread entry
+    void threadFunc(int participant);
+
+    int numWorkers = 0;
+    std::thread threads[MaxNumThreads];
+    queue queues[MaxNumThreads + 1];
+    std::mutex mutex;
+    std::condition_variable startCond;
+    std::condition_variable doneCond;
+    uint32_t generation = 0;
+    int numBusy = 0;
+    bool stopRequested = false;
+    chunkFunc curFunc = nullptr;
+    void* curUserData = nullptr;
+#endif
+};
+
+} // namespace _priv
+} // namespace Oryol